@@ -0,0 +1,323 @@
+/*
+ * Rainbow is a tool for changing color and status of the LEDs of the Turris router
+ *
+ * Copyright (C) 2016 CZ.NIC, z.s.p.o. (http://www.nic.cz/)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/timerfd.h>
+
+#include "configuration.h"
+#include "arg_parser.h"
+#include "backend.h"
+#include "plan.h"
+#include "animation.h"
+#include "pattern.h"
+
+// Phase of an effect is a Q16 fraction of its period
+#define Q16_ONE 0x10000U
+
+struct led_animation {
+	struct effect_params params;
+	uint64_t start; // ms
+	unsigned int from; // starting color of fade
+	unsigned int index; // position of the LED in its group
+	unsigned int count; // number of LEDs in the group
+	struct pattern pattern; // steps of EFF_PATTERN
+};
+
+struct animator {
+	struct backend *backend;
+	int timer_fd;
+	unsigned int mask;
+	struct led_animation leds[LED_COUNT];
+	// Last color written by the engine, bit set in written_mask when valid
+	unsigned int frame[LED_COUNT];
+	unsigned int written_mask;
+};
+
+static uint64_t now_ms()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static unsigned int popcount(unsigned int mask)
+{
+	unsigned int count = 0;
+	for (; mask; mask &= mask - 1) {
+		count++;
+	}
+	return count;
+}
+
+static int timer_arm(struct animator *animator, bool on)
+{
+	const long interval = 1000000000L / ANIMATION_FPS;
+	struct itimerspec spec = {
+		.it_interval = { .tv_sec = 0, .tv_nsec = on ? interval : 0 },
+		.it_value = { .tv_sec = 0, .tv_nsec = on ? interval : 0 }
+	};
+
+	return timerfd_settime(animator->timer_fd, 0, &spec, NULL);
+}
+
+unsigned int color_lerp(unsigned int a, unsigned int b, uint32_t t)
+{
+	unsigned int result = 0;
+
+	for (int shift = 0; shift <= 16; shift += 8) {
+		int ca = (a >> shift) & 0xFF;
+		int cb = (b >> shift) & 0xFF;
+		int c = ca + (int) (((int64_t) (cb - ca) * t) >> 16);
+		result |= (unsigned int) c << shift;
+	}
+
+	return result;
+}
+
+// 3t^2 - 2t^3 in Q16, makes breathing ease in and out
+static uint32_t smoothstep(uint32_t t)
+{
+	uint64_t t2 = ((uint64_t) t * t) >> 16;
+	uint64_t t3 = (t2 * t) >> 16;
+	return 3 * t2 - 2 * t3;
+}
+
+// Fully saturated color of hue given as Q16 fraction of the wheel
+static unsigned int hue_color(uint32_t phase)
+{
+	unsigned int hue = (phase * 6 * 256) >> 16;
+	unsigned int x = hue & 0xFF;
+
+	switch (hue >> 8) {
+	case 0:
+		return 0xFF0000 | (x << 8);
+	case 1:
+		return ((0xFF - x) << 16) | 0x00FF00;
+	case 2:
+		return 0x00FF00 | x;
+	case 3:
+		return ((0xFF - x) << 8) | 0x0000FF;
+	case 4:
+		return (x << 16) | 0x0000FF;
+	default:
+		return 0xFF0000 | (0xFF - x);
+	}
+}
+
+/*
+Color of one animated LED at time now. Sets done when a finite effect
+reached its end.
+*/
+static unsigned int frame_color(const struct led_animation *anim, uint64_t now, bool *done)
+{
+	const struct effect_params *params = &anim->params;
+	uint64_t elapsed = now - anim->start;
+	uint32_t phase = ((elapsed % params->period) << 16) / params->period;
+
+	*done = false;
+
+	switch (params->effect) {
+	case EFF_FADE:
+		if (elapsed >= params->period) {
+			*done = true;
+			return params->color[0];
+		}
+		return color_lerp(anim->from, params->color[0], (elapsed << 16) / params->period);
+	case EFF_PULSE:
+		return phase < Q16_ONE / 2 ? params->color[0] : params->color[1];
+	case EFF_BREATHE: {
+		uint32_t t = phase < Q16_ONE / 2 ? 2 * phase : 2 * (Q16_ONE - 1 - phase);
+		return color_lerp(params->color[1], params->color[0], smoothstep(t));
+	}
+	case EFF_CYCLE:
+		return hue_color(phase);
+	case EFF_CHASE:
+		return (phase * anim->count) >> 16 == anim->index ? params->color[0] : params->color[1];
+	case EFF_PATTERN:
+		if (params->repeat && elapsed >= (uint64_t) params->period * params->repeat) {
+			*done = true;
+			elapsed = params->period;
+		} else {
+			elapsed %= params->period;
+		}
+		return color_lerp(0x000000, params->color[0], (pattern_brightness(&anim->pattern, elapsed) << 16) / 255);
+	case EFF_STOP:
+		break;
+	}
+
+	*done = true;
+	return params->color[0];
+}
+
+struct animator *animator_init(struct backend *backend)
+{
+	struct animator *animator = calloc(1, sizeof(*animator));
+	if (!animator) {
+		return NULL;
+	}
+
+	animator->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+	if (animator->timer_fd == -1) {
+		free(animator);
+		return NULL;
+	}
+	animator->backend = backend;
+
+	return animator;
+}
+
+void animator_destroy(struct animator *animator)
+{
+	if (animator) {
+		close(animator->timer_fd);
+		free(animator);
+	}
+}
+
+int animator_fd(struct animator *animator)
+{
+	return animator->timer_fd;
+}
+
+unsigned int animator_mask(struct animator *animator)
+{
+	return animator->mask;
+}
+
+void animator_stop(struct animator *animator, unsigned int mask, struct led_state *current)
+{
+	mask &= animator->mask;
+	animator->mask &= ~mask;
+
+	if (current) {
+		for (size_t i = 0; i < LED_COUNT; i++) {
+			if (mask & animator->written_mask & LED_BIT(i)) {
+				current->color[i] = animator->frame[i];
+				current->color_mask |= LED_BIT(i);
+			}
+		}
+	}
+
+	if (!animator->mask) {
+		timer_arm(animator, false);
+	}
+}
+
+bool animator_start(struct animator *animator, unsigned int mask, const struct effect_params *params, struct led_state *current)
+{
+	if (params->effect == EFF_STOP) {
+		animator_stop(animator, mask, current);
+		return true;
+	}
+
+	uint64_t now = now_ms();
+	unsigned int index = 0;
+	unsigned int count = popcount(mask);
+
+	for (size_t i = 0; i < LED_COUNT; i++) {
+		if (!(mask & LED_BIT(i))) {
+			continue;
+		}
+
+		struct led_animation *anim = &animator->leds[i];
+		anim->params = *params;
+		if (params->effect == EFF_PATTERN) {
+			pattern_compile(params->pattern, params->period, &anim->pattern);
+			anim->params.period = anim->pattern.cycle;
+		}
+		if (anim->params.period == 0) {
+			anim->params.period = 1;
+		}
+		anim->start = now;
+		anim->index = index++;
+		anim->count = count;
+
+		if (animator->mask & animator->written_mask & LED_BIT(i)) {
+			anim->from = animator->frame[i];
+		} else if (current && (current->color_mask & LED_BIT(i))) {
+			anim->from = current->color[i];
+		} else {
+			anim->from = 0x000000;
+		}
+
+		// The engine owns the LED now, whatever is known about it gets stale
+		if (current) {
+			current->color_mask &= ~LED_BIT(i);
+		}
+		animator->written_mask &= ~LED_BIT(i);
+	}
+
+	bool was_idle = !animator->mask;
+	animator->mask |= mask;
+
+	return !was_idle || timer_arm(animator, true) == 0;
+}
+
+int animator_tick(struct animator *animator, struct led_state *current)
+{
+	uint64_t expirations;
+	// Missed expirations don't matter, frames are computed from the clock
+	if (read(animator->timer_fd, &expirations, sizeof(expirations)) == -1 && errno != EAGAIN) {
+		return -1;
+	}
+
+	uint64_t now = now_ms();
+	unsigned int finished = 0;
+	bool changed = false;
+
+	for (size_t i = 0; i < LED_COUNT; i++) {
+		if (!(animator->mask & LED_BIT(i))) {
+			continue;
+		}
+
+		bool done;
+		unsigned int color = frame_color(&animator->leds[i], now, &done);
+		if (done) {
+			finished |= LED_BIT(i);
+		}
+		if ((animator->written_mask & LED_BIT(i)) && animator->frame[i] == color) {
+			continue;
+		}
+
+		animator->written_mask &= ~LED_BIT(i);
+		if (backend_set_color(animator->backend, i, color) == -1) {
+			return -1;
+		}
+		animator->frame[i] = color;
+		animator->written_mask |= LED_BIT(i);
+		changed = true;
+	}
+
+	if (changed && backend_commit(animator->backend) == -1) {
+		animator->written_mask = 0;
+		return -1;
+	}
+
+	if (finished) {
+		animator_stop(animator, finished, current);
+	}
+
+	return 0;
+}
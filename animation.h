@@ -0,0 +1,71 @@
+/*
+ * Rainbow is a tool for changing color and status of the LEDs of the Turris router
+ *
+ * Copyright (C) 2016 CZ.NIC, z.s.p.o. (http://www.nic.cz/)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ANIMATION_H
+#define ANIMATION_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "arg_parser.h"
+#include "backend.h"
+#include "plan.h"
+
+struct effect_params {
+	enum effect effect;
+	unsigned int color[2];
+	unsigned int period; // ms
+	unsigned int group; // LEDs animated together, chase moves across them
+	// EFF_PATTERN runs this pattern (period is its period) in color[0]
+	enum pattern_effect pattern;
+	unsigned int repeat; // runs of the pattern, 0 forever
+};
+
+/*
+Animation engine driven by a timerfd. The timer runs only while something
+is animated, so an idle engine causes no wakeups. Frames are computed in
+fixed-point and only LEDs whose color changed are written.
+*/
+struct animator;
+
+struct animator *animator_init(struct backend *backend);
+void animator_destroy(struct animator *animator);
+
+// File descriptor to poll for POLLIN, animator_tick() has to be called then
+int animator_fd(struct animator *animator);
+// LEDs that are animated now
+unsigned int animator_mask(struct animator *animator);
+
+/*
+Starts effect on LEDs in mask (or stops them for EFF_STOP). Colors of those
+LEDs become unknown in current, fade starts from the color current knows.
+*/
+bool animator_start(struct animator *animator, unsigned int mask, const struct effect_params *params, struct led_state *current);
+// Stops animation of LEDs in mask, their last color is stored to current
+void animator_stop(struct animator *animator, unsigned int mask, struct led_state *current);
+/*
+Computes and writes one frame. Finished animations are stopped and their
+final colors stored to current (may be NULL). Returns -1 on backend error.
+*/
+int animator_tick(struct animator *animator, struct led_state *current);
+
+// Mixes colors per channel, t is Q16 fraction of b in the result
+unsigned int color_lerp(unsigned int a, unsigned int b, uint32_t t);
+
+#endif //ANIMATION_H
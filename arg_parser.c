@@ -17,161 +17,366 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <stdio.h>
 #include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "arg_parser.h"
+#include "keyword_hash.h"
 
-struct map {
-	const char *kw;
-	enum cmd cmd;
+struct keyword {
+	const char *name;
+	enum token_type type;
+	unsigned int value;
 };
 
-static struct map kw_cmd_map[] = {
-	{KW_PWR, CMD_PWR},
-	{KW_LAN0, CMD_LAN0},
-	{KW_LAN1, CMD_LAN1},
-	{KW_LAN2, CMD_LAN2},
-	{KW_LAN3, CMD_LAN3},
-	{KW_LAN4, CMD_LAN4},
-	{KW_WAN, CMD_WAN},
-	{KW_PCI1, CMD_PCI1},
-	{KW_PCI2, CMD_PCI2},
-	{KW_PCI3, CMD_PCI3},
-	{KW_USR1, CMD_USR1},
-	{KW_USR2, CMD_USR2},
-	{KW_ALL, CMD_ALL},
-	{KW_LAN, CMD_LAN},
-	{KW_INTEN, CMD_INTEN},
-	{KW_BINMASK, CMD_BINMASK},
-	{KW_GET, CMD_GET},
-	{NULL, CMD_UNDEF}
-};
+// Perfect hash table of commands, statuses, effects and color names
+#include "keywords.h"
 
-struct color {
-	const char *name;
-	int rgb;
-};
+// Delays of the timer trigger in milliseconds, the default is the one of the kernel
+#define TRIGGER_DELAY_DEFAULT 500
+#define TRIGGER_DELAY_MAX 3600000
+// Shorter patterns would need steps below the resolution of the kernel timer
+#define PATTERN_PERIOD_MIN 100
 
-static struct color colors[] = {
-	{ "red",	0xFF0000},
-	{ "green",	0x00FF00},
-	{ "blue",	0x0000FF},
-	{ "white",	0xFFFFFF},
-	{ "black",	0x000000},
-	{ NULL,	0}
+static const char *pattern_effects[] = {
+	[PAT_BLINK] = "blink",
+	[PAT_BREATHE] = "breathe",
+	[PAT_HEARTBEAT] = "heartbeat",
+	[PAT_SOS] = "sos"
 };
 
 struct tokenizer {
 	char **argv;
+	const unsigned int *lines;
 	int pos;
 };
 
-static bool get_color_from_name(const char *color_name, unsigned int *color)
+static const struct keyword *find_keyword(const char *param)
 {
-	for (size_t i = 0; colors[i].name != NULL; i++) {
-		if (strcmp(color_name, colors[i].name) == 0) {
-			*color = colors[i].rgb;
-			return true;
-		}
+	size_t len = strlen(param);
+	if (len == 0 || len > KEYWORD_MAX_LEN) {
+		return NULL;
 	}
 
-	return false;
+	const struct keyword *keyword = &keywords[KEYWORD_HASH(param, len)];
+	if (keyword->name && strcmp(keyword->name, param) == 0) {
+		return keyword;
+	}
+
+	return NULL;
 }
 
-static bool parse_cmd(const char *param, enum cmd *command)
+static int hex_digit(char c)
 {
-	if (param == NULL) {
+	if (c >= '0' && c <= '9') {
+		return c - '0';
+	} else if (c >= 'A' && c <= 'F') {
+		return c - 'A' + 10;
+	} else if (c >= 'a' && c <= 'f') {
+		return c - 'a' + 10;
+	}
+
+	return -1;
+}
+
+bool parse_color(const char *param, unsigned int *color)
+{
+	unsigned int value = 0;
+	size_t i;
+
+	for (i = 0; i < 6; i++) {
+		int digit = hex_digit(param[i]);
+		if (digit == -1) {
+			return false;
+		}
+		value = value << 4 | digit;
+	}
+	if (param[i] != '\0') {
 		return false;
 	}
 
-	for (size_t i = 0; kw_cmd_map[i].kw != NULL; i++) {
-		if (strcmp(param, kw_cmd_map[i].kw) == 0) {
-			*command = kw_cmd_map[i].cmd;
-			return true;
+	*color = value;
+	return true;
+}
+
+// Reads three comma separated decimal numbers, each at most its max
+static bool parse_triple(const char *param, const unsigned int *max, unsigned int *values)
+{
+	for (size_t i = 0; i < 3; i++) {
+		if (*param < '0' || *param > '9') {
+			return false;
+		}
+		values[i] = 0;
+		while (*param >= '0' && *param <= '9' && values[i] <= max[i]) {
+			values[i] = values[i] * 10 + (*param++ - '0');
+		}
+		if (values[i] > max[i] || *param != (i < 2 ? ',' : '\0')) {
+			return false;
 		}
+		param++;
 	}
 
-	return false;
+	return true;
 }
 
-static bool parse_color(const char *param, unsigned int *color)
+/*
+Color of hue (0-359), chroma and minimum component (0-255) in integers only,
+x is the second largest component.
+*/
+static unsigned int hue_rgb(unsigned int hue, unsigned int chroma, unsigned int min)
 {
-	if (param == NULL) {
+	unsigned int sector = hue / 60;
+	int distance = (int) (hue % 120) - 60;
+	unsigned int x = chroma * (60 - (distance < 0 ? -distance : distance)) / 60;
+	unsigned int r = 0, g = 0, b = 0;
+
+	switch (sector) {
+	case 0: r = chroma; g = x; break;
+	case 1: r = x; g = chroma; break;
+	case 2: g = chroma; b = x; break;
+	case 3: g = x; b = chroma; break;
+	case 4: r = x; b = chroma; break;
+	default: r = chroma; b = x; break;
+	}
+
+	return (r + min) << 16 | (g + min) << 8 | (b + min);
+}
+
+/*
+Parses hsv:H,S,V and hsl:H,S,L with hue in degrees (0-359) and the rest in
+percent.
+*/
+static bool parse_hue_color(const char *param, unsigned int *color)
+{
+	static const unsigned int max[] = { 359, 100, 100 };
+	unsigned int values[3];
+	bool hsv = strncmp(param, "hsv:", 4) == 0;
+
+	if ((!hsv && strncmp(param, "hsl:", 4) != 0) || !parse_triple(param + 4, max, values)) {
 		return false;
 	}
 
-	//Is param pre-defined color?
-	if (get_color_from_name(param, color)) {
-		return true;
+	unsigned int saturation = values[1], level = values[2] * 255 / 100;
+	if (hsv) {
+		unsigned int chroma = level * saturation / 100;
+		*color = hue_rgb(values[0], chroma, level - chroma);
+	} else {
+		unsigned int spread = values[2] < 50 ? 2 * values[2] : 200 - 2 * values[2];
+		unsigned int chroma = spread * saturation * 255 / 10000;
+		unsigned int half = (chroma + 1) / 2;
+		*color = hue_rgb(values[0], chroma, level > half ? level - half : 0);
 	}
 
-	//Is param color in format AABBCC?
-	//No 0x prefix is accepted
-	if (strlen(param) == 6) {
-		for (size_t i = 0; i < 6; i++) {
-			if ((param[i] < '0' || param[i] > '9') &&
-				(param[i] < 'A' || param[i] > 'F') &&
-				(param[i] < 'a' || param[i] > 'f')) {
-					return false;
-			}
-		}
-		char *endptr = (char *)param;
-		long int tmp_number = strtol(param, &endptr, 16);
+	return true;
+}
 
-		if (param == endptr) {
-			//There wheren't any number
-			return false;
-		}
+static bool parse_number(const char *param, unsigned int *number)
+{
+	char *endptr = (char *)param;
+	long int tmp_number = strtol(param, &endptr, 0);
 
-		*color = (unsigned int) tmp_number;
-		return true;
+	if (param == endptr) {
+		//There weren't any number
+		return false;
 	}
 
-	//OK, it is not color
-	return false;
+	*number = tmp_number;
+
+	return true;
 }
 
-static bool parse_status(const char *param, enum status *status)
+// Decimal number up to TRIGGER_DELAY_MAX ended by end, param is moved past the end
+static bool parse_delay(const char **param, char end, unsigned int *delay)
 {
-	if (param == NULL) {
+	const char *pos = *param;
+
+	if (*pos < '0' || *pos > '9') {
+		return false;
+	}
+	*delay = 0;
+	while (*pos >= '0' && *pos <= '9' && *delay <= TRIGGER_DELAY_MAX) {
+		*delay = *delay * 10 + (*pos++ - '0');
+	}
+	if (*delay > TRIGGER_DELAY_MAX || *pos != end) {
 		return false;
 	}
+	*param = pos + 1;
+
+	return true;
+}
+
+static bool parse_netdev_modes(const char *param, unsigned int *modes)
+{
+	*modes = 0;
+	while (true) {
+		size_t len = strcspn(param, ",");
+		if (len == 4 && strncmp(param, "link", 4) == 0) {
+			*modes |= TRIGGER_LINK;
+		} else if (len == 2 && strncmp(param, "rx", 2) == 0) {
+			*modes |= TRIGGER_RX;
+		} else if (len == 2 && strncmp(param, "tx", 2) == 0) {
+			*modes |= TRIGGER_TX;
+		} else {
+			return false;
+		}
+		if (param[len] == '\0') {
+			return true;
+		}
+		param += len + 1;
+	}
+}
 
-	if (strcmp(param, KW_ENABLE) == 0) {
-		*status = ST_ENABLE;
+static bool parse_pattern(const char *param, struct trigger *trigger)
+{
+	size_t len = strcspn(param, ":");
+	bool found = false;
+
+	for (size_t i = 0; i < sizeof(pattern_effects) / sizeof(*pattern_effects) && !found; i++) {
+		if (strlen(pattern_effects[i]) == len && strncmp(param, pattern_effects[i], len) == 0) {
+			trigger->pattern = i;
+			found = true;
+		}
+	}
+	if (!found) {
+		return false;
+	} else if (param[len] == '\0') {
 		return true;
+	}
 
-	} else if (strcmp(param, KW_DISABLE) == 0) {
-		*status = ST_DISABLE;
+	param += len + 1;
+	if (!parse_delay(&param, strchr(param, ':') ? ':' : '\0', &trigger->period) ||
+		trigger->period < PATTERN_PERIOD_MIN) {
+		return false;
+	} else if (param[-1] == '\0') {
 		return true;
+	}
+	return parse_delay(&param, '\0', &trigger->repeat) && trigger->repeat > 0;
+}
+
+bool parse_trigger(const char *param, enum status *status, struct trigger *trigger)
+{
+	*trigger = (struct trigger) { .modes = 0 };
 
-	} else if (strcmp(param, KW_AUTO) == 0) {
-		*status = ST_AUTO;
+	if (strcmp(param, "activity") == 0) {
+		*status = ST_ACTIVITY;
 		return true;
+	} else if (strcmp(param, "disk") == 0) {
+		*status = ST_DISK;
+		return true;
+	} else if (strncmp(param, "timer", 5) == 0) {
+		*status = ST_TIMER;
+		trigger->delay_on = TRIGGER_DELAY_DEFAULT;
+		trigger->delay_off = TRIGGER_DELAY_DEFAULT;
+		if (param[5] == '\0') {
+			return true;
+		} else if (param[5] != ':') {
+			return false;
+		}
+		param += 6;
+		return parse_delay(&param, ',', &trigger->delay_on) && parse_delay(&param, '\0', &trigger->delay_off);
+	} else if (strncmp(param, "pattern:", 8) == 0) {
+		*status = ST_PATTERN;
+		return parse_pattern(param + 8, trigger);
+	} else if (strncmp(param, "netdev:", 7) == 0) {
+		*status = ST_NETDEV;
+		param += 7;
+		size_t len = strcspn(param, ":/");
+		if (!len || len >= TRIGGER_DEV_MAX || param[len] == '/') {
+			return false;
+		}
+		memcpy(trigger->dev, param, len);
+		if (param[len] == '\0') {
+			trigger->modes = TRIGGER_LINK | TRIGGER_RX | TRIGGER_TX;
+			return true;
+		}
+		return parse_netdev_modes(param + len + 1, &trigger->modes);
 	}
 
 	return false;
 }
 
-static bool parse_number(const char *param, unsigned int *number)
+const char *cmd_keyword(enum cmd cmd)
 {
-	if (param == NULL) {
-		return false;
+	for (size_t i = 0; i < sizeof(keywords) / sizeof(*keywords); i++) {
+		if (keywords[i].name && keywords[i].type == TOK_CMD && keywords[i].value == (unsigned int) cmd) {
+			return keywords[i].name;
+		}
 	}
 
-	char *endptr = (char *)param;
-	long int tmp_number = strtol(param, &endptr, 0);
+	return NULL;
+}
 
-	if (param == endptr) {
-		//There weren't any number
-		return false;
+const char *status_keyword(enum status status)
+{
+	switch (status) {
+	case ST_DISABLE:
+		return KW_DISABLE;
+	case ST_ENABLE:
+		return KW_ENABLE;
+	case ST_AUTO:
+		return KW_AUTO;
+	case ST_NETDEV:
+		return "netdev";
+	case ST_TIMER:
+		return "timer";
+	case ST_ACTIVITY:
+		return "activity";
+	case ST_DISK:
+		return "disk";
+	case ST_PATTERN:
+		return "pattern";
 	}
 
-	*number = tmp_number;
+	return NULL;
+}
 
-	return true;
+bool status_format(enum status status, const struct trigger *trigger, char buff[STATUS_TEXT_MAX])
+{
+	static const char *modes[] = {"link", "rx", "tx"};
+	size_t len = snprintf(buff, STATUS_TEXT_MAX, "%s", status_keyword(status));
+
+	switch (status) {
+	case ST_NETDEV:
+		if (!trigger->dev[0] || trigger->dev[strcspn(trigger->dev, ":/")] || !trigger->modes) {
+			return false;
+		}
+		len += snprintf(buff + len, STATUS_TEXT_MAX - len, ":%s", trigger->dev);
+		if (trigger->modes == (TRIGGER_LINK | TRIGGER_RX | TRIGGER_TX)) {
+			return true;
+		}
+		char separator = ':';
+		for (size_t i = 0; i < sizeof(modes) / sizeof(*modes); i++) {
+			if (trigger->modes & (1 << i)) {
+				len += snprintf(buff + len, STATUS_TEXT_MAX - len, "%c%s", separator, modes[i]);
+				separator = ',';
+			}
+		}
+		return true;
+	case ST_TIMER:
+		if (trigger->delay_on > TRIGGER_DELAY_MAX || trigger->delay_off > TRIGGER_DELAY_MAX) {
+			return false;
+		}
+		snprintf(buff + len, STATUS_TEXT_MAX - len, ":%u,%u", trigger->delay_on, trigger->delay_off);
+		return true;
+	case ST_PATTERN:
+		if (trigger->pattern >= sizeof(pattern_effects) / sizeof(*pattern_effects) ||
+			trigger->period > TRIGGER_DELAY_MAX || trigger->repeat > TRIGGER_DELAY_MAX ||
+			(trigger->period && trigger->period < PATTERN_PERIOD_MIN) || (trigger->repeat && !trigger->period)) {
+			return false;
+		}
+		len += snprintf(buff + len, STATUS_TEXT_MAX - len, ":%s", pattern_effects[trigger->pattern]);
+		if (trigger->period) {
+			len += snprintf(buff + len, STATUS_TEXT_MAX - len, ":%u", trigger->period);
+		}
+		if (trigger->repeat) {
+			snprintf(buff + len, STATUS_TEXT_MAX - len, ":%u", trigger->repeat);
+		}
+		return true;
+	default:
+		return true;
+	}
 }
 
 struct tokenizer *tokenizer_init(char **argv, int from)
@@ -182,11 +387,33 @@ struct tokenizer *tokenizer_init(char **argv, int from)
 	}
 
 	ret->argv = argv;
+	ret->lines = NULL;
 	ret->pos = from;
 
 	return ret;
 }
 
+void tokenizer_reset(struct tokenizer *tokenizer, char **argv, int from)
+{
+	tokenizer->argv = argv;
+	tokenizer->lines = NULL;
+	tokenizer->pos = from;
+}
+
+void tokenizer_set_lines(struct tokenizer *tokenizer, const unsigned int *lines)
+{
+	tokenizer->lines = lines;
+}
+
+unsigned int tokenizer_line(struct tokenizer *tokenizer)
+{
+	if (!tokenizer->lines || !tokenizer->argv[0]) {
+		return 0;
+	}
+
+	return tokenizer->lines[tokenizer->pos ? tokenizer->pos - 1 : 0];
+}
+
 void tokenizer_destroy(struct tokenizer *tokenizer)
 {
 	free(tokenizer);
@@ -194,25 +421,42 @@ void tokenizer_destroy(struct tokenizer *tokenizer)
 
 struct token next_token(struct tokenizer *tokenizer)
 {
+	const char *param = tokenizer->argv[tokenizer->pos];
 	struct token token = (struct token) {
 		.type = TOK_UNDEF,
-		.raw = tokenizer->argv[tokenizer->pos]
+		.raw = param
 	};
+	const struct keyword *keyword;
+	struct trigger trigger;
 
-	if (tokenizer->argv[tokenizer->pos] == NULL) {
+	if (param == NULL) {
 		token.type = TOK_EOF;
+		return token;
+
+	} else if ((keyword = find_keyword(param))) {
+		token.type = keyword->type;
+		switch (keyword->type) {
+		case TOK_CMD:
+			token.data.cmd = keyword->value;
+			break;
+		case TOK_STATUS:
+			token.data.status = keyword->value;
+			break;
+		case TOK_EFFECT:
+			token.data.effect = keyword->value;
+			break;
+		default:
+			token.data.color = keyword->value;
+			break;
+		}
 
-	} else if (parse_cmd(tokenizer->argv[tokenizer->pos], &token.data.cmd)) {
-		token.type = TOK_CMD;
+	} else if (parse_color(param, &token.data.color) || parse_hue_color(param, &token.data.color)) {
+		token.type = TOK_COLOR;
 
-	} else if (parse_status(tokenizer->argv[tokenizer->pos], &token.data.status)) {
-		//This part has to be before color parser because "enable" is valid color in color parser
+	} else if (parse_trigger(param, &token.data.status, &trigger)) {
 		token.type = TOK_STATUS;
 
-	} else if (parse_color(tokenizer->argv[tokenizer->pos], &token.data.color)) {
-		token.type = TOK_COLOR;
-
-	} else if (parse_number(tokenizer->argv[tokenizer->pos], &token.data.number)) {
+	} else if (parse_number(param, &token.data.number)) {
 		token.type = TOK_NUMBER;
 
 	}
@@ -221,3 +465,12 @@ struct token next_token(struct tokenizer *tokenizer)
 	tokenizer->pos++;
 	return token;
 }
+
+struct token peek_token(struct tokenizer *tokenizer)
+{
+	int pos = tokenizer->pos;
+	struct token token = next_token(tokenizer);
+	tokenizer->pos = pos;
+
+	return token;
+}
@@ -48,10 +48,63 @@
 #define KW_AUTO		"auto"
 #define KW_GET		"get"
 
+// Effects
+#define KW_FADE		"fade"
+#define KW_PULSE	"pulse"
+#define KW_BREATHE	"breathe"
+#define KW_CYCLE	"cycle"
+#define KW_CHASE	"chase"
+#define KW_STOP		"stop"
+
 enum status {
 	ST_DISABLE = 0,
 	ST_ENABLE = 1,
-	ST_AUTO = 2
+	ST_AUTO = 2,
+	// Kernel LED triggers, the kernel blinks the LED on its own
+	ST_NETDEV = 3,
+	ST_TIMER = 4,
+	ST_ACTIVITY = 5,
+	ST_DISK = 6,
+	ST_PATTERN = 7
+};
+
+#define STATUS_TRIGGER(status) ((status) >= ST_NETDEV)
+
+// Events shown by the netdev trigger
+#define TRIGGER_LINK	0x1
+#define TRIGGER_RX	0x2
+#define TRIGGER_TX	0x4
+
+#define TRIGGER_DEV_MAX 16
+
+// Effects the pattern trigger runs, see pattern.h
+enum pattern_effect {
+	PAT_BLINK,
+	PAT_BREATHE,
+	PAT_HEARTBEAT,
+	PAT_SOS
+};
+
+// Parameters of a trigger status, fields the trigger doesn't use are zero
+struct trigger {
+	char dev[TRIGGER_DEV_MAX];
+	unsigned int modes;
+	unsigned int delay_on;
+	unsigned int delay_off;
+	unsigned int pattern; // enum pattern_effect
+	unsigned int period; // ms of one run of the pattern, 0 for its default
+	unsigned int repeat; // runs of the pattern, 0 forever
+};
+
+enum effect {
+	EFF_FADE,
+	EFF_PULSE,
+	EFF_BREATHE,
+	EFF_CYCLE,
+	EFF_CHASE,
+	EFF_STOP,
+	// Userspace run of a pattern when the kernel has no pattern trigger
+	EFF_PATTERN
 };
 
 enum cmd {
@@ -81,6 +134,7 @@ enum token_type {
 	TOK_NUMBER,
 	TOK_COLOR,
 	TOK_STATUS,
+	TOK_EFFECT,
 	TOK_EOF
 };
 
@@ -91,14 +145,44 @@ struct token {
 		unsigned int number;
 		unsigned int color;
 		enum status status;
+		enum effect effect;
 	} data;
 	const char *raw;
 };
 
 struct tokenizer;
 
+// Keywords for printing, NULL if there is none
+const char *cmd_keyword(enum cmd cmd);
+const char *status_keyword(enum status status);
+
+/*
+Parses netdev:IFACE[:MODES], timer[:ON,OFF], activity, disk and
+pattern:EFFECT[:PERIOD[:COUNT]]. MODES is a comma separated list of link, rx
+and tx (all of them by default), delays and period are in milliseconds (500
+each by default for timer). EFFECT is blink, breathe, heartbeat or sos.
+Tokens of triggers are TOK_STATUS, their parameters are parsed again from the
+raw string.
+*/
+bool parse_trigger(const char *param, enum status *status, struct trigger *trigger);
+// Color in format RRGGBB, no 0x prefix is accepted
+bool parse_color(const char *param, unsigned int *color);
+/*
+Status as text parse_trigger() reads back, with the parameters of a trigger.
+False when the parameters have no such text.
+*/
+#define STATUS_TEXT_MAX 64
+bool status_format(enum status status, const struct trigger *trigger, char buff[STATUS_TEXT_MAX]);
+
 struct token next_token(struct tokenizer *tokenizer);
+// Returns the token next_token() would return without consuming it
+struct token peek_token(struct tokenizer *tokenizer);
 struct tokenizer *tokenizer_init(char **argv, int from);
+void tokenizer_reset(struct tokenizer *tokenizer, char **argv, int from);
+// Lines of a script argv comes from (see script_lines()), reset drops them
+void tokenizer_set_lines(struct tokenizer *tokenizer, const unsigned int *lines);
+// Line of the last token consumed, 0 when the arguments are no script
+unsigned int tokenizer_line(struct tokenizer *tokenizer);
 void tokenizer_destroy(struct tokenizer *tokenizer);
 
 #endif //ARG_PARSER_H
@@ -19,153 +19,264 @@
 
 #include <stdbool.h>
 #include <string.h>
-#include <unistd.h>
 #include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <sys/types.h>
-#include <sys/stat.h>
-#include <fcntl.h>
+#include <stdint.h>
+#include <time.h>
 
 #include "configuration.h"
 #include "arg_parser.h"
 #include "backend.h"
-#include "util.c"
-
-#define SYS_PATH "/sys/devices/platform/soc/soc:internal-regs/f1011000.i2c/i2c-0/i2c-1/1-002b"
-#define LED_PREFIX "leds/omnia-led"
-
-static char *led_map[] = {
-	[CMD_PWR] = "power",
-	[CMD_LAN0] = "lan0",
-	[CMD_LAN1] = "lan1",
-	[CMD_LAN2] = "lan2",
-	[CMD_LAN3] = "lan3",
-	[CMD_LAN4] = "lan4",
-	[CMD_WAN] = "wan",
-	[CMD_PCI1] = "pci1",
-	[CMD_PCI2] = "pci2",
-	[CMD_PCI3] = "pci3",
-	[CMD_USR1] = "user1",
-	[CMD_USR2] = "user2",
-	[CMD_ALL] = "all"
-};
-
-static void backend_write(const char *path, const char *value)
-{
-	int fd = open(path, O_WRONLY);
-	if (fd == -1) {
-		fprintf(stderr, "Failed to open file: %s\n", strerror(errno));
-		exit(3);
-	}
-	size_t len = strlen(value);
-	while (len > 0) {
-		int ret = write(fd, value, len);
-		if (ret == -1) {
-			if (errno == EINTR) {
-				continue;
-			} else {
-				fprintf(stderr, "Write error: %s\n", strerror(errno));
-				exit(3);
-			}
+#include "i2c_transport.h"
+#include "stats.h"
+
+static uint64_t now_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static struct backend *create(const char *spec)
+{
+	const char *colon = strchr(spec, ':');
+	size_t name_len = colon ? (size_t) (colon - spec) : strlen(spec);
+	const char *arg = colon ? colon + 1 : NULL;
+	char name[name_len + 1];
+
+	memcpy(name, spec, name_len);
+	name[name_len] = '\0';
+
+	if (strcmp(name, "sysfs") == 0) {
+		return backend_sysfs_init(arg);
+
+	} else if (strcmp(name, "uring") == 0) {
+		return backend_uring_init(arg);
+
+	} else if (strcmp(name, "i2c") == 0 || strcmp(name, "i2c-record") == 0) {
+		struct i2c_transport *transport;
+		if (strcmp(name, "i2c") == 0) {
+			transport = i2c_transport_dev(arg ? arg : I2C_ADAPTER);
+		} else {
+			transport = i2c_transport_record(arg ? arg : "-");
 		}
+		if (!transport) {
+			return NULL;
+		}
+		struct backend *backend = backend_i2c_init(transport);
+		if (!backend) {
+			transport->destroy(transport);
+		}
+		return backend;
+
+	} else if (strcmp(name, "record") == 0) {
+		return backend_recording_init();
+
+	} else if (strcmp(name, "shm") == 0) {
+		return backend_shm_init();
+
+	} else if (strcmp(name, "null") == 0) {
+		return backend_null_init();
 
-		value += ret;
-		len -= ret;
+	} else if (strcmp(name, "plan") == 0) {
+		return backend_plan_init();
+
+	} else if (strcmp(name, "async") == 0) {
+		struct backend *inner = backend_create(arg ? arg : "sysfs");
+		if (!inner) {
+			return NULL;
+		}
+		struct backend *backend = backend_async_init(inner);
+		if (!backend) {
+			backend_destroy(inner);
+		}
+		return backend;
 	}
 
-	close(fd);
+	errno = EINVAL;
+	return NULL;
 }
-static void backend_read(const char *path, char *buff, size_t len)
+
+struct backend *backend_create(const char *spec)
 {
-	int fd = open(path, O_RDONLY);
-	if (fd == -1) {
-		fprintf(stderr, "Failed to open file: %s\n", strerror(errno));
-		exit(3);
+	struct backend *backend = create(spec);
+	if (backend && !backend->inner) {
+		// Without the counters the backend works the same, they are just not collected
+		backend->detail = calloc(1, sizeof(*backend->detail));
+		backend->flushed_ms = now_ns() / 1000000;
 	}
-	while (len > 0) {
-		int ret = read(fd, buff, len);
-		if (ret == 0) {
-			//EOF
-			close(fd);
-			return;
 
-		} else if (ret == -1) {
-			if (errno == EINTR) {
-				continue;
-			} else {
-				fprintf(stderr, "Read error: %s\n", strerror(errno));
-				exit(3);
-			}
-		}
+	return backend;
+}
 
-		buff += ret;
-		len -= ret;
+// Returns start time of the call, 0 when it is neither recorded nor traced
+static uint64_t record_begin(struct backend *backend, size_t target, enum stats_op op)
+{
+	if (backend->detail && !backend->inner) {
+		backend->active = &backend->detail->op[target][op];
 	}
+	return backend->active || backend->trace ? now_ns() : 0;
+}
 
-	close(fd);
+static int record_end(struct backend *backend, size_t target, enum stats_op op, uint64_t start, int ret)
+{
+	if (!start) {
+		return ret;
+	}
+
+	int err = errno;
+	uint64_t ns = now_ns() - start;
+	if (backend->trace) {
+		fprintf(backend->trace, "%-6s %-9s %8.1f us%s%s\n", stats_target_name(target), stats_op_name(op),
+			ns / 1000.0, ret == -1 ? " " : "", ret == -1 ? strerror(err) : "");
+	}
+	if (backend->active) {
+		stats_record(backend->active, ns, ret != -1);
+		backend->active = NULL;
+	}
+	errno = err;
+
+	return ret;
 }
 
-static void get_rgb_parts(unsigned int color, unsigned char *r, unsigned char *g, unsigned char *b) {
-	*r = ((color & 0xFF0000) >> 2*8);
-	*g = ((color & 0x00FF00) >> 8);
-	*b = (color & 0x0000FF);
+// Adds detail to STATS_FILE, without force only once per STATS_INTERVAL
+static void stats_flush(struct backend *backend, bool force)
+{
+	if (!backend->hardware || !backend->keep_stats || !backend->detail || backend->inner) {
+		return;
+	}
+
+	uint64_t now = now_ns() / 1000000;
+	if (!force && now - backend->flushed_ms < STATS_INTERVAL) {
+		return;
+	}
+	if (stats_merge(STATS_FILE, backend->detail)) {
+		memset(backend->detail, 0, sizeof(*backend->detail));
+	}
+	backend->flushed_ms = now;
 }
 
-void set_intensity(unsigned int level)
+int backend_set_color(struct backend *backend, enum cmd cmd, unsigned int color)
 {
-	const char *path = aprintf("%s/%s", SYS_PATH, "global_brightness");
-	const char *value = aprintf("%u", level);
-	backend_write(path, value);
+	uint64_t start = record_begin(backend, cmd, STATS_COLOR);
+	return record_end(backend, cmd, STATS_COLOR, start, backend->ops->set_color(backend, cmd, color));
 }
 
-int get_intensity()
+int backend_set_status(struct backend *backend, enum cmd cmd, enum status status)
 {
-	/*
-	The maximum value of brightness/intensity is 100. Greater number (longer
-	string) is invalid input. + 1 for '\0' at the end of the string.
-	*/
-	const size_t bufflen = 4;
-	char buff[bufflen];
-	int level;
+	uint64_t start = record_begin(backend, cmd, STATS_STATUS);
+	return record_end(backend, cmd, STATS_STATUS, start, backend->ops->set_status(backend, cmd, status));
+}
 
-	const char *path = aprintf("%s/%s", SYS_PATH, "global_brightness");
-	backend_read(path, buff, bufflen);
-	buff[bufflen - 1] = '\0'; // Just to make sure we have one
+int backend_set_intensity(struct backend *backend, unsigned int level)
+{
+	uint64_t start = record_begin(backend, STATS_GLOBAL, STATS_INTENSITY);
+	return record_end(backend, STATS_GLOBAL, STATS_INTENSITY, start, backend->ops->set_intensity(backend, level));
+}
 
-	int ret = sscanf(buff, "%d", &level);
-	if (ret != 1) {
-		fprintf(stderr, "Read error: %s\n", strerror(errno));
-		exit(3);
+int backend_get_intensity(struct backend *backend, unsigned int *level)
+{
+	uint64_t start = record_begin(backend, STATS_GLOBAL, STATS_READ);
+	return record_end(backend, STATS_GLOBAL, STATS_READ, start, backend->ops->get_intensity(backend, level));
+}
+
+int backend_get_led(struct backend *backend, enum cmd cmd, unsigned int *color, enum status *status,
+	struct trigger *trigger)
+{
+	if (!backend->ops->get_led) {
+		errno = ENOTSUP;
+		return -1;
 	}
 
-	return level;
+	uint64_t start = record_begin(backend, cmd, STATS_READ);
+	return record_end(backend, cmd, STATS_READ, start, backend->ops->get_led(backend, cmd, color, status,
+		trigger));
+}
+
+int backend_set_trigger(struct backend *backend, enum cmd cmd, enum status status, const struct trigger *trigger)
+{
+	if (!backend->ops->set_trigger) {
+		errno = ENOTSUP;
+		return -1;
+	}
+
+	uint64_t start = record_begin(backend, cmd, STATS_STATUS);
+	return record_end(backend, cmd, STATS_STATUS, start, backend->ops->set_trigger(backend, cmd, status, trigger));
+}
+
+int backend_has_trigger(struct backend *backend, enum cmd cmd, enum status status, bool *available)
+{
+	if (!backend->ops->has_trigger) {
+		*available = backend->ops->set_trigger != NULL;
+		return 0;
+	}
+
+	uint64_t start = record_begin(backend, cmd, STATS_READ);
+	return record_end(backend, cmd, STATS_READ, start, backend->ops->has_trigger(backend, cmd, status, available));
+}
+
+int backend_commit(struct backend *backend)
+{
+	uint64_t start = record_begin(backend, STATS_GLOBAL, STATS_COMMIT);
+	int ret = record_end(backend, STATS_GLOBAL, STATS_COMMIT, start, backend->ops->commit(backend));
+	stats_flush(backend, false);
+	return ret;
 }
 
-void set_color(enum cmd cmd, unsigned int color)
+void backend_count_io(struct backend *backend, unsigned long bytes, unsigned long retries)
 {
-	unsigned char r, g, b;
-	get_rgb_parts(color, &r, &g, &b);
+	if (backend->active) {
+		backend->active->bytes += bytes;
+		backend->active->retries += retries;
+	}
+}
 
-	const char *path = aprintf("%s/%s:%s/%s", SYS_PATH, LED_PREFIX, led_map[cmd], "color");
-	const char *value = aprintf("%d %d %d", r, g, b);
-	backend_write(path, value);
+void backend_elided(struct backend *backend, enum cmd cmd, enum stats_op op)
+{
+	if (backend->detail) {
+		backend->detail->op[cmd == CMD_UNDEF ? STATS_GLOBAL : cmd][op].elided++;
+	}
 }
 
-void set_status(enum cmd cmd, enum status status)
+void backend_expanded(struct backend *backend, enum cmd cmd, enum stats_op op)
 {
-	const char *path_autonomous = aprintf("%s/%s:%s/%s", SYS_PATH, LED_PREFIX, led_map[cmd], "autonomous");
-	const char *path_brightness = aprintf("%s/%s:%s/%s", SYS_PATH, LED_PREFIX, led_map[cmd], "brightness");
+	if (backend->detail) {
+		backend->detail->op[cmd][op].expanded++;
+	}
+}
 
-	if (status == ST_DISABLE) {
-		backend_write(path_autonomous, "0");
-		backend_write(path_brightness, "0");
+void backend_stats(struct backend *backend, struct backend_stats *stats)
+{
+	memset(stats, 0, sizeof(*stats));
+	backend->ops->stats(backend, stats);
+}
 
-	} else if (status == ST_ENABLE) {
-		backend_write(path_autonomous, "0");
-		backend_write(path_brightness, "255");
+bool backend_triggers(struct backend *backend)
+{
+	// A wrapper hands triggers over to its inner backend
+	while (backend->inner) {
+		backend = backend->inner;
+	}
+	return backend->ops->has_trigger != NULL;
+}
+
+void backend_keep_stats(struct backend *backend)
+{
+	// Calls are recorded by the inner backend of a wrapper
+	while (backend->inner) {
+		backend = backend->inner;
+	}
+	backend->keep_stats = true;
+}
 
-	} else if (status == ST_AUTO) {
-		backend_write(path_autonomous, "1");
+void backend_destroy(struct backend *backend)
+{
+	if (backend) {
+		struct write_stats *detail = backend->inner ? NULL : backend->detail;
+		// What is left since the last flush
+		stats_flush(backend, true);
+		backend->ops->destroy(backend);
+		free(detail);
 	}
 }
@@ -21,12 +21,138 @@
 #define BACKEND_H
 
 #include <stdbool.h>
+#include <stdio.h>
 
 #include "arg_parser.h"
+#include "i2c_transport.h"
+#include "stats.h"
 
-void set_intensity(unsigned int level);
-void set_color(enum cmd cmd, unsigned int color);
-void set_status(enum cmd cmd, enum status status);
-int get_intensity();
+struct backend_stats {
+	unsigned long calls; // calls of set_* and get_* operations
+	unsigned long writes; // writes that reach the device (attribute files, I2C messages)
+	unsigned long bytes;
+	unsigned long reads;
+	unsigned long opens;
+	unsigned long transactions; // syscalls that carried the writes
+	unsigned long errors;
+};
+
+struct backend;
+
+/*
+Operations of one backend. All of them return 0 on success or -1 with errno
+set. Setters may only queue the change, it has to be visible on the device
+after commit. Get_led reads color and status of a single LED back from the
+device, with the parameters of a trigger status. An LED driven by a kernel
+trigger that has no matching status fails with ENOMSG. It is optional and
+backends that can't read leave it NULL.
+Set_trigger hands a single LED over to the kernel LED trigger of a trigger
+status (see STATUS_TRIGGER) with its parameters. Called with any other status
+it removes the trigger, set_status follows then. It is optional as well.
+Has_trigger tells whether the kernel offers the trigger of status for the
+LED, backends that set triggers without knowing which exist leave it NULL.
+*/
+struct backend_ops {
+	const char *name;
+	int (*set_color)(struct backend *backend, enum cmd cmd, unsigned int color);
+	int (*set_status)(struct backend *backend, enum cmd cmd, enum status status);
+	int (*set_intensity)(struct backend *backend, unsigned int level);
+	int (*get_intensity)(struct backend *backend, unsigned int *level);
+	int (*get_led)(struct backend *backend, enum cmd cmd, unsigned int *color, enum status *status,
+		struct trigger *trigger);
+	int (*set_trigger)(struct backend *backend, enum cmd cmd, enum status status, const struct trigger *trigger);
+	int (*has_trigger)(struct backend *backend, enum cmd cmd, enum status status, bool *available);
+	int (*commit)(struct backend *backend);
+	void (*stats)(struct backend *backend, struct backend_stats *stats);
+	void (*destroy)(struct backend *backend);
+};
+
+/*
+Implementations embed this structure as their first member.
+Hardware is set by backends that drive the real LEDs, only those use the
+stored LED state and STATS_FILE. Fans_out is set when there is no 'all' LED
+and a write of CMD_ALL is one write of every LED, the planner doesn't use
+it then.
+Detail is allocated by backend_create() and filled by the backend_* calls,
+active points to the counters of the call in progress meanwhile. Wrappers
+set inner to the backend they forward to, share its detail and don't record
+their own calls. Detail goes to STATS_FILE only after backend_keep_stats().
+When trace is set, every backend_* call is printed to it with its duration.
+*/
+struct backend {
+	const struct backend_ops *ops;
+	bool hardware;
+	bool fans_out;
+	bool keep_stats;
+	struct backend *inner;
+	struct write_stats *detail;
+	struct op_stats *active;
+	uint64_t flushed_ms;
+	FILE *trace;
+};
+
+// Sysfs attributes of the LEDs found in root/leds (NULL means LED_CLASS_DIR)
+struct backend *backend_sysfs_init(const char *root);
+/*
+The same attributes written in batches by io_uring, all writes between commits
+are submitted by one syscall. Falls back to sysfs when io_uring is missing.
+*/
+struct backend *backend_uring_init(const char *root);
+// LED controller of the MCU, takes ownership of transport
+struct backend *backend_i2c_init(struct i2c_transport *transport);
+// Counts calls and keeps log of them in memory
+struct backend *backend_recording_init();
+void backend_recording_dump(struct backend *backend, FILE *out);
+// Producer of the shared framebuffer (FRAMEBUFFER_FILE)
+struct backend *backend_shm_init();
+// Accepts everything and does nothing
+struct backend *backend_null_init();
+/*
+Writes nothing, keeps the attribute writes the sysfs backend would do for
+the calls, so a command can be shown before it is run.
+*/
+struct backend *backend_plan_init();
+// Prints the writes grouped by LED, with explain also their cost per LED
+void backend_plan_dump(struct backend *backend, FILE *out, bool explain);
+/*
+Returns at once from every call, a writer thread pushes the latest values
+to inner, which it takes ownership of. Errors are reported by a later commit.
+*/
+struct backend *backend_async_init(struct backend *inner);
+
+/*
+Creates backend from its description NAME[:ARG] as accepted by --backend.
+Returns NULL with errno set on failure.
+*/
+struct backend *backend_create(const char *spec);
+
+int backend_set_color(struct backend *backend, enum cmd cmd, unsigned int color);
+int backend_set_status(struct backend *backend, enum cmd cmd, enum status status);
+int backend_set_intensity(struct backend *backend, unsigned int level);
+int backend_get_intensity(struct backend *backend, unsigned int *level);
+// Fails with ENOTSUP when the backend can't read LEDs
+int backend_get_led(struct backend *backend, enum cmd cmd, unsigned int *color, enum status *status,
+	struct trigger *trigger);
+// Fails with ENOTSUP when the backend has no kernel LED triggers
+int backend_set_trigger(struct backend *backend, enum cmd cmd, enum status status, const struct trigger *trigger);
+// Triggers are available everywhere set_trigger is, unless the backend knows better
+int backend_has_trigger(struct backend *backend, enum cmd cmd, enum status status, bool *available);
+// Whether LEDs may be left driven by kernel triggers, only backends knowing them can tell
+bool backend_triggers(struct backend *backend);
+int backend_commit(struct backend *backend);
+void backend_stats(struct backend *backend, struct backend_stats *stats);
+/*
+Adds detail to STATS_FILE every STATS_INTERVAL and on destroy, for processes
+that keep running. One-shot commands don't rewrite the file on every run.
+*/
+void backend_keep_stats(struct backend *backend);
+void backend_destroy(struct backend *backend);
+
+// Backends account bytes and EINTR retries of the call in progress
+void backend_count_io(struct backend *backend, unsigned long bytes, unsigned long retries);
+// The planner skipped a write of cmd because the LED has the value already
+void backend_elided(struct backend *backend, enum cmd cmd, enum stats_op op);
+// The planner writes a single LED that got its value from a group
+void backend_expanded(struct backend *backend, enum cmd cmd, enum stats_op op);
 
 #endif //BACKEND_H
@@ -0,0 +1,325 @@
+/*
+ * Rainbow is a tool for changing color and status of the LEDs of the Turris router
+ *
+ * Copyright (C) 2016 CZ.NIC, z.s.p.o. (http://www.nic.cz/)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include "configuration.h"
+#include "arg_parser.h"
+#include "backend.h"
+
+#define DIRTY_COLOR(cmd) (1U << (cmd))
+#define DIRTY_STATUS(cmd) (1U << (16 + (cmd)))
+#define DIRTY_INTENSITY (1U << 31)
+#define DIRTY_SINGLE_MASK (DIRTY_COLOR(CMD_ALL) - 1)
+
+/*
+Producers only store the latest value of each LED to its slot and mark it
+dirty, commit bumps seq and returns. The writer thread takes all dirty bits
+at once and pushes the values to the inner backend, so values overwritten
+before it got to them are never written. Setting the 'all' LED drops dirty
+bits of single LEDs set before it, the writer writes 'all' before the single
+LEDs that were set after it.
+
+Errors of the writer are kept and returned by the next commit. Only one
+thread may call get_intensity(), get_led(), set_trigger(), has_trigger(),
+stats() and destroy(), they wait until the writer is idle and use the inner
+backend directly.
+*/
+struct async_backend {
+	struct backend backend;
+	struct backend *inner;
+	pthread_t thread;
+	unsigned long calls;
+	uint32_t color[CMD_ALL + 1];
+	uint32_t status[CMD_ALL + 1];
+	uint32_t intensity;
+	bool intensity_valid;
+	uint32_t dirty;
+	// Commits requested and commits done by the writer, both are futexes
+	uint32_t seq;
+	uint32_t done;
+	uint32_t waiters;
+	uint32_t stop;
+	int error;
+};
+
+static long futex(uint32_t *addr, int op, uint32_t val)
+{
+	return syscall(SYS_futex, addr, op, val, NULL, NULL, 0);
+}
+
+static void publish(struct async_backend *async, uint32_t *slot, uint32_t value, uint32_t bit, bool all)
+{
+	__atomic_store_n(slot, value, __ATOMIC_RELAXED);
+	if (all) {
+		uint32_t singles = bit == DIRTY_COLOR(CMD_ALL) ? DIRTY_SINGLE_MASK : DIRTY_SINGLE_MASK << 16;
+		__atomic_and_fetch(&async->dirty, ~singles, __ATOMIC_RELAXED);
+	}
+	__atomic_or_fetch(&async->dirty, bit, __ATOMIC_RELEASE);
+}
+
+static int drain(struct async_backend *async)
+{
+	struct backend *inner = async->inner;
+	uint32_t dirty = __atomic_exchange_n(&async->dirty, 0, __ATOMIC_ACQUIRE);
+	if (!dirty) {
+		return 0;
+	}
+
+	int ret = 0;
+	if (dirty & DIRTY_COLOR(CMD_ALL)) {
+		ret |= backend_set_color(inner, CMD_ALL, __atomic_load_n(&async->color[CMD_ALL], __ATOMIC_RELAXED));
+	}
+	if (dirty & DIRTY_STATUS(CMD_ALL)) {
+		ret |= backend_set_status(inner, CMD_ALL, __atomic_load_n(&async->status[CMD_ALL], __ATOMIC_RELAXED));
+	}
+	for (int i = CMD_PWR; i < LED_COUNT; i++) {
+		if (dirty & DIRTY_COLOR(i)) {
+			ret |= backend_set_color(inner, i, __atomic_load_n(&async->color[i], __ATOMIC_RELAXED));
+		}
+		if (dirty & DIRTY_STATUS(i)) {
+			ret |= backend_set_status(inner, i, __atomic_load_n(&async->status[i], __ATOMIC_RELAXED));
+		}
+	}
+	if (dirty & DIRTY_INTENSITY) {
+		ret |= backend_set_intensity(inner, __atomic_load_n(&async->intensity, __ATOMIC_RELAXED));
+	}
+	ret |= backend_commit(inner);
+
+	return ret;
+}
+
+static void *writer(void *arg)
+{
+	struct async_backend *async = arg;
+	uint32_t handled = 0;
+
+	while (true) {
+		uint32_t seq = __atomic_load_n(&async->seq, __ATOMIC_ACQUIRE);
+		if (seq == handled) {
+			if (__atomic_load_n(&async->stop, __ATOMIC_ACQUIRE)) {
+				break;
+			}
+			futex(&async->seq, FUTEX_WAIT, seq);
+			continue;
+		}
+
+		if (drain(async) == -1) {
+			int expected = 0;
+			__atomic_compare_exchange_n(&async->error, &expected, errno, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+		}
+		handled = seq;
+
+		__atomic_store_n(&async->done, handled, __ATOMIC_SEQ_CST);
+		if (__atomic_load_n(&async->waiters, __ATOMIC_SEQ_CST)) {
+			futex(&async->done, FUTEX_WAKE, INT32_MAX);
+		}
+	}
+
+	return NULL;
+}
+
+static void kick(struct async_backend *async)
+{
+	__atomic_add_fetch(&async->seq, 1, __ATOMIC_RELEASE);
+	futex(&async->seq, FUTEX_WAKE, 1);
+}
+
+// Waits until the writer handled every commit, it sleeps afterwards
+static void wait_idle(struct async_backend *async)
+{
+	__atomic_add_fetch(&async->waiters, 1, __ATOMIC_SEQ_CST);
+	while (true) {
+		uint32_t done = __atomic_load_n(&async->done, __ATOMIC_ACQUIRE);
+		if (done == __atomic_load_n(&async->seq, __ATOMIC_ACQUIRE)) {
+			break;
+		}
+		futex(&async->done, FUTEX_WAIT, done);
+	}
+	__atomic_sub_fetch(&async->waiters, 1, __ATOMIC_SEQ_CST);
+}
+
+static int async_set_color(struct backend *backend, enum cmd cmd, unsigned int color)
+{
+	struct async_backend *async = (struct async_backend *) backend;
+
+	__atomic_add_fetch(&async->calls, 1, __ATOMIC_RELAXED);
+	publish(async, &async->color[cmd], color, DIRTY_COLOR(cmd), cmd == CMD_ALL);
+	return 0;
+}
+
+static int async_set_status(struct backend *backend, enum cmd cmd, enum status status)
+{
+	struct async_backend *async = (struct async_backend *) backend;
+
+	__atomic_add_fetch(&async->calls, 1, __ATOMIC_RELAXED);
+	publish(async, &async->status[cmd], status, DIRTY_STATUS(cmd), cmd == CMD_ALL);
+	return 0;
+}
+
+static int async_set_intensity(struct backend *backend, unsigned int level)
+{
+	struct async_backend *async = (struct async_backend *) backend;
+
+	__atomic_add_fetch(&async->calls, 1, __ATOMIC_RELAXED);
+	publish(async, &async->intensity, level, DIRTY_INTENSITY, false);
+	async->intensity_valid = true;
+	return 0;
+}
+
+static int async_get_intensity(struct backend *backend, unsigned int *level)
+{
+	struct async_backend *async = (struct async_backend *) backend;
+
+	__atomic_add_fetch(&async->calls, 1, __ATOMIC_RELAXED);
+	// The last value set is what the LEDs will show
+	if (async->intensity_valid) {
+		*level = __atomic_load_n(&async->intensity, __ATOMIC_RELAXED);
+		return 0;
+	}
+
+	wait_idle(async);
+	return backend_get_intensity(async->inner, level);
+}
+
+static int async_get_led(struct backend *backend, enum cmd cmd, unsigned int *color, enum status *status,
+	struct trigger *trigger)
+{
+	struct async_backend *async = (struct async_backend *) backend;
+
+	__atomic_add_fetch(&async->calls, 1, __ATOMIC_RELAXED);
+	// Values still waiting for the writer would not be seen
+	wait_idle(async);
+	return backend_get_led(async->inner, cmd, color, status, trigger);
+}
+
+/*
+Triggers are rare, so they are not published. Values set before are pushed
+first to keep the order and the trigger is written and committed directly.
+*/
+static int async_set_trigger(struct backend *backend, enum cmd cmd, enum status status,
+		const struct trigger *trigger)
+{
+	struct async_backend *async = (struct async_backend *) backend;
+
+	__atomic_add_fetch(&async->calls, 1, __ATOMIC_RELAXED);
+	kick(async);
+	wait_idle(async);
+	if (backend_set_trigger(async->inner, cmd, status, trigger) == -1) {
+		return -1;
+	}
+	return backend_commit(async->inner);
+}
+
+static int async_has_trigger(struct backend *backend, enum cmd cmd, enum status status, bool *available)
+{
+	struct async_backend *async = (struct async_backend *) backend;
+
+	__atomic_add_fetch(&async->calls, 1, __ATOMIC_RELAXED);
+	wait_idle(async);
+	return backend_has_trigger(async->inner, cmd, status, available);
+}
+
+static int async_commit(struct backend *backend)
+{
+	struct async_backend *async = (struct async_backend *) backend;
+
+	kick(async);
+
+	int err = __atomic_exchange_n(&async->error, 0, __ATOMIC_RELAXED);
+	if (err) {
+		errno = err;
+		return -1;
+	}
+
+	return 0;
+}
+
+static void async_stats(struct backend *backend, struct backend_stats *stats)
+{
+	struct async_backend *async = (struct async_backend *) backend;
+
+	wait_idle(async);
+	backend_stats(async->inner, stats);
+	stats->calls = __atomic_load_n(&async->calls, __ATOMIC_RELAXED);
+}
+
+static void async_destroy(struct backend *backend)
+{
+	struct async_backend *async = (struct async_backend *) backend;
+
+	// Everything committed is written before the writer stops
+	__atomic_store_n(&async->stop, 1, __ATOMIC_RELEASE);
+	kick(async);
+	pthread_join(async->thread, NULL);
+	if (async->error) {
+		fprintf(stderr, "Backend error: %s\n", strerror(async->error));
+	}
+
+	backend_destroy(async->inner);
+	free(async);
+}
+
+static const struct backend_ops async_ops = {
+	.name = "async",
+	.set_color = async_set_color,
+	.set_status = async_set_status,
+	.set_intensity = async_set_intensity,
+	.get_intensity = async_get_intensity,
+	.get_led = async_get_led,
+	.set_trigger = async_set_trigger,
+	.has_trigger = async_has_trigger,
+	.commit = async_commit,
+	.stats = async_stats,
+	.destroy = async_destroy
+};
+
+struct backend *backend_async_init(struct backend *inner)
+{
+	struct async_backend *async = calloc(1, sizeof(*async));
+	if (!async) {
+		return NULL;
+	}
+
+	async->inner = inner;
+	async->backend.ops = &async_ops;
+	async->backend.hardware = inner->hardware;
+	async->backend.fans_out = inner->fans_out;
+	// The writer thread records the real writes to the inner backend
+	async->backend.inner = inner;
+	async->backend.detail = inner->detail;
+
+	int err = pthread_create(&async->thread, NULL, writer, async);
+	if (err) {
+		free(async);
+		errno = err;
+		return NULL;
+	}
+
+	return &async->backend;
+}
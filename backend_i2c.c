@@ -0,0 +1,245 @@
+/*
+ * Rainbow is a tool for changing color and status of the LEDs of the Turris router
+ *
+ * Copyright (C) 2016 CZ.NIC, z.s.p.o. (http://www.nic.cz/)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+
+#include "configuration.h"
+#include "arg_parser.h"
+#include "backend.h"
+#include "i2c_transport.h"
+#include "color.h"
+
+// Commands of the LED controller in the MCU
+#define CMD_LED_MODE 0x03
+#define CMD_LED_MODE_USER 0x10
+#define CMD_LED_STATE 0x04
+#define CMD_LED_STATE_ON 0x10
+#define CMD_LED_COLOR 0x05
+#define CMD_LED_SET_BRIGHTNESS 0x07
+#define CMD_LED_GET_BRIGHTNESS 0x08
+
+// MCU numbers LEDs in reverse order (as binmask does), 12 addresses all of them
+#define MCU_LED_ALL 12
+#define MCU_MSG_MAX 5
+
+/*
+Updates are queued and sent as one I2C_RDWR transaction by commit.
+*/
+struct i2c_backend {
+	struct backend backend;
+	struct backend_stats stats;
+	struct i2c_transport *transport;
+	struct i2c_msg queue[I2C_RDWR_IOCTL_MAX_MSGS];
+	unsigned char queue_data[I2C_RDWR_IOCTL_MAX_MSGS][MCU_MSG_MAX];
+	unsigned int queued;
+	// Intensity level last set, it tells apart levels sharing a brightness
+	int intensity_level;
+	// Level queued and not transferred yet (-1 none)
+	int intensity_pending;
+	// Only the real MCU keeps the hint across runs
+	const char *hint_path;
+};
+
+static unsigned char mcu_led(enum cmd cmd)
+{
+	return cmd == CMD_ALL ? MCU_LED_ALL : (LED_COUNT - 1) - cmd;
+}
+
+static int transfer(struct i2c_backend *i2c, struct i2c_msg *msgs, unsigned int count)
+{
+	i2c->stats.transactions++;
+	if (i2c->transport->transfer(i2c->transport, msgs, count) == -1) {
+		i2c->stats.errors++;
+		fprintf(stderr, "I2C transfer error: %s\n", strerror(errno));
+		return -1;
+	}
+
+	return 0;
+}
+
+// The hint file is rewritten only for a level that was written and differs from the known one
+static void intensity_applied(struct i2c_backend *i2c, int level)
+{
+	if (level != i2c->intensity_level) {
+		intensity_hint_save(i2c->hint_path, level);
+	}
+	i2c->intensity_level = level;
+}
+
+static int i2c_commit(struct backend *backend)
+{
+	struct i2c_backend *i2c = (struct i2c_backend *) backend;
+	int ret = 0;
+
+	if (i2c->queued > 0) {
+		ret = transfer(i2c, i2c->queue, i2c->queued);
+		i2c->queued = 0;
+	}
+	if (ret == 0 && i2c->intensity_pending != -1) {
+		intensity_applied(i2c, i2c->intensity_pending);
+	}
+	i2c->intensity_pending = -1;
+
+	return ret;
+}
+
+static int enqueue(struct i2c_backend *i2c, size_t len, unsigned char c0, unsigned char c1, unsigned char c2, unsigned char c3, unsigned char c4)
+{
+	if (i2c->queued == I2C_RDWR_IOCTL_MAX_MSGS && i2c_commit(&i2c->backend) == -1) {
+		return -1;
+	}
+
+	unsigned char *data = i2c->queue_data[i2c->queued];
+	data[0] = c0;
+	data[1] = c1;
+	data[2] = c2;
+	data[3] = c3;
+	data[4] = c4;
+	i2c->queue[i2c->queued] = (struct i2c_msg) {
+		.addr = I2C_LED_ADDRESS,
+		.flags = 0,
+		.len = len,
+		.buf = data
+	};
+	i2c->queued++;
+	i2c->stats.writes++;
+	i2c->stats.bytes += len;
+	backend_count_io(&i2c->backend, len, 0);
+
+	return 0;
+}
+
+static int i2c_set_intensity(struct backend *backend, unsigned int level)
+{
+	struct i2c_backend *i2c = (struct i2c_backend *) backend;
+
+	i2c->stats.calls++;
+	if (enqueue(i2c, 2, CMD_LED_SET_BRIGHTNESS, intensity_correct(level), 0, 0, 0) == -1) {
+		return -1;
+	}
+	// Known to be written once the queue is transferred
+	i2c->intensity_pending = level;
+
+	return 0;
+}
+
+static int i2c_get_intensity(struct backend *backend, unsigned int *level)
+{
+	struct i2c_backend *i2c = (struct i2c_backend *) backend;
+	unsigned char cmd = CMD_LED_GET_BRIGHTNESS;
+	unsigned char value = 0;
+	struct i2c_msg msgs[] = {
+		{ .addr = I2C_LED_ADDRESS, .flags = 0, .len = 1, .buf = &cmd },
+		{ .addr = I2C_LED_ADDRESS, .flags = I2C_M_RD, .len = 1, .buf = &value }
+	};
+
+	i2c->stats.calls++;
+	// Whatever is queued has to be visible to the read
+	if (i2c_commit(backend) == -1 || transfer(i2c, msgs, 2) == -1) {
+		return -1;
+	}
+	i2c->stats.reads++;
+	if (i2c->intensity_level == -1) {
+		i2c->intensity_level = intensity_hint_load(i2c->hint_path);
+	}
+	*level = intensity_level(value, i2c->intensity_level);
+
+	return 0;
+}
+
+static int i2c_set_color(struct backend *backend, enum cmd cmd, unsigned int color)
+{
+	struct i2c_backend *i2c = (struct i2c_backend *) backend;
+
+	i2c->stats.calls++;
+	color = color_correct(color);
+	return enqueue(i2c, 5, CMD_LED_COLOR, mcu_led(cmd), (color >> 16) & 0xFF, (color >> 8) & 0xFF, color & 0xFF);
+}
+
+static int i2c_set_status(struct backend *backend, enum cmd cmd, enum status status)
+{
+	struct i2c_backend *i2c = (struct i2c_backend *) backend;
+	unsigned char led = mcu_led(cmd);
+
+	i2c->stats.calls++;
+	if (status == ST_DISABLE) {
+		if (enqueue(i2c, 2, CMD_LED_MODE, led | CMD_LED_MODE_USER, 0, 0, 0) == -1) {
+			return -1;
+		}
+		return enqueue(i2c, 2, CMD_LED_STATE, led, 0, 0, 0);
+
+	} else if (status == ST_ENABLE) {
+		if (enqueue(i2c, 2, CMD_LED_MODE, led | CMD_LED_MODE_USER, 0, 0, 0) == -1) {
+			return -1;
+		}
+		return enqueue(i2c, 2, CMD_LED_STATE, led | CMD_LED_STATE_ON, 0, 0, 0);
+
+	} else if (status == ST_AUTO) {
+		return enqueue(i2c, 2, CMD_LED_MODE, led, 0, 0, 0);
+	}
+
+	return 0;
+}
+
+static void i2c_stats(struct backend *backend, struct backend_stats *stats)
+{
+	*stats = ((struct i2c_backend *) backend)->stats;
+}
+
+static void i2c_destroy(struct backend *backend)
+{
+	struct i2c_backend *i2c = (struct i2c_backend *) backend;
+
+	i2c_commit(backend);
+	i2c->transport->destroy(i2c->transport);
+	free(i2c);
+}
+
+static const struct backend_ops i2c_ops = {
+	.name = "i2c",
+	.set_color = i2c_set_color,
+	.set_status = i2c_set_status,
+	.set_intensity = i2c_set_intensity,
+	.get_intensity = i2c_get_intensity,
+	.commit = i2c_commit,
+	.stats = i2c_stats,
+	.destroy = i2c_destroy
+};
+
+struct backend *backend_i2c_init(struct i2c_transport *transport)
+{
+	struct i2c_backend *i2c = calloc(1, sizeof(*i2c));
+	if (!i2c) {
+		return NULL;
+	}
+
+	i2c->transport = transport;
+	i2c->backend.ops = &i2c_ops;
+	i2c->backend.hardware = transport->hardware;
+	i2c->intensity_level = -1;
+	i2c->intensity_pending = -1;
+	i2c->hint_path = transport->hardware ? INTENSITY_HINT_FILE : NULL;
+
+	return &i2c->backend;
+}
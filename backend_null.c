@@ -0,0 +1,110 @@
+/*
+ * Rainbow is a tool for changing color and status of the LEDs of the Turris router
+ *
+ * Copyright (C) 2016 CZ.NIC, z.s.p.o. (http://www.nic.cz/)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+
+#include "configuration.h"
+#include "arg_parser.h"
+#include "backend.h"
+
+struct null_backend {
+	struct backend backend;
+	struct backend_stats stats;
+};
+
+static int null_set_color(struct backend *backend, enum cmd cmd, unsigned int color)
+{
+	(void) cmd;
+	(void) color;
+	((struct null_backend *) backend)->stats.calls++;
+	return 0;
+}
+
+static int null_set_status(struct backend *backend, enum cmd cmd, enum status status)
+{
+	(void) cmd;
+	(void) status;
+	((struct null_backend *) backend)->stats.calls++;
+	return 0;
+}
+
+static int null_set_trigger(struct backend *backend, enum cmd cmd, enum status status,
+		const struct trigger *trigger)
+{
+	(void) cmd;
+	(void) status;
+	(void) trigger;
+	((struct null_backend *) backend)->stats.calls++;
+	return 0;
+}
+
+static int null_set_intensity(struct backend *backend, unsigned int level)
+{
+	(void) level;
+	((struct null_backend *) backend)->stats.calls++;
+	return 0;
+}
+
+static int null_get_intensity(struct backend *backend, unsigned int *level)
+{
+	((struct null_backend *) backend)->stats.calls++;
+	*level = MAX_INTENSITY_LEVEL;
+	return 0;
+}
+
+static int null_commit(struct backend *backend)
+{
+	(void) backend;
+	return 0;
+}
+
+static void null_stats(struct backend *backend, struct backend_stats *stats)
+{
+	*stats = ((struct null_backend *) backend)->stats;
+}
+
+static void null_destroy(struct backend *backend)
+{
+	free(backend);
+}
+
+static const struct backend_ops null_ops = {
+	.name = "null",
+	.set_color = null_set_color,
+	.set_status = null_set_status,
+	.set_intensity = null_set_intensity,
+	.get_intensity = null_get_intensity,
+	.set_trigger = null_set_trigger,
+	.commit = null_commit,
+	.stats = null_stats,
+	.destroy = null_destroy
+};
+
+struct backend *backend_null_init()
+{
+	struct null_backend *null = calloc(1, sizeof(*null));
+	if (!null) {
+		return NULL;
+	}
+
+	null->backend.ops = &null_ops;
+	null->backend.hardware = false;
+
+	return &null->backend;
+}
@@ -0,0 +1,300 @@
+/*
+ * Rainbow is a tool for changing color and status of the LEDs of the Turris router
+ *
+ * Copyright (C) 2016 CZ.NIC, z.s.p.o. (http://www.nic.cz/)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <inttypes.h>
+
+#include "configuration.h"
+#include "arg_parser.h"
+#include "backend.h"
+#include "color.h"
+#include "led_table.h"
+#include "pattern.h"
+#include "stats.h"
+
+// Attribute write as the sysfs backend would do it, target is enum cmd or STATS_GLOBAL
+struct planned_write {
+	size_t target;
+	const char *attr;
+	char *value;
+};
+
+/*
+Models the LED class of Omnia (with the 'all' LED), so the writes are those
+of the default sysfs backend. Nothing is touched, intensity read returns the
+last level set.
+*/
+struct planner_backend {
+	struct backend backend;
+	struct backend_stats stats;
+	struct planned_write *writes;
+	size_t writes_len;
+	size_t writes_size;
+	unsigned int intensity;
+};
+
+static int planner_write(struct planner_backend *plan, size_t target, const char *attr, const char *value)
+{
+	if (plan->writes_len == plan->writes_size) {
+		size_t size = plan->writes_size ? 2 * plan->writes_size : 64;
+		struct planned_write *writes = realloc(plan->writes, size * sizeof(*writes));
+		if (!writes) {
+			plan->stats.errors++;
+			errno = ENOMEM;
+			return -1;
+		}
+		plan->writes = writes;
+		plan->writes_size = size;
+	}
+
+	struct planned_write *write = &plan->writes[plan->writes_len];
+	write->target = target;
+	write->attr = attr;
+	// Patterns are too long for a fixed buffer
+	write->value = strdup(value);
+	if (!write->value) {
+		plan->stats.errors++;
+		errno = ENOMEM;
+		return -1;
+	}
+	plan->writes_len++;
+	plan->stats.writes++;
+	plan->stats.bytes += strlen(value);
+
+	return 0;
+}
+
+static int planner_set_color(struct backend *backend, enum cmd cmd, unsigned int color)
+{
+	struct planner_backend *plan = (struct planner_backend *) backend;
+	unsigned int device = color_correct(color);
+	char value[16];
+
+	snprintf(value, sizeof(value), "%u %u %u", (device >> 16) & 0xFF, (device >> 8) & 0xFF, device & 0xFF);
+	plan->stats.calls++;
+
+	return planner_write(plan, cmd, "color", value);
+}
+
+static int planner_set_status(struct backend *backend, enum cmd cmd, enum status status)
+{
+	struct planner_backend *plan = (struct planner_backend *) backend;
+
+	plan->stats.calls++;
+	if (status == ST_AUTO) {
+		return planner_write(plan, cmd, "autonomous", "1");
+	}
+	if (planner_write(plan, cmd, "autonomous", "0") == -1) {
+		return -1;
+	}
+	return planner_write(plan, cmd, "brightness", status == ST_ENABLE ? "255" : "0");
+}
+
+static int planner_set_trigger(struct backend *backend, enum cmd cmd, enum status status,
+		const struct trigger *trigger)
+{
+	struct planner_backend *plan = (struct planner_backend *) backend;
+	const char *name = led_trigger_name(status);
+	char value[16];
+
+	plan->stats.calls++;
+	if (!name) {
+		return planner_write(plan, cmd, "trigger", "none");
+	}
+	if (planner_write(plan, cmd, "autonomous", "0") == -1 || planner_write(plan, cmd, "trigger", name) == -1) {
+		return -1;
+	}
+
+	if (status == ST_PATTERN) {
+		struct pattern pattern;
+		char text[PATTERN_TEXT_MAX];
+		pattern_compile(trigger->pattern, trigger->period, &pattern);
+		pattern_format(&pattern, text, sizeof(text));
+		snprintf(value, sizeof(value), "%d", trigger->repeat ? (int) trigger->repeat : -1);
+		if (planner_write(plan, cmd, "repeat", value) == -1) {
+			return -1;
+		}
+		return planner_write(plan, cmd, "pattern", text);
+	} else if (status == ST_TIMER) {
+		snprintf(value, sizeof(value), "%u", trigger->delay_on);
+		if (planner_write(plan, cmd, "delay_on", value) == -1) {
+			return -1;
+		}
+		snprintf(value, sizeof(value), "%u", trigger->delay_off);
+		return planner_write(plan, cmd, "delay_off", value);
+	} else if (status == ST_NETDEV) {
+		if (planner_write(plan, cmd, "device_name", trigger->dev) == -1 ||
+			planner_write(plan, cmd, "link", trigger->modes & TRIGGER_LINK ? "1" : "0") == -1 ||
+			planner_write(plan, cmd, "rx", trigger->modes & TRIGGER_RX ? "1" : "0") == -1) {
+			return -1;
+		}
+		return planner_write(plan, cmd, "tx", trigger->modes & TRIGGER_TX ? "1" : "0");
+	}
+
+	return 0;
+}
+
+static int planner_set_intensity(struct backend *backend, unsigned int level)
+{
+	struct planner_backend *plan = (struct planner_backend *) backend;
+	char value[16];
+
+	snprintf(value, sizeof(value), "%u", intensity_correct(level));
+	plan->stats.calls++;
+	plan->intensity = level;
+
+	return planner_write(plan, STATS_GLOBAL, "global_brightness", value);
+}
+
+static int planner_get_intensity(struct backend *backend, unsigned int *level)
+{
+	struct planner_backend *plan = (struct planner_backend *) backend;
+
+	plan->stats.calls++;
+	plan->stats.reads++;
+	*level = plan->intensity;
+	return 0;
+}
+
+static int planner_commit(struct backend *backend)
+{
+	((struct planner_backend *) backend)->stats.transactions++;
+	return 0;
+}
+
+static void planner_stats(struct backend *backend, struct backend_stats *stats)
+{
+	*stats = ((struct planner_backend *) backend)->stats;
+}
+
+static void planner_destroy(struct backend *backend)
+{
+	struct planner_backend *plan = (struct planner_backend *) backend;
+
+	for (size_t i = 0; i < plan->writes_len; i++) {
+		free(plan->writes[i].value);
+	}
+	free(plan->writes);
+	free(plan);
+}
+
+// Planner counters of a LED summed over the operations
+static void detail_sum(const struct backend *backend, size_t target, uint64_t *elided, uint64_t *expanded)
+{
+	*elided = 0;
+	*expanded = 0;
+	if (!backend->detail) {
+		return;
+	}
+	for (size_t op = 0; op < STATS_OPS; op++) {
+		*elided += backend->detail->op[target][op].elided;
+		*expanded += backend->detail->op[target][op].expanded;
+	}
+}
+
+static void print_cost(struct planner_backend *plan, FILE *out)
+{
+	uint64_t total_writes = 0, total_bytes = 0, total_elided = 0, total_expanded = 0;
+
+	fprintf(out, "%-7s %7s %7s %10s %9s\n", "led", "writes", "bytes", "redundant", "expanded");
+	for (size_t target = 0; target < STATS_TARGETS; target++) {
+		uint64_t writes = 0, bytes = 0, elided, expanded;
+		for (size_t i = 0; i < plan->writes_len; i++) {
+			if (plan->writes[i].target == target) {
+				writes++;
+				bytes += strlen(plan->writes[i].value);
+			}
+		}
+		detail_sum(&plan->backend, target, &elided, &expanded);
+		if (!writes && !elided && !expanded) {
+			continue;
+		}
+
+		fprintf(out, "%-7s %7" PRIu64 " %7" PRIu64 " %10" PRIu64 " %9" PRIu64 "\n", stats_target_name(target),
+			writes, bytes, elided, expanded);
+		total_writes += writes;
+		total_bytes += bytes;
+		total_elided += elided;
+		total_expanded += expanded;
+	}
+	fprintf(out, "%-7s %7" PRIu64 " %7" PRIu64 " %10" PRIu64 " %9" PRIu64 "\n", "total", total_writes, total_bytes,
+		total_elided, total_expanded);
+	fprintf(out, "commits %lu\n", plan->stats.transactions);
+}
+
+void backend_plan_dump(struct backend *backend, FILE *out, bool explain)
+{
+	struct planner_backend *plan = (struct planner_backend *) backend;
+
+	if (!plan->writes_len) {
+		fprintf(out, "Nothing to write\n");
+	}
+	// LEDs in order of their first write, as the 'all' LED has to go before the others
+	for (size_t i = 0; i < plan->writes_len; i++) {
+		size_t target = plan->writes[i].target;
+		bool seen = false;
+		for (size_t j = 0; j < i && !seen; j++) {
+			seen = plan->writes[j].target == target;
+		}
+		if (seen) {
+			continue;
+		}
+
+		fprintf(out, "%s:\n", stats_target_name(target));
+		for (size_t j = i; j < plan->writes_len; j++) {
+			if (plan->writes[j].target == target) {
+				fprintf(out, "  %s = %s\n", plan->writes[j].attr, plan->writes[j].value);
+			}
+		}
+	}
+
+	if (explain) {
+		fprintf(out, "\n");
+		print_cost(plan, out);
+	}
+}
+
+static const struct backend_ops planner_ops = {
+	.name = "plan",
+	.set_color = planner_set_color,
+	.set_status = planner_set_status,
+	.set_intensity = planner_set_intensity,
+	.get_intensity = planner_get_intensity,
+	.set_trigger = planner_set_trigger,
+	.commit = planner_commit,
+	.stats = planner_stats,
+	.destroy = planner_destroy
+};
+
+struct backend *backend_plan_init()
+{
+	struct planner_backend *plan = calloc(1, sizeof(*plan));
+	if (!plan) {
+		return NULL;
+	}
+
+	plan->intensity = MAX_INTENSITY_LEVEL;
+	plan->backend.ops = &planner_ops;
+	plan->backend.hardware = false;
+
+	return &plan->backend;
+}
@@ -0,0 +1,204 @@
+/*
+ * Rainbow is a tool for changing color and status of the LEDs of the Turris router
+ *
+ * Copyright (C) 2016 CZ.NIC, z.s.p.o. (http://www.nic.cz/)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+
+#include "configuration.h"
+#include "arg_parser.h"
+#include "backend.h"
+
+enum record_op {
+	REC_COLOR,
+	REC_STATUS,
+	REC_TRIGGER,
+	REC_INTENSITY,
+	REC_GET_INTENSITY,
+	REC_COMMIT
+};
+
+struct record_entry {
+	enum record_op op;
+	enum cmd cmd;
+	unsigned int value;
+};
+
+/*
+Counts calls and keeps them in memory. Writes are counted as the number of
+attribute writes the sysfs backend would do for the same calls.
+*/
+struct recording_backend {
+	struct backend backend;
+	struct backend_stats stats;
+	struct record_entry *log;
+	size_t log_len;
+	size_t log_size;
+	unsigned int intensity;
+};
+
+static int record(struct recording_backend *rec, enum record_op op, enum cmd cmd, unsigned int value)
+{
+	if (rec->log_len == rec->log_size) {
+		size_t size = rec->log_size ? 2 * rec->log_size : 64;
+		struct record_entry *log = realloc(rec->log, size * sizeof(*log));
+		if (!log) {
+			rec->stats.errors++;
+			errno = ENOMEM;
+			return -1;
+		}
+		rec->log = log;
+		rec->log_size = size;
+	}
+
+	rec->log[rec->log_len++] = (struct record_entry) {
+		.op = op,
+		.cmd = cmd,
+		.value = value
+	};
+	if (op != REC_COMMIT) {
+		rec->stats.calls++;
+	}
+
+	return 0;
+}
+
+static int recording_set_color(struct backend *backend, enum cmd cmd, unsigned int color)
+{
+	struct recording_backend *rec = (struct recording_backend *) backend;
+
+	rec->stats.writes++;
+	return record(rec, REC_COLOR, cmd, color);
+}
+
+static int recording_set_status(struct backend *backend, enum cmd cmd, enum status status)
+{
+	struct recording_backend *rec = (struct recording_backend *) backend;
+
+	rec->stats.writes += status == ST_AUTO ? 1 : 2;
+	return record(rec, REC_STATUS, cmd, status);
+}
+
+// Only the trigger status is logged, not its parameters
+static int recording_set_trigger(struct backend *backend, enum cmd cmd, enum status status,
+		const struct trigger *trigger)
+{
+	struct recording_backend *rec = (struct recording_backend *) backend;
+
+	(void) trigger;
+	rec->stats.writes++;
+	return record(rec, REC_TRIGGER, cmd, status);
+}
+
+static int recording_set_intensity(struct backend *backend, unsigned int level)
+{
+	struct recording_backend *rec = (struct recording_backend *) backend;
+
+	rec->stats.writes++;
+	rec->intensity = level;
+	return record(rec, REC_INTENSITY, CMD_INTEN, level);
+}
+
+static int recording_get_intensity(struct backend *backend, unsigned int *level)
+{
+	struct recording_backend *rec = (struct recording_backend *) backend;
+
+	rec->stats.reads++;
+	*level = rec->intensity;
+	return record(rec, REC_GET_INTENSITY, CMD_INTEN, rec->intensity);
+}
+
+static int recording_commit(struct backend *backend)
+{
+	struct recording_backend *rec = (struct recording_backend *) backend;
+
+	rec->stats.transactions++;
+	return record(rec, REC_COMMIT, CMD_UNDEF, 0);
+}
+
+static void recording_stats(struct backend *backend, struct backend_stats *stats)
+{
+	*stats = ((struct recording_backend *) backend)->stats;
+}
+
+static void recording_destroy(struct backend *backend)
+{
+	struct recording_backend *rec = (struct recording_backend *) backend;
+
+	free(rec->log);
+	free(rec);
+}
+
+void backend_recording_dump(struct backend *backend, FILE *out)
+{
+	struct recording_backend *rec = (struct recording_backend *) backend;
+
+	for (size_t i = 0; i < rec->log_len; i++) {
+		struct record_entry *entry = &rec->log[i];
+		switch (entry->op) {
+		case REC_COLOR:
+			fprintf(out, "color %s %06X\n", cmd_keyword(entry->cmd), entry->value);
+			break;
+		case REC_STATUS:
+			fprintf(out, "status %s %s\n", cmd_keyword(entry->cmd), status_keyword(entry->value));
+			break;
+		case REC_TRIGGER:
+			fprintf(out, "trigger %s %s\n", cmd_keyword(entry->cmd),
+				STATUS_TRIGGER(entry->value) ? status_keyword(entry->value) : "none");
+			break;
+		case REC_INTENSITY:
+			fprintf(out, "intensity %u\n", entry->value);
+			break;
+		case REC_GET_INTENSITY:
+			fprintf(out, "get intensity %u\n", entry->value);
+			break;
+		case REC_COMMIT:
+			fprintf(out, "commit\n");
+			break;
+		}
+	}
+	fprintf(out, "calls %lu writes %lu reads %lu commits %lu\n",
+		rec->stats.calls, rec->stats.writes, rec->stats.reads, rec->stats.transactions);
+}
+
+static const struct backend_ops recording_ops = {
+	.name = "record",
+	.set_color = recording_set_color,
+	.set_status = recording_set_status,
+	.set_intensity = recording_set_intensity,
+	.get_intensity = recording_get_intensity,
+	.set_trigger = recording_set_trigger,
+	.commit = recording_commit,
+	.stats = recording_stats,
+	.destroy = recording_destroy
+};
+
+struct backend *backend_recording_init()
+{
+	struct recording_backend *rec = calloc(1, sizeof(*rec));
+	if (!rec) {
+		return NULL;
+	}
+
+	rec->intensity = MAX_INTENSITY_LEVEL;
+	rec->backend.ops = &recording_ops;
+	rec->backend.hardware = false;
+
+	return &rec->backend;
+}
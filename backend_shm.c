@@ -0,0 +1,154 @@
+/*
+ * Rainbow is a tool for changing color and status of the LEDs of the Turris router
+ *
+ * Copyright (C) 2016 CZ.NIC, z.s.p.o. (http://www.nic.cz/)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+
+#include "configuration.h"
+#include "arg_parser.h"
+#include "backend.h"
+#include "framebuffer.h"
+
+/*
+Producer side of the shared framebuffer. Changes are stored with plain
+memory writes and published by commit, 'rainbow flush' writes them to the
+LEDs.
+*/
+struct shm_backend {
+	struct backend backend;
+	struct backend_stats stats;
+	struct framebuffer *fb;
+	bool writing;
+};
+
+static void shm_begin(struct shm_backend *shm)
+{
+	if (!shm->writing) {
+		fb_begin(shm->fb);
+		shm->writing = true;
+	}
+	shm->stats.calls++;
+	shm->stats.writes++;
+}
+
+static int shm_set_color(struct backend *backend, enum cmd cmd, unsigned int color)
+{
+	struct shm_backend *shm = (struct shm_backend *) backend;
+
+	shm_begin(shm);
+	fb_set_color(shm->fb, cmd, color);
+	return 0;
+}
+
+static int shm_set_status(struct backend *backend, enum cmd cmd, enum status status)
+{
+	struct shm_backend *shm = (struct shm_backend *) backend;
+
+	shm_begin(shm);
+	fb_set_status(shm->fb, cmd, status);
+	return 0;
+}
+
+static int shm_set_intensity(struct backend *backend, unsigned int level)
+{
+	struct shm_backend *shm = (struct shm_backend *) backend;
+
+	shm_begin(shm);
+	fb_set_intensity(shm->fb, level);
+	return 0;
+}
+
+static int shm_get_intensity(struct backend *backend, unsigned int *level)
+{
+	struct shm_backend *shm = (struct shm_backend *) backend;
+
+	shm->stats.calls++;
+	shm->stats.reads++;
+	*level = __atomic_load_n(&shm->fb->intensity, __ATOMIC_RELAXED);
+	return 0;
+}
+
+static int shm_get_led(struct backend *backend, enum cmd cmd, unsigned int *color, enum status *status,
+	struct trigger *trigger)
+{
+	struct shm_backend *shm = (struct shm_backend *) backend;
+
+	shm->stats.calls++;
+	shm->stats.reads++;
+	*color = __atomic_load_n(&shm->fb->color[cmd], __ATOMIC_RELAXED);
+	*status = __atomic_load_n(&shm->fb->status[cmd], __ATOMIC_RELAXED);
+	// The framebuffer has no triggers
+	*trigger = (struct trigger) { .modes = 0 };
+	return 0;
+}
+
+static int shm_commit(struct backend *backend)
+{
+	struct shm_backend *shm = (struct shm_backend *) backend;
+
+	if (shm->writing) {
+		fb_end(shm->fb);
+		shm->writing = false;
+		shm->stats.transactions++;
+	}
+	return 0;
+}
+
+static void shm_stats(struct backend *backend, struct backend_stats *stats)
+{
+	*stats = ((struct shm_backend *) backend)->stats;
+}
+
+static void shm_destroy(struct backend *backend)
+{
+	struct shm_backend *shm = (struct shm_backend *) backend;
+
+	shm_commit(backend);
+	fb_close(shm->fb);
+	free(shm);
+}
+
+static const struct backend_ops shm_ops = {
+	.name = "shm",
+	.set_color = shm_set_color,
+	.set_status = shm_set_status,
+	.set_intensity = shm_set_intensity,
+	.get_intensity = shm_get_intensity,
+	.get_led = shm_get_led,
+	.commit = shm_commit,
+	.stats = shm_stats,
+	.destroy = shm_destroy
+};
+
+struct backend *backend_shm_init()
+{
+	struct shm_backend *shm = calloc(1, sizeof(*shm));
+	if (!shm) {
+		return NULL;
+	}
+
+	shm->fb = fb_open();
+	if (!shm->fb) {
+		free(shm);
+		return NULL;
+	}
+	shm->backend.ops = &shm_ops;
+	shm->backend.hardware = false;
+
+	return &shm->backend;
+}
@@ -0,0 +1,1005 @@
+/*
+ * Rainbow is a tool for changing color and status of the LEDs of the Turris router
+ *
+ * Copyright (C) 2016 CZ.NIC, z.s.p.o. (http://www.nic.cz/)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/vfs.h>
+#include <fcntl.h>
+#include <linux/magic.h>
+
+#include "configuration.h"
+#include "arg_parser.h"
+#include "backend.h"
+#include "led_table.h"
+#include "uring.h"
+#include "color.h"
+#include "pattern.h"
+
+enum attr {
+	ATTR_COLOR,
+	ATTR_AUTONOMOUS,
+	ATTR_BRIGHTNESS,
+	ATTR_TRIGGER,
+	ATTR_COUNT
+};
+
+static const char *attr_map[] = {
+	[ATTR_COLOR] = "color",
+	[ATTR_AUTONOMOUS] = "autonomous",
+	[ATTR_BRIGHTNESS] = "brightness",
+	[ATTR_TRIGGER] = "trigger"
+};
+
+// The same attributes of the multicolor LED class driven by triggers
+static const char *multicolor_attr_map[] = {
+	[ATTR_COLOR] = "multi_intensity",
+	[ATTR_AUTONOMOUS] = "trigger",
+	[ATTR_BRIGHTNESS] = "brightness",
+	[ATTR_TRIGGER] = "trigger"
+};
+
+// Write queued for the io_uring batch, value has to live until it is submitted
+struct queued_write {
+	int fd;
+	size_t len;
+	char value[16];
+	// The next write is linked after this one
+	bool link;
+	bool drain;
+};
+
+/*
+LEDs are found once by led_table_scan() (or taken from its cache) and every
+attribute is opened relative to one descriptor of the LED class directory.
+Attribute files are opened on first use and kept open for the rest of the
+run, so each update is a single pwrite() instead of a path walk through
+the root followed by open(), write() and close(). The value -1 marks a file
+that was not opened yet.
+*/
+struct sysfs_backend {
+	struct backend backend;
+	struct backend_stats stats;
+	char *dir;
+	int dir_fd;
+	struct led_table table;
+	// Table came from the cache, it is scanned again when it doesn't fit
+	bool cached;
+	// Regular files of a fake tree have to be truncated, sysfs replaces the value
+	bool truncate;
+	int led_fds[CMD_ALL + 1][ATTR_COUNT];
+	int intensity_fd;
+	// Intensity level last set, it tells apart levels sharing a brightness
+	int intensity_level;
+	char *hint_path;
+	// Queue entry of intensity level not written yet (-1 none)
+	int intensity_queued;
+	int intensity_pending;
+	/*
+	The uring backend queues writes here and commit submits them at once.
+	Without ring every write is done immediately.
+	*/
+	struct uring *ring;
+	struct queued_write queue[URING_BATCH_MAX];
+	size_t queue_len;
+	// Writes queued before this one finish before any later write starts
+	size_t queue_barrier;
+};
+
+static int backend_open(struct sysfs_backend *sysfs, const char *path, int flags)
+{
+	int fd = openat(sysfs->dir_fd, path, flags | O_CLOEXEC, 0644);
+	if (fd == -1) {
+		sysfs->stats.errors++;
+		fprintf(stderr, "Failed to open file %s/%s: %s\n", sysfs->dir, path, strerror(errno));
+		return -1;
+	}
+	sysfs->stats.opens++;
+
+	return fd;
+}
+
+static bool rescan(struct sysfs_backend *sysfs)
+{
+	if (!sysfs->cached) {
+		return false;
+	}
+	sysfs->cached = false;
+	if (!led_table_scan(sysfs->dir_fd, &sysfs->table)) {
+		return false;
+	}
+	led_table_save(LED_TABLE_FILE, &sysfs->table);
+
+	return true;
+}
+
+static int led_fd(struct sysfs_backend *sysfs, enum cmd cmd, enum attr attr)
+{
+	while (sysfs->led_fds[cmd][attr] == -1) {
+		if (!sysfs->table.name[cmd][0]) {
+			sysfs->stats.errors++;
+			fprintf(stderr, "LED %s was not found in %s\n", cmd_keyword(cmd), sysfs->dir);
+			errno = ENODEV;
+			return -1;
+		}
+
+		const char **attrs = sysfs->table.flags[cmd] & LED_TRIGGER ? multicolor_attr_map : attr_map;
+		if (attr == ATTR_COLOR) {
+			attrs = sysfs->table.flags[cmd] & LED_MULTICOLOR ? multicolor_attr_map : attr_map;
+		}
+
+		char path[LED_NAME_MAX + 32];
+		snprintf(path, sizeof(path), "%s/%s", sysfs->table.name[cmd], attrs[attr]);
+		// Readable as well, so snapshots read the LEDs over the same fds
+		sysfs->led_fds[cmd][attr] = backend_open(sysfs, path, O_RDWR);
+		if (sysfs->led_fds[cmd][attr] == -1 && (errno != ENOENT || !rescan(sysfs))) {
+			return -1;
+		}
+	}
+
+	return sysfs->led_fds[cmd][attr];
+}
+
+static int global_fd(struct sysfs_backend *sysfs)
+{
+	while (sysfs->intensity_fd == -1) {
+		if (!sysfs->table.global[0]) {
+			sysfs->stats.errors++;
+			fprintf(stderr, "Global brightness was not found in %s\n", sysfs->dir);
+			errno = ENODEV;
+			return -1;
+		}
+
+		sysfs->intensity_fd = backend_open(sysfs, sysfs->table.global, O_RDWR);
+		if (sysfs->intensity_fd == -1 && (errno != ENOENT || !rescan(sysfs))) {
+			return -1;
+		}
+	}
+
+	return sysfs->intensity_fd;
+}
+
+static int queue_flush(struct sysfs_backend *sysfs);
+
+// The hint file is rewritten only for a level that was written and differs from the known one
+static void intensity_applied(struct sysfs_backend *sysfs, int level)
+{
+	if (level != sysfs->intensity_level) {
+		intensity_hint_save(sysfs->hint_path, level);
+	}
+	sysfs->intensity_level = level;
+}
+
+/*
+Writes with the same fd must keep their order, so do writes of the 'all' LED
+and the others as the hardware merges them. Such write waits for every write
+queued before it (IOSQE_IO_DRAIN) and the later ones wait for it. Drain of
+a linked write is put on the head of its chain.
+*/
+static bool needs_drain(struct sysfs_backend *sysfs, int fd)
+{
+	for (size_t i = 0; i < ATTR_COUNT; i++) {
+		if (sysfs->led_fds[CMD_ALL][i] == fd) {
+			return true;
+		}
+	}
+	for (size_t i = sysfs->queue_barrier; i < sysfs->queue_len; i++) {
+		if (sysfs->queue[i].fd == fd) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static int queue_write(struct sysfs_backend *sysfs, int fd, const char *value, size_t len, bool link)
+{
+	// Chain (at most two writes) has to stay in one batch
+	if (sysfs->queue_len + 2 > URING_BATCH_MAX && !(sysfs->queue_len && sysfs->queue[sysfs->queue_len - 1].link) &&
+			queue_flush(sysfs) == -1) {
+		return -1;
+	}
+
+	struct queued_write *write = &sysfs->queue[sysfs->queue_len];
+	write->fd = fd;
+	write->len = len;
+	memcpy(write->value, value, len);
+	write->link = link;
+	write->drain = false;
+
+	if (needs_drain(sysfs, fd)) {
+		size_t head = sysfs->queue_len;
+		if (head > 0 && sysfs->queue[head - 1].link) {
+			head--;
+		}
+		sysfs->queue[head].drain = true;
+		sysfs->queue_barrier = head;
+	}
+	sysfs->queue_len++;
+
+	return 0;
+}
+
+/*
+Submits the queue with one io_uring_enter() and goes through all results.
+Every failed write is reported, errno is of the first one.
+*/
+static int queue_flush(struct sysfs_backend *sysfs)
+{
+	size_t count = sysfs->queue_len;
+	if (count == 0) {
+		return 0;
+	}
+	sysfs->queue_len = 0;
+	sysfs->queue_barrier = 0;
+	int intensity_queued = sysfs->intensity_queued;
+	sysfs->intensity_queued = -1;
+
+	for (size_t i = 0; i < count; i++) {
+		struct queued_write *write = &sysfs->queue[i];
+		struct io_uring_sqe *sqe = uring_sqe(sysfs->ring);
+		sqe->opcode = IORING_OP_WRITE;
+		sqe->fd = write->fd;
+		sqe->addr = (uintptr_t) write->value;
+		sqe->len = write->len;
+		sqe->off = 0;
+		sqe->user_data = i;
+		sqe->flags = (write->link ? IOSQE_IO_LINK : 0) | (write->drain ? IOSQE_IO_DRAIN : 0);
+	}
+
+	sysfs->stats.transactions++;
+	if (uring_submit(sysfs->ring) == -1) {
+		sysfs->stats.errors++;
+		fprintf(stderr, "Write error: %s\n", strerror(errno));
+		return -1;
+	}
+
+	int err = 0;
+	struct io_uring_cqe cqe;
+	bool ok[URING_BATCH_MAX] = { false };
+	while (uring_cqe(sysfs->ring, &cqe)) {
+		struct queued_write *write = &sysfs->queue[cqe.user_data];
+		ok[cqe.user_data] = cqe.res >= 0 && (size_t) cqe.res == write->len;
+		if (!ok[cqe.user_data]) {
+			int write_err = cqe.res < 0 ? -cqe.res : EIO;
+			sysfs->stats.errors++;
+			fprintf(stderr, "Write error: %s\n", strerror(write_err));
+			if (!err) {
+				err = write_err;
+			}
+			continue;
+		}
+		sysfs->stats.writes++;
+		sysfs->stats.bytes += cqe.res;
+		backend_count_io(&sysfs->backend, cqe.res, 0);
+	}
+
+	// Done in the queue order, so the last write of each file sets its length
+	for (size_t i = 0; sysfs->truncate && i < count; i++) {
+		if (ok[i] && ftruncate(sysfs->queue[i].fd, sysfs->queue[i].len) == -1 && !err) {
+			err = errno;
+		}
+	}
+	if (intensity_queued != -1 && ok[intensity_queued]) {
+		intensity_applied(sysfs, sysfs->intensity_pending);
+	}
+
+	if (err) {
+		errno = err;
+		return -1;
+	}
+
+	return 0;
+}
+
+static int write_now(struct sysfs_backend *sysfs, int fd, const char *value, size_t len)
+{
+	off_t offset = 0;
+	while (len > 0) {
+		ssize_t ret = pwrite(fd, value, len, offset);
+		sysfs->stats.transactions++;
+		if (ret == -1) {
+			if (errno == EINTR) {
+				backend_count_io(&sysfs->backend, 0, 1);
+				continue;
+			} else {
+				sysfs->stats.errors++;
+				fprintf(stderr, "Write error: %s\n", strerror(errno));
+				return -1;
+			}
+		}
+
+		value += ret;
+		offset += ret;
+		len -= ret;
+		sysfs->stats.bytes += ret;
+		backend_count_io(&sysfs->backend, ret, 0);
+	}
+	sysfs->stats.writes++;
+
+	if (sysfs->truncate && ftruncate(fd, offset) == -1) {
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+Link only matters when writes are queued, the next write starts after this
+one succeeds then.
+*/
+static int backend_write(struct sysfs_backend *sysfs, int fd, const char *value, size_t len, bool link)
+{
+	if (fd == -1) {
+		return -1;
+	}
+	if (sysfs->ring) {
+		return queue_write(sysfs, fd, value, len, link);
+	}
+
+	return write_now(sysfs, fd, value, len);
+}
+
+static int backend_read(struct sysfs_backend *sysfs, int fd, char *buff, size_t len)
+{
+	if (fd == -1) {
+		return -1;
+	}
+
+	off_t offset = 0;
+	while (len > 0) {
+		ssize_t ret = pread(fd, buff, len, offset);
+		if (ret == 0) {
+			//EOF
+			break;
+
+		} else if (ret == -1) {
+			if (errno == EINTR) {
+				backend_count_io(&sysfs->backend, 0, 1);
+				continue;
+			} else {
+				sysfs->stats.errors++;
+				fprintf(stderr, "Read error: %s\n", strerror(errno));
+				return -1;
+			}
+		}
+
+		buff += ret;
+		offset += ret;
+		len -= ret;
+	}
+	sysfs->stats.reads++;
+
+	return 0;
+}
+
+static void get_rgb_parts(unsigned int color, unsigned char *r, unsigned char *g, unsigned char *b) {
+	*r = ((color & 0xFF0000) >> 2*8);
+	*g = ((color & 0x00FF00) >> 8);
+	*b = (color & 0x0000FF);
+}
+
+static int sysfs_set_intensity(struct backend *backend, unsigned int level)
+{
+	struct sysfs_backend *sysfs = (struct sysfs_backend *) backend;
+	char value[16];
+	int len = snprintf(value, sizeof(value), "%u", intensity_correct(level));
+
+	sysfs->stats.calls++;
+	if (backend_write(sysfs, global_fd(sysfs), value, len, false) == -1) {
+		return -1;
+	}
+	if (sysfs->ring) {
+		// Known to be written once the queue is flushed
+		sysfs->intensity_queued = sysfs->queue_len - 1;
+		sysfs->intensity_pending = level;
+	} else {
+		intensity_applied(sysfs, level);
+	}
+
+	return 0;
+}
+
+static int sysfs_get_intensity(struct backend *backend, unsigned int *level)
+{
+	struct sysfs_backend *sysfs = (struct sysfs_backend *) backend;
+	/*
+	The maximum value of brightness/intensity is 100. Greater number (longer
+	string) is invalid input. + 1 for '\0' at the end of the string.
+	*/
+	const size_t bufflen = 4;
+	char buff[bufflen];
+
+	sysfs->stats.calls++;
+	// Queued intensity has to be written before it is read back
+	if (sysfs->ring && queue_flush(sysfs) == -1) {
+		return -1;
+	}
+	memset(buff, 0, bufflen);
+	if (backend_read(sysfs, global_fd(sysfs), buff, bufflen - 1) == -1) {
+		return -1;
+	}
+
+	unsigned int brightness;
+	if (sscanf(buff, "%u", &brightness) != 1) {
+		sysfs->stats.errors++;
+		errno = EINVAL;
+		return -1;
+	}
+	if (sysfs->intensity_level == -1) {
+		sysfs->intensity_level = intensity_hint_load(sysfs->hint_path);
+	}
+	*level = intensity_level(brightness, sysfs->intensity_level);
+
+	return 0;
+}
+
+// Reads value of attribute of a single LED, up to size - 1 bytes
+static int read_attr(struct sysfs_backend *sysfs, enum cmd cmd, enum attr attr, char *buff, size_t size)
+{
+	memset(buff, 0, size);
+	return backend_read(sysfs, led_fd(sysfs, cmd, attr), buff, size - 1);
+}
+
+// Sysfs shows at most a page, the trigger attribute lists every trigger there is
+#define ATTR_TEXT_MAX 4096
+
+// Reads attribute of the trigger of a single LED, it comes and goes with the trigger
+static int read_trigger_attr(struct sysfs_backend *sysfs, enum cmd cmd, const char *attr, char *buff, size_t size)
+{
+	char path[LED_NAME_MAX + 32];
+	snprintf(path, sizeof(path), "%s/%s", sysfs->table.name[cmd], attr);
+
+	int fd = backend_open(sysfs, path, O_RDONLY);
+	if (fd == -1) {
+		return -1;
+	}
+	memset(buff, 0, size);
+	int ret = backend_read(sysfs, fd, buff, size - 1);
+	close(fd);
+
+	return ret;
+}
+
+static int read_trigger_number(struct sysfs_backend *sysfs, enum cmd cmd, const char *attr, int *number)
+{
+	char buff[16];
+
+	if (read_trigger_attr(sysfs, cmd, attr, buff, sizeof(buff)) == -1) {
+		return -1;
+	}
+	if (sscanf(buff, "%d", number) != 1) {
+		sysfs->stats.errors++;
+		errno = EINVAL;
+		return -1;
+	}
+
+	return 0;
+}
+
+static int unknown_trigger(struct sysfs_backend *sysfs, enum cmd cmd, const char *name)
+{
+	sysfs->stats.errors++;
+	fprintf(stderr, "LED %s is driven by kernel trigger %s, no status stands for it\n", cmd_keyword(cmd), name);
+	errno = ENOMSG;
+	return -1;
+}
+
+// Parameters of the trigger status the LED runs, the inverse of write_trigger()
+static int read_trigger(struct sysfs_backend *sysfs, enum cmd cmd, enum status status, struct trigger *trigger)
+{
+	static const char *modes[] = {"link", "rx", "tx"};
+	char buff[ATTR_TEXT_MAX];
+	int on, off, repeat;
+
+	*trigger = (struct trigger) { .modes = 0 };
+
+	if (status == ST_NETDEV) {
+		if (read_trigger_attr(sysfs, cmd, "device_name", buff, sizeof(buff)) == -1) {
+			return -1;
+		}
+		buff[strcspn(buff, "\n")] = '\0';
+		// A longer name stays empty, the status can't be written with it
+		if (strlen(buff) < TRIGGER_DEV_MAX) {
+			strcpy(trigger->dev, buff);
+		}
+		for (size_t i = 0; i < sizeof(modes) / sizeof(*modes); i++) {
+			if (read_trigger_number(sysfs, cmd, modes[i], &on) == -1) {
+				return -1;
+			}
+			trigger->modes |= on ? 1 << i : 0;
+		}
+
+	} else if (status == ST_TIMER) {
+		if (read_trigger_number(sysfs, cmd, "delay_on", &on) == -1 ||
+			read_trigger_number(sysfs, cmd, "delay_off", &off) == -1) {
+			return -1;
+		}
+		trigger->delay_on = on;
+		trigger->delay_off = off;
+
+	} else if (status == ST_PATTERN) {
+		enum pattern_effect effect;
+		if (read_trigger_number(sysfs, cmd, "repeat", &repeat) == -1 ||
+			read_trigger_attr(sysfs, cmd, "pattern", buff, sizeof(buff)) == -1) {
+			return -1;
+		}
+		if (!pattern_recognize(buff, &effect, &trigger->period)) {
+			return unknown_trigger(sysfs, cmd, "pattern");
+		}
+		trigger->pattern = effect;
+		trigger->repeat = repeat > 0 ? repeat : 0;
+		// Count of runs follows the period in the status
+		if (trigger->repeat && !trigger->period) {
+			struct pattern pattern;
+			pattern_compile(effect, 0, &pattern);
+			trigger->period = pattern.cycle;
+		}
+	}
+
+	return 0;
+}
+
+static int sysfs_get_led(struct backend *backend, enum cmd cmd, unsigned int *color, enum status *status,
+	struct trigger *trigger)
+{
+	struct sysfs_backend *sysfs = (struct sysfs_backend *) backend;
+	char buff[ATTR_TEXT_MAX];
+	unsigned int r, g, b, brightness;
+
+	sysfs->stats.calls++;
+	if (sysfs->ring && queue_flush(sysfs) == -1) {
+		return -1;
+	}
+	*trigger = (struct trigger) { .modes = 0 };
+
+	if (read_attr(sysfs, cmd, ATTR_COLOR, buff, sizeof(buff)) == -1) {
+		return -1;
+	}
+	if (sscanf(buff, "%u %u %u", &r, &g, &b) != 3 || r > 255 || g > 255 || b > 255) {
+		sysfs->stats.errors++;
+		errno = EINVAL;
+		return -1;
+	}
+	*color = color_uncorrect(r << 16 | g << 8 | b);
+
+	// Omnia LEDs driven by the MCU ignore their trigger
+	if (!(sysfs->table.flags[cmd] & LED_TRIGGER)) {
+		if (read_attr(sysfs, cmd, ATTR_AUTONOMOUS, buff, sizeof(buff)) == -1) {
+			return -1;
+		}
+		if (buff[0] == '1') {
+			*status = ST_AUTO;
+			return 0;
+		}
+	}
+
+	// The selected trigger is the one in brackets, a fake tree has only the name written
+	if (sysfs->table.flags[cmd] & LED_NO_TRIGGERS) {
+		strcpy(buff, "[none]");
+	} else if (read_attr(sysfs, cmd, ATTR_TRIGGER, buff, sizeof(buff)) == -1) {
+		return -1;
+	}
+	char *name = strchr(buff, '[');
+	if (name) {
+		name++;
+	} else if (sysfs->truncate) {
+		name = buff;
+	} else {
+		sysfs->stats.errors++;
+		errno = EINVAL;
+		return -1;
+	}
+	name[strcspn(name, "]\n")] = '\0';
+
+	if (strcmp(name, "omnia-mcu") == 0 && (sysfs->table.flags[cmd] & LED_TRIGGER)) {
+		*status = ST_AUTO;
+		return 0;
+	} else if (strcmp(name, "none") != 0) {
+		char text[STATUS_TEXT_MAX];
+		if (!led_trigger_status(name, status)) {
+			return unknown_trigger(sysfs, cmd, name);
+		} else if (read_trigger(sysfs, cmd, *status, trigger) == -1) {
+			return -1;
+		} else if (!status_format(*status, trigger, text)) {
+			return unknown_trigger(sysfs, cmd, name);
+		}
+		return 0;
+	}
+
+	if (read_attr(sysfs, cmd, ATTR_BRIGHTNESS, buff, sizeof(buff)) == -1) {
+		return -1;
+	}
+	if (sscanf(buff, "%u", &brightness) != 1) {
+		sysfs->stats.errors++;
+		errno = EINVAL;
+		return -1;
+	}
+	*status = brightness ? ST_ENABLE : ST_DISABLE;
+
+	return 0;
+}
+
+static int write_color(struct sysfs_backend *sysfs, enum cmd cmd, const char *value, size_t len)
+{
+	return backend_write(sysfs, led_fd(sysfs, cmd, ATTR_COLOR), value, len, false);
+}
+
+static int write_status(struct sysfs_backend *sysfs, enum cmd cmd, enum status status)
+{
+	bool trigger = sysfs->table.flags[cmd] & LED_TRIGGER;
+	const char *manual = trigger ? "none" : "0";
+	const char *automatic = trigger ? "omnia-mcu" : "1";
+
+	if (status == ST_DISABLE) {
+		if (backend_write(sysfs, led_fd(sysfs, cmd, ATTR_AUTONOMOUS), manual, strlen(manual), true) == -1) {
+			return -1;
+		}
+		return backend_write(sysfs, led_fd(sysfs, cmd, ATTR_BRIGHTNESS), "0", 1, false);
+
+	} else if (status == ST_ENABLE) {
+		if (backend_write(sysfs, led_fd(sysfs, cmd, ATTR_AUTONOMOUS), manual, strlen(manual), true) == -1) {
+			return -1;
+		}
+		return backend_write(sysfs, led_fd(sysfs, cmd, ATTR_BRIGHTNESS), "255", 3, false);
+
+	} else if (status == ST_AUTO) {
+		return backend_write(sysfs, led_fd(sysfs, cmd, ATTR_AUTONOMOUS), automatic, strlen(automatic), false);
+	}
+
+	return 0;
+}
+
+/*
+Attributes of a trigger come and go with it, so they are opened for each write
+and written at once, after the queued trigger itself. A fake tree gets them
+created.
+*/
+static int write_trigger_attr(struct sysfs_backend *sysfs, enum cmd cmd, const char *attr, const char *value)
+{
+	char path[LED_NAME_MAX + 32];
+	snprintf(path, sizeof(path), "%s/%s", sysfs->table.name[cmd], attr);
+
+	int fd = backend_open(sysfs, path, O_WRONLY | (sysfs->truncate ? O_CREAT : 0));
+	if (fd == -1) {
+		return -1;
+	}
+	int ret = write_now(sysfs, fd, value, strlen(value));
+	close(fd);
+
+	return ret;
+}
+
+static int write_trigger(struct sysfs_backend *sysfs, enum cmd cmd, enum status status, const struct trigger *trigger)
+{
+	bool multicolor = sysfs->table.flags[cmd] & LED_TRIGGER;
+	const char *name = led_trigger_name(status);
+
+	if (!name) {
+		// The status written next replaces the trigger of the multicolor LEDs
+		if (multicolor || (sysfs->table.flags[cmd] & LED_NO_TRIGGERS)) {
+			return 0;
+		}
+		return backend_write(sysfs, led_fd(sysfs, cmd, ATTR_TRIGGER), "none", 4, false);
+	}
+
+	// Omnia LEDs follow the kernel only when the MCU doesn't drive them
+	if (!multicolor && backend_write(sysfs, led_fd(sysfs, cmd, ATTR_AUTONOMOUS), "0", 1, true) == -1) {
+		return -1;
+	}
+	if (backend_write(sysfs, led_fd(sysfs, cmd, ATTR_TRIGGER), name, strlen(name), false) == -1) {
+		return -1;
+	}
+	if (status != ST_NETDEV && status != ST_TIMER && status != ST_PATTERN) {
+		return 0;
+	}
+	if (sysfs->ring && queue_flush(sysfs) == -1) {
+		return -1;
+	}
+
+	if (status == ST_PATTERN) {
+		struct pattern pattern;
+		char value[PATTERN_TEXT_MAX];
+		pattern_compile(trigger->pattern, trigger->period, &pattern);
+		// Repeat goes first, writing the pattern starts it
+		snprintf(value, sizeof(value), "%d", trigger->repeat ? (int) trigger->repeat : -1);
+		if (write_trigger_attr(sysfs, cmd, "repeat", value) == -1) {
+			return -1;
+		}
+		pattern_format(&pattern, value, sizeof(value));
+		return write_trigger_attr(sysfs, cmd, "pattern", value);
+	} else if (status == ST_TIMER) {
+		char value[16];
+		snprintf(value, sizeof(value), "%u", trigger->delay_on);
+		if (write_trigger_attr(sysfs, cmd, "delay_on", value) == -1) {
+			return -1;
+		}
+		snprintf(value, sizeof(value), "%u", trigger->delay_off);
+		return write_trigger_attr(sysfs, cmd, "delay_off", value);
+	}
+
+	if (write_trigger_attr(sysfs, cmd, "device_name", trigger->dev) == -1 ||
+		write_trigger_attr(sysfs, cmd, "link", trigger->modes & TRIGGER_LINK ? "1" : "0") == -1 ||
+		write_trigger_attr(sysfs, cmd, "rx", trigger->modes & TRIGGER_RX ? "1" : "0") == -1) {
+		return -1;
+	}
+	return write_trigger_attr(sysfs, cmd, "tx", trigger->modes & TRIGGER_TX ? "1" : "0");
+}
+
+// The multicolor driver has no LED for all of them, so each one is written
+static bool fan_out(struct sysfs_backend *sysfs, enum cmd cmd)
+{
+	return cmd == CMD_ALL && !sysfs->table.name[CMD_ALL][0];
+}
+
+static int sysfs_set_color(struct backend *backend, enum cmd cmd, unsigned int color)
+{
+	struct sysfs_backend *sysfs = (struct sysfs_backend *) backend;
+	unsigned char r, g, b;
+	get_rgb_parts(color_correct(color), &r, &g, &b);
+
+	char value[16];
+	int len = snprintf(value, sizeof(value), "%d %d %d", r, g, b);
+
+	sysfs->stats.calls++;
+	if (fan_out(sysfs, cmd)) {
+		for (int i = CMD_PWR; i < LED_COUNT; i++) {
+			if (write_color(sysfs, i, value, len) == -1) {
+				return -1;
+			}
+		}
+		return 0;
+	}
+
+	return write_color(sysfs, cmd, value, len);
+}
+
+static int sysfs_set_status(struct backend *backend, enum cmd cmd, enum status status)
+{
+	struct sysfs_backend *sysfs = (struct sysfs_backend *) backend;
+
+	sysfs->stats.calls++;
+	if (fan_out(sysfs, cmd)) {
+		for (int i = CMD_PWR; i < LED_COUNT; i++) {
+			if (write_status(sysfs, i, status) == -1) {
+				return -1;
+			}
+		}
+		return 0;
+	}
+
+	return write_status(sysfs, cmd, status);
+}
+
+static int sysfs_set_trigger(struct backend *backend, enum cmd cmd, enum status status,
+		const struct trigger *trigger)
+{
+	struct sysfs_backend *sysfs = (struct sysfs_backend *) backend;
+
+	sysfs->stats.calls++;
+	// The trigger of the 'all' LED doesn't reach the others
+	if (cmd == CMD_ALL) {
+		for (int i = CMD_PWR; i < LED_COUNT; i++) {
+			if (write_trigger(sysfs, i, status, trigger) == -1) {
+				return -1;
+			}
+		}
+		return 0;
+	}
+
+	return write_trigger(sysfs, cmd, status, trigger);
+}
+
+// The trigger attribute lists every trigger, the selected one in brackets
+static bool trigger_listed(const char *list, const char *name)
+{
+	size_t len = strlen(name);
+
+	while (*list) {
+		list += strspn(list, " \n[");
+		size_t word = strcspn(list, " \n]");
+		if (word == len && strncmp(list, name, len) == 0) {
+			return true;
+		}
+		list += word;
+		list += strspn(list, "]");
+	}
+
+	return false;
+}
+
+static int sysfs_has_trigger(struct backend *backend, enum cmd cmd, enum status status, bool *available)
+{
+	struct sysfs_backend *sysfs = (struct sysfs_backend *) backend;
+	const char *name = led_trigger_name(status);
+	char buff[4096];
+
+	sysfs->stats.calls++;
+	if (!name) {
+		*available = false;
+		return 0;
+	}
+	if (read_attr(sysfs, cmd, ATTR_TRIGGER, buff, sizeof(buff)) == -1) {
+		return -1;
+	}
+	*available = trigger_listed(buff, name);
+
+	return 0;
+}
+
+static int sysfs_commit(struct backend *backend)
+{
+	// Every write is done immediately
+	(void) backend;
+	return 0;
+}
+
+static int uring_commit(struct backend *backend)
+{
+	return queue_flush((struct sysfs_backend *) backend);
+}
+
+static void sysfs_stats(struct backend *backend, struct backend_stats *stats)
+{
+	*stats = ((struct sysfs_backend *) backend)->stats;
+}
+
+static void sysfs_destroy(struct backend *backend)
+{
+	struct sysfs_backend *sysfs = (struct sysfs_backend *) backend;
+
+	for (size_t i = 0; i <= CMD_ALL; i++) {
+		for (size_t j = 0; j < ATTR_COUNT; j++) {
+			if (sysfs->led_fds[i][j] != -1) {
+				close(sysfs->led_fds[i][j]);
+			}
+		}
+	}
+	if (sysfs->intensity_fd != -1) {
+		close(sysfs->intensity_fd);
+	}
+
+	close(sysfs->dir_fd);
+
+	uring_destroy(sysfs->ring);
+	free(sysfs->hint_path);
+	free(sysfs->dir);
+	free(sysfs);
+}
+
+static const struct backend_ops sysfs_ops = {
+	.name = "sysfs",
+	.set_color = sysfs_set_color,
+	.set_status = sysfs_set_status,
+	.set_intensity = sysfs_set_intensity,
+	.get_intensity = sysfs_get_intensity,
+	.get_led = sysfs_get_led,
+	.set_trigger = sysfs_set_trigger,
+	.has_trigger = sysfs_has_trigger,
+	.commit = sysfs_commit,
+	.stats = sysfs_stats,
+	.destroy = sysfs_destroy
+};
+
+static const struct backend_ops uring_ops = {
+	.name = "uring",
+	.set_color = sysfs_set_color,
+	.set_status = sysfs_set_status,
+	.set_intensity = sysfs_set_intensity,
+	.get_intensity = sysfs_get_intensity,
+	.get_led = sysfs_get_led,
+	.set_trigger = sysfs_set_trigger,
+	.has_trigger = sysfs_has_trigger,
+	.commit = uring_commit,
+	.stats = sysfs_stats,
+	.destroy = sysfs_destroy
+};
+
+struct backend *backend_sysfs_init(const char *root)
+{
+	struct sysfs_backend *sysfs = calloc(1, sizeof(*sysfs));
+	if (!sysfs) {
+		return NULL;
+	}
+
+	// A fake tree keeps LEDs in its leds directory like the controller device does
+	if (root) {
+		sysfs->dir = malloc(strlen(root) + sizeof("/leds"));
+		if (sysfs->dir) {
+			sprintf(sysfs->dir, "%s/leds", root);
+		}
+	} else {
+		sysfs->dir = strdup(LED_CLASS_DIR);
+	}
+	if (!sysfs->dir) {
+		free(sysfs);
+		return NULL;
+	}
+
+	sysfs->dir_fd = open(sysfs->dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (sysfs->dir_fd == -1) {
+		free(sysfs->dir);
+		free(sysfs);
+		return NULL;
+	}
+
+	// Only the real LEDs are cached, fake trees are scanned every time
+	sysfs->cached = !root && led_table_load(LED_TABLE_FILE, &sysfs->table);
+	if (!sysfs->cached) {
+		if (!led_table_scan(sysfs->dir_fd, &sysfs->table)) {
+			close(sysfs->dir_fd);
+			free(sysfs->dir);
+			free(sysfs);
+			errno = ENODEV;
+			return NULL;
+		}
+		if (!root) {
+			led_table_save(LED_TABLE_FILE, &sysfs->table);
+		}
+	}
+
+	struct statfs fs;
+	sysfs->truncate = fstatfs(sysfs->dir_fd, &fs) == 0 && fs.f_type != SYSFS_MAGIC;
+
+	for (size_t i = 0; i <= CMD_ALL; i++) {
+		for (size_t j = 0; j < ATTR_COUNT; j++) {
+			sysfs->led_fds[i][j] = -1;
+		}
+	}
+	sysfs->intensity_fd = -1;
+	sysfs->intensity_level = -1;
+	sysfs->intensity_queued = -1;
+	// A fake tree keeps its hint next to its leds, without memory there is none
+	if (root) {
+		sysfs->hint_path = malloc(strlen(root) + sizeof("/rainbow.intensity"));
+		if (sysfs->hint_path) {
+			sprintf(sysfs->hint_path, "%s/rainbow.intensity", root);
+		}
+	} else {
+		sysfs->hint_path = strdup(INTENSITY_HINT_FILE);
+	}
+	sysfs->backend.ops = &sysfs_ops;
+	sysfs->backend.hardware = root == NULL;
+	sysfs->backend.fans_out = fan_out(sysfs, CMD_ALL);
+
+	return &sysfs->backend;
+}
+
+struct backend *backend_uring_init(const char *root)
+{
+	struct backend *backend = backend_sysfs_init(root);
+	if (!backend) {
+		return NULL;
+	}
+
+	// Kernels without io_uring (or with it forbidden) keep the plain sysfs writes
+	struct sysfs_backend *sysfs = (struct sysfs_backend *) backend;
+	sysfs->ring = uring_init(URING_BATCH_MAX);
+	if (sysfs->ring) {
+		backend->ops = &uring_ops;
+	}
+
+	return backend;
+}
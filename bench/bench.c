@@ -0,0 +1,446 @@
+/*
+ * Rainbow is a tool for changing color and status of the LEDs of the Turris router
+ *
+ * Copyright (C) 2016 CZ.NIC, z.s.p.o. (http://www.nic.cz/)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+Benchmark of rainbow. It measures tokenizer and parse_color() throughput,
+runs common command lines in process against a fake sysfs tree on tmpfs to
+count writes and I/O operations of the sysfs and uring backends, and executes
+the rainbow binary with the same arguments to get wall time of a whole
+invocation. I/O operations are opens, reads and write syscalls as the
+backends count them. The in-process runs keep shadow state in a file of the
+tree the way rainbow does on the real LEDs, each starting from the same known
+state. Syscalls are counted by ptrace, of the in-process sysfs run (LED table
+scan and state file included) and of the whole executed invocation (loader
+included, fake trees have no shadow state there).
+
+Usage: bench RAINBOW_BINARY [REPORT_FILE]
+The report is written as JSON (default bench_report.json).
+*/
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/ptrace.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "../configuration.h"
+#include "../arg_parser.h"
+#include "../backend.h"
+#include "../plan.h"
+#include "../state.h"
+#include "../command.h"
+
+#define MICRO_ROUNDS 200000
+#define EXEC_ROUNDS 100
+#define MAX_ARGS 32
+
+static const char *led_names[] = {
+	"power", "lan0", "lan1", "lan2", "lan3", "lan4", "wan",
+	"pci1", "pci2", "pci3", "user1", "user2", "all"
+};
+
+static const char *commands[] = {
+	"pwr red",
+	"all blue enable",
+	"all blue pwr red",
+	"all enable lan auto",
+	"lan green wan auto",
+	"usr1 00FF7F enable usr2 black disable",
+	"binmask 0xFFF",
+	"binmask 0x0A5",
+	"all white enable intensity 100",
+	"intensity 50",
+	"get intensity",
+	NULL
+};
+
+static uint64_t now_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void write_file(const char *path, const char *content)
+{
+	int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd == -1 || write(fd, content, strlen(content)) == -1) {
+		fprintf(stderr, "Failed to create %s: %s\n", path, strerror(errno));
+		exit(1);
+	}
+	close(fd);
+}
+
+static char *fake_tree()
+{
+	static char root[] = "/dev/shm/rainbow-bench-XXXXXX";
+	static char tmp_root[] = "/tmp/rainbow-bench-XXXXXX";
+	char *dir = mkdtemp(root);
+	if (!dir) {
+		dir = mkdtemp(tmp_root);
+	}
+	if (!dir) {
+		fprintf(stderr, "Failed to create fake tree: %s\n", strerror(errno));
+		exit(1);
+	}
+
+	char path[256];
+	snprintf(path, sizeof(path), "%s/leds", dir);
+	mkdir(path, 0755);
+	for (size_t i = 0; i < sizeof(led_names) / sizeof(*led_names); i++) {
+		snprintf(path, sizeof(path), "%s/leds/omnia-led:%s", dir, led_names[i]);
+		mkdir(path, 0755);
+		const char *attrs[] = { "color", "autonomous", "brightness" };
+		for (size_t j = 0; j < 3; j++) {
+			snprintf(path, sizeof(path), "%s/leds/omnia-led:%s/%s", dir, led_names[i], attrs[j]);
+			write_file(path, "0");
+		}
+	}
+	snprintf(path, sizeof(path), "%s/global_brightness", dir);
+	write_file(path, "100");
+
+	return dir;
+}
+
+static void remove_tree(const char *root)
+{
+	char cmd[512];
+	snprintf(cmd, sizeof(cmd), "rm -rf '%s'", root);
+	if (system(cmd) != 0) {
+		fprintf(stderr, "Failed to remove %s\n", root);
+	}
+}
+
+// Splits copy of line into argv, returns argc
+static int split(char *line, char **argv)
+{
+	int argc = 0;
+	for (char *arg = strtok(line, " "); arg && argc < MAX_ARGS; arg = strtok(NULL, " ")) {
+		argv[argc++] = arg;
+	}
+	argv[argc] = NULL;
+	return argc;
+}
+
+static double bench_tokens(char **argv, size_t *tokens)
+{
+	struct tokenizer *tokenizer = tokenizer_init(argv, 0);
+	size_t count = 0;
+	uint64_t start = now_ns();
+
+	for (size_t round = 0; round < MICRO_ROUNDS; round++) {
+		tokenizer_reset(tokenizer, argv, 0);
+		while (next_token(tokenizer).type != TOK_EOF) {
+			count++;
+		}
+	}
+
+	uint64_t elapsed = now_ns() - start;
+	tokenizer_destroy(tokenizer);
+	*tokens = count;
+
+	return (double) elapsed / count;
+}
+
+static double bench_colors(char **colors)
+{
+	size_t count = 0;
+	unsigned int sum = 0;
+	uint64_t start = now_ns();
+
+	for (size_t round = 0; round < MICRO_ROUNDS; round++) {
+		for (char **color = colors; *color; color++) {
+			unsigned int value;
+			if (parse_color(*color, &value)) {
+				sum += value;
+			}
+			count++;
+		}
+	}
+
+	uint64_t elapsed = now_ns() - start;
+	// The sum keeps the calls from being optimized out
+	if (!sum) {
+		fprintf(stderr, "No color parsed\n");
+	}
+
+	return (double) elapsed / count;
+}
+
+/*
+Runs run(arg) in a child stopped under ptrace and counts the syscalls it
+enters from then on until it exits. Returns false when the child fails.
+*/
+static bool count_syscalls(void (*run)(void *), void *arg, unsigned long *count)
+{
+	pid_t pid = fork();
+	if (pid == 0) {
+		if (ptrace(PTRACE_TRACEME, 0, NULL, NULL) == -1) {
+			_exit(126);
+		}
+		raise(SIGSTOP);
+		run(arg);
+		_exit(0);
+	}
+
+	int status;
+	if (pid == -1 || waitpid(pid, &status, 0) == -1) {
+		return false;
+	}
+	if (!WIFSTOPPED(status) || ptrace(PTRACE_SETOPTIONS, pid, NULL, PTRACE_O_TRACESYSGOOD | PTRACE_O_EXITKILL) == -1) {
+		kill(pid, SIGKILL);
+		waitpid(pid, &status, 0);
+		return false;
+	}
+
+	*count = 0;
+	int sig = 0;
+	while (ptrace(PTRACE_SYSCALL, pid, NULL, sig) != -1 && waitpid(pid, &status, 0) != -1 && WIFSTOPPED(status)) {
+		sig = 0;
+		if (WSTOPSIG(status) == (SIGTRAP | 0x80)) {
+			struct __ptrace_syscall_info info;
+			if (ptrace(PTRACE_GET_SYSCALL_INFO, pid, sizeof(info), &info) > 0 &&
+				info.op == PTRACE_SYSCALL_INFO_ENTRY) {
+				(*count)++;
+			}
+		} else if (WSTOPSIG(status) != SIGTRAP) {
+			// The SIGTRAP after execve is of ptrace, the other signals belong to the child
+			sig = WSTOPSIG(status);
+		}
+	}
+
+	return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+struct command_result {
+	const char *line;
+	struct backend_stats stats;
+	struct backend_stats uring_stats;
+	unsigned long syscalls;
+	unsigned long exec_syscalls;
+	double wall_us;
+};
+
+struct in_process {
+	const char *name;
+	const char *root;
+	const char *line;
+	const char *state_path;
+	struct backend_stats *stats;
+};
+
+static void run_in_process(const struct in_process *run)
+{
+	const char *name = run->name, *root = run->root, *line = run->line;
+	char copy[256], spec[256];
+	char *argv[MAX_ARGS + 1];
+	struct led_state current;
+
+	snprintf(copy, sizeof(copy), "%s", line);
+	snprintf(spec, sizeof(spec), "%s:%s", name, root);
+	split(copy, argv);
+
+	struct backend *backend = backend_create(spec);
+	struct tokenizer *tokenizer = tokenizer_init(argv, 0);
+	FILE *null = fopen("/dev/null", "w");
+	if (!backend || !tokenizer || !null) {
+		fprintf(stderr, "Failed to prepare run of '%s'\n", line);
+		exit(1);
+	}
+
+	// Locked from load until save as by rb_lock() and rb_unlock()
+	int lock = state_lock(run->state_path);
+	state_load(run->state_path, &current);
+	struct led_state saved = current;
+	if (run_command(tokenizer, backend, &current, NULL, null, stderr) != RUN_OK) {
+		fprintf(stderr, "Command '%s' failed\n", line);
+		exit(1);
+	}
+	if (lock != -1 && !state_equal(&saved, &current)) {
+		state_save(run->state_path, &current);
+	}
+	state_unlock(lock);
+	backend_stats(backend, run->stats);
+
+	fclose(null);
+	tokenizer_destroy(tokenizer);
+	backend_destroy(backend);
+}
+
+static void run_traced(void *arg)
+{
+	struct backend_stats stats;
+	struct in_process run = *(struct in_process *) arg;
+
+	run.stats = &stats;
+	run_in_process(&run);
+}
+
+static void exec_binary(void *arg)
+{
+	char **argv = arg;
+	int null = open("/dev/null", O_WRONLY);
+
+	dup2(null, STDOUT_FILENO);
+	execv(argv[0], argv);
+	_exit(127);
+}
+
+static double run_exec(const char *binary, const char *root, const char *line, unsigned long *syscalls)
+{
+	char copy[256], spec[256];
+	char *argv[MAX_ARGS + 5];
+
+	snprintf(copy, sizeof(copy), "%s", line);
+	snprintf(spec, sizeof(spec), "sysfs:%s", root);
+	argv[0] = (char *) binary;
+	argv[1] = "--backend";
+	argv[2] = spec;
+	split(copy, argv + 3);
+
+	if (!count_syscalls(exec_binary, argv, syscalls)) {
+		fprintf(stderr, "Failed to count syscalls of '%s %s'\n", binary, line);
+		exit(1);
+	}
+
+	uint64_t start = now_ns();
+	for (size_t round = 0; round < EXEC_ROUNDS; round++) {
+		pid_t pid = fork();
+		if (pid == 0) {
+			exec_binary(argv);
+		}
+
+		int status;
+		if (pid == -1 || waitpid(pid, &status, 0) == -1 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+			fprintf(stderr, "Execution of '%s %s' failed\n", binary, line);
+			exit(1);
+		}
+	}
+
+	return (double) (now_ns() - start) / EXEC_ROUNDS / 1000;
+}
+
+int main(int argc, char **argv)
+{
+	if (argc < 2) {
+		fprintf(stderr, "Usage: %s RAINBOW_BINARY [REPORT_FILE]\n", argv[0]);
+		return 1;
+	}
+	const char *binary = argv[1];
+	const char *report_path = argc > 2 ? argv[2] : "bench_report.json";
+
+	char mixed_line[] = "all blue enable pwr red lan auto intensity 50 binmask 0xFFF wan 00FF00 disable";
+	char color_line[] = "red green blue white black FF0000 00ff00 0000FF 123456 abcdef";
+	char hex_line[] = "FF0000 00ff00 0000FF 123456 abcdef 000000 FFFFFF 12345G";
+	char *mixed[MAX_ARGS + 1], *colors[MAX_ARGS + 1], *hex[MAX_ARGS + 1];
+	size_t mixed_tokens, color_tokens;
+	split(mixed_line, mixed);
+	split(color_line, colors);
+	split(hex_line, hex);
+
+	double mixed_ns = bench_tokens(mixed, &mixed_tokens);
+	double color_ns = bench_tokens(colors, &color_tokens);
+	double parse_ns = bench_colors(hex);
+	printf("next_token (mixed): %8.1f ns/token\n", mixed_ns);
+	printf("next_token (color): %8.1f ns/token\n", color_ns);
+	printf("parse_color:        %8.1f ns/color\n", parse_ns);
+
+	char *root = fake_tree();
+	size_t count = 0;
+	while (commands[count]) {
+		count++;
+	}
+	struct command_result results[count];
+
+	// Every run starts from the state the first command leaves
+	char state_path[256];
+	struct led_state base;
+	struct backend_stats base_stats;
+	snprintf(state_path, sizeof(state_path), "%s/rainbow.state", root);
+	run_in_process(&(struct in_process) { "sysfs", root, "all black disable", state_path, &base_stats });
+	state_load(state_path, &base);
+
+	printf("%-40s %10s %7s %6s %6s %8s %8s %8s\n", "command", "wall[us]", "writes", "io_ops", "bytes", "uring_io",
+		"syscalls", "exec_sys");
+	for (size_t i = 0; i < count; i++) {
+		struct in_process sysfs = { "sysfs", root, commands[i], state_path, &results[i].stats };
+		struct in_process uring = { "uring", root, commands[i], state_path, &results[i].uring_stats };
+
+		results[i].line = commands[i];
+		state_save(state_path, &base);
+		run_in_process(&sysfs);
+		state_save(state_path, &base);
+		run_in_process(&uring);
+		state_save(state_path, &base);
+		if (!count_syscalls(run_traced, &sysfs, &results[i].syscalls)) {
+			fprintf(stderr, "Failed to count syscalls of '%s'\n", commands[i]);
+			exit(1);
+		}
+		results[i].wall_us = run_exec(binary, root, commands[i], &results[i].exec_syscalls);
+
+		struct backend_stats *stats = &results[i].stats;
+		struct backend_stats *uring_stats = &results[i].uring_stats;
+		printf("%-40s %10.1f %7lu %6lu %6lu %8lu %8lu %8lu\n", commands[i], results[i].wall_us, stats->writes,
+			stats->opens + stats->transactions + stats->reads, stats->bytes,
+			uring_stats->opens + uring_stats->transactions + uring_stats->reads,
+			results[i].syscalls, results[i].exec_syscalls);
+	}
+	remove_tree(root);
+
+	FILE *report = fopen(report_path, "w");
+	if (!report) {
+		fprintf(stderr, "Failed to write report %s: %s\n", report_path, strerror(errno));
+		return 1;
+	}
+	fprintf(report, "{\n");
+	fprintf(report, "  \"micro\": {\n");
+	fprintf(report, "    \"next_token_mixed_ns\": %.1f,\n", mixed_ns);
+	fprintf(report, "    \"next_token_color_ns\": %.1f,\n", color_ns);
+	fprintf(report, "    \"parse_color_ns\": %.1f,\n", parse_ns);
+	fprintf(report, "    \"tokens\": %zu\n", mixed_tokens + color_tokens);
+	fprintf(report, "  },\n");
+	fprintf(report, "  \"commands\": [\n");
+	for (size_t i = 0; i < count; i++) {
+		struct backend_stats *stats = &results[i].stats;
+		struct backend_stats *uring = &results[i].uring_stats;
+		fprintf(report, "    {\"command\": \"%s\", \"wall_us\": %.1f, \"writes\": %lu, "
+			"\"io_ops\": %lu, \"opens\": %lu, \"bytes\": %lu, \"uring_io_ops\": %lu, "
+			"\"syscalls\": %lu, \"exec_syscalls\": %lu}%s\n",
+			results[i].line, results[i].wall_us, stats->writes,
+			stats->opens + stats->transactions + stats->reads, stats->opens, stats->bytes,
+			uring->opens + uring->transactions + uring->reads,
+			results[i].syscalls, results[i].exec_syscalls, i + 1 < count ? "," : "");
+	}
+	fprintf(report, "  ]\n");
+	fprintf(report, "}\n");
+	fclose(report);
+	printf("Report written to %s\n", report_path);
+
+	return 0;
+}
@@ -0,0 +1,112 @@
+/*
+ * Rainbow is a tool for changing color and status of the LEDs of the Turris router
+ *
+ * Copyright (C) 2016 CZ.NIC, z.s.p.o. (http://www.nic.cz/)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "configuration.h"
+#include "color.h"
+
+#include "color_tables.h"
+
+unsigned int color_correct(unsigned int color)
+{
+	return gamma_table[0][(color >> 16) & 0xFF] << 16 | gamma_table[1][(color >> 8) & 0xFF] << 8 |
+		gamma_table[2][color & 0xFF];
+}
+
+// The table grows, the first value closest to device wins, so black stays black
+static unsigned int channel_uncorrect(const unsigned char *table, unsigned int device)
+{
+	unsigned int best = 0, best_diff = 256;
+
+	for (unsigned int i = 0; i < 256; i++) {
+		unsigned int diff = table[i] > device ? table[i] - device : device - table[i];
+		if (diff < best_diff) {
+			best = i;
+			best_diff = diff;
+		}
+	}
+
+	return best;
+}
+
+unsigned int color_uncorrect(unsigned int device)
+{
+	return channel_uncorrect(gamma_table[0], (device >> 16) & 0xFF) << 16 |
+		channel_uncorrect(gamma_table[1], (device >> 8) & 0xFF) << 8 |
+		channel_uncorrect(gamma_table[2], device & 0xFF);
+}
+
+unsigned int intensity_correct(unsigned int level)
+{
+	return intensity_table[level <= MAX_INTENSITY_LEVEL ? level : MAX_INTENSITY_LEVEL];
+}
+
+unsigned int intensity_level(unsigned int brightness, int hint)
+{
+	if (hint >= 0 && hint <= MAX_INTENSITY_LEVEL && intensity_table[hint] == brightness) {
+		return hint;
+	}
+
+	// The table grows, so the first level reaching brightness is the closest one
+	for (unsigned int i = 0; i <= MAX_INTENSITY_LEVEL; i++) {
+		if (intensity_table[i] >= brightness) {
+			return i;
+		}
+	}
+
+	return MAX_INTENSITY_LEVEL;
+}
+
+// Reading brightness back can't tell such level from its neighbour
+static bool intensity_shared(unsigned int level)
+{
+	return (level > 0 && intensity_table[level - 1] == intensity_table[level]) ||
+		(level < MAX_INTENSITY_LEVEL && intensity_table[level + 1] == intensity_table[level]);
+}
+
+int intensity_hint_load(const char *path)
+{
+	int level = -1;
+	FILE *file = path ? fopen(path, "re") : NULL;
+
+	if (file) {
+		if (fscanf(file, "%d", &level) != 1) {
+			level = -1;
+		}
+		fclose(file);
+	}
+
+	return level;
+}
+
+void intensity_hint_save(const char *path, unsigned int level)
+{
+	if (!path || level > MAX_INTENSITY_LEVEL || !intensity_shared(level)) {
+		return;
+	}
+
+	// Losing the hint only makes the lowest of the levels read back
+	FILE *file = fopen(path, "we");
+	if (file) {
+		fprintf(file, "%u\n", level);
+		fclose(file);
+	}
+}
@@ -0,0 +1,52 @@
+/*
+ * Rainbow is a tool for changing color and status of the LEDs of the Turris router
+ *
+ * Copyright (C) 2016 CZ.NIC, z.s.p.o. (http://www.nic.cz/)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef COLOR_H
+#define COLOR_H
+
+/*
+Colors and intensity used everywhere in rainbow are perceptual values, the
+backends driving the LEDs convert them to what the hardware takes. Colors
+get per channel gamma and white balance, intensity follows the lightness
+curve. Everything is looked up in tables generated at build time.
+*/
+
+// Device color of RGB color
+unsigned int color_correct(unsigned int color);
+/*
+RGB color of device color. More colors share a device color at the low end,
+the lowest one is returned. Device values no color maps to give the closest.
+*/
+unsigned int color_uncorrect(unsigned int device);
+// Device brightness of intensity level
+unsigned int intensity_correct(unsigned int level);
+/*
+Intensity level of device brightness. More levels share a brightness at the
+low end, the level last set (hint, -1 if none) wins among them.
+*/
+unsigned int intensity_level(unsigned int brightness, int hint);
+/*
+The hint outlives the process in path (NULL for none). It is saved only for
+levels sharing their brightness, so the identity pipeline never touches it.
+Load returns -1 when there is no hint.
+*/
+int intensity_hint_load(const char *path);
+void intensity_hint_save(const char *path, unsigned int level);
+
+#endif //COLOR_H
@@ -0,0 +1,77 @@
+/*
+ * Rainbow is a tool for changing color and status of the LEDs of the Turris router
+ *
+ * Copyright (C) 2016 CZ.NIC, z.s.p.o. (http://www.nic.cz/)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+Generates color_tables.h, lookup tables of the color pipeline computed from
+COLOR_* and INTENSITY_* in configuration.h. It is run at build time, so the
+correction of a color is three table lookups without any floating point.
+*/
+
+#include <stdio.h>
+#include <math.h>
+
+#include "configuration.h"
+
+static unsigned int channel(unsigned int value, double gamma, unsigned int max)
+{
+	return (unsigned int) lround(pow(value / 255.0, gamma) * max);
+}
+
+// CIE 1931 lightness, level is L* and the result is relative luminance
+static double lightness(unsigned int level)
+{
+	double l = level;
+	return l > 8 ? pow((l + 16) / 116, 3) : l / 903.3;
+}
+
+static void print_channel(const char *name, unsigned int max)
+{
+	printf("\t[%s] = {", name);
+	for (unsigned int i = 0; i < 256; i++) {
+		printf("%s%u,", i % 16 ? " " : "\n\t\t", channel(i, COLOR_GAMMA, max));
+	}
+	printf("\n\t},\n");
+}
+
+int main()
+{
+	printf("// Generated by color_gen, do not edit\n\n");
+
+	printf("static const unsigned char gamma_table[3][256] = {");
+	print_channel("0", COLOR_BALANCE_RED);
+	print_channel("1", COLOR_BALANCE_GREEN);
+	print_channel("2", COLOR_BALANCE_BLUE);
+	printf("};\n\n");
+
+	printf("static const unsigned char intensity_table[MAX_INTENSITY_LEVEL + 1] = {");
+	for (unsigned int i = 0; i <= MAX_INTENSITY_LEVEL; i++) {
+		unsigned int value = i;
+		if (INTENSITY_PERCEPTUAL) {
+			value = lround(lightness(i) * MAX_INTENSITY_LEVEL);
+			// Only 0 switches the LEDs off
+			if (i > 0 && value == 0) {
+				value = 1;
+			}
+		}
+		printf("%s%u,", i % 16 ? " " : "\n\t", value);
+	}
+	printf("\n};\n");
+
+	return 0;
+}
@@ -0,0 +1,415 @@
+/*
+ * Rainbow is a tool for changing color and status of the LEDs of the Turris router
+ *
+ * Copyright (C) 2016 CZ.NIC, z.s.p.o. (http://www.nic.cz/)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+
+#include "configuration.h"
+#include "arg_parser.h"
+#include "backend.h"
+#include "command.h"
+#include "plan.h"
+#include "animation.h"
+#include "snapshot.h"
+
+static void meta_set_color(struct led_state *plan, enum cmd cmd, unsigned int color)
+{
+	switch (cmd) {
+	case CMD_ALL:
+		for (int i = CMD_PWR; i < LED_COUNT; i++) {
+			plan_set_color(plan, i, color);
+		}
+		plan_mark_group(plan, LED_ALL_MASK, 0);
+		break;
+	case CMD_LAN:
+		plan_set_color(plan, CMD_LAN0, color);
+		plan_set_color(plan, CMD_LAN1, color);
+		plan_set_color(plan, CMD_LAN2, color);
+		plan_set_color(plan, CMD_LAN3, color);
+		plan_set_color(plan, CMD_LAN4, color);
+		plan_mark_group(plan, cmd_mask(CMD_LAN), 0);
+		break;
+	case CMD_UNDEF:
+	case CMD_INTEN:
+	case CMD_BINMASK:
+	case CMD_GET:
+		assert(NULL);
+		break;
+	default:
+		plan_set_color(plan, cmd, color);
+	}
+}
+
+static void meta_set_status(struct led_state *plan, enum cmd cmd, enum status status)
+{
+	switch (cmd) {
+	case CMD_ALL:
+		for (int i = CMD_PWR; i < LED_COUNT; i++) {
+			plan_set_status(plan, i, status);
+		}
+		plan_mark_group(plan, 0, LED_ALL_MASK);
+		break;
+	case CMD_LAN:
+		plan_set_status(plan, CMD_LAN0, status);
+		plan_set_status(plan, CMD_LAN1, status);
+		plan_set_status(plan, CMD_LAN2, status);
+		plan_set_status(plan, CMD_LAN3, status);
+		plan_set_status(plan, CMD_LAN4, status);
+		plan_mark_group(plan, 0, cmd_mask(CMD_LAN));
+		break;
+	case CMD_UNDEF:
+	case CMD_INTEN:
+	case CMD_BINMASK:
+	case CMD_GET:
+		assert(NULL);
+		break;
+	default:
+		plan_set_status(plan, cmd, status);
+	}
+}
+
+static void meta_set_trigger(struct led_state *plan, enum cmd cmd, enum status status, const struct trigger *trigger)
+{
+	unsigned int mask = cmd_mask(cmd);
+
+	for (int i = CMD_PWR; i < LED_COUNT; i++) {
+		if (mask & LED_BIT(i)) {
+			plan_set_trigger(plan, i, status, trigger);
+		}
+	}
+	if (cmd == CMD_ALL || cmd == CMD_LAN) {
+		plan_mark_group(plan, 0, mask);
+	}
+}
+
+static void binmask_set(struct led_state *plan, unsigned mask, unsigned position, enum cmd cmd)
+{
+	if (mask & position) {
+		plan_set_status(plan, cmd, ST_ENABLE);
+	} else {
+		plan_set_status(plan, cmd, ST_DISABLE);
+	}
+}
+
+static void binmask(struct led_state *plan, unsigned int mask)
+{
+	binmask_set(plan, mask, 0x800, CMD_PWR);
+	binmask_set(plan, mask, 0x400, CMD_LAN0);
+	binmask_set(plan, mask, 0x200, CMD_LAN1);
+	binmask_set(plan, mask, 0x100, CMD_LAN2);
+	binmask_set(plan, mask, 0x080, CMD_LAN3);
+	binmask_set(plan, mask, 0x040, CMD_LAN4);
+	binmask_set(plan, mask, 0x020, CMD_WAN);
+	binmask_set(plan, mask, 0x010, CMD_PCI1);
+	binmask_set(plan, mask, 0x008, CMD_PCI2);
+	binmask_set(plan, mask, 0x004, CMD_PCI3);
+	binmask_set(plan, mask, 0x002, CMD_USR1);
+	binmask_set(plan, mask, 0x001, CMD_USR2);
+	plan_mark_group(plan, 0, LED_ALL_MASK);
+}
+
+/*
+Reads optional parameters of an effect: up to two colors and period in ms.
+*/
+static void effect_params(struct tokenizer *tokenizer, struct effect_params *params)
+{
+	size_t colors = 0;
+	bool period = false;
+
+	params->color[0] = 0xFFFFFF;
+	params->color[1] = 0x000000;
+	params->period = ANIMATION_PERIOD;
+
+	while (true) {
+		struct token token = peek_token(tokenizer);
+		if (token.type == TOK_COLOR && colors < 2) {
+			params->color[colors++] = token.data.color;
+		} else if (token.type == TOK_NUMBER && !period) {
+			params->period = token.data.number;
+			period = true;
+		} else {
+			break;
+		}
+		next_token(tokenizer);
+	}
+}
+
+// The kernel may be built without some triggers, every LED of cmd needs it
+static bool trigger_available(struct backend *backend, enum cmd cmd, enum status status)
+{
+	unsigned int mask = cmd_mask(cmd);
+
+	for (int i = CMD_PWR; i < LED_COUNT; i++) {
+		bool available;
+		if ((mask & LED_BIT(i)) && (backend_has_trigger(backend, i, status, &available) == -1 || !available)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/*
+Runs the pattern by the effect engine instead of the missing pattern trigger.
+Each LED is started on its own as it keeps its color.
+*/
+static void pattern_fallback(struct led_state *plan, struct effect_params *pending, unsigned int *pending_mask,
+		enum cmd cmd, const struct trigger *trigger)
+{
+	unsigned int mask = cmd_mask(cmd);
+
+	for (int i = CMD_PWR; i < LED_COUNT; i++) {
+		if (mask & LED_BIT(i)) {
+			pending[i] = (struct effect_params) {
+				.effect = EFF_PATTERN,
+				.period = trigger->period,
+				.group = LED_BIT(i),
+				.pattern = trigger->pattern,
+				.repeat = trigger->repeat
+			};
+		}
+	}
+	*pending_mask |= mask;
+	meta_set_status(plan, cmd, ST_ENABLE);
+}
+
+/*
+Applies plan and then starts effects requested in the same command. Static
+colors stop animations of their LEDs, so the engine doesn't override them.
+*/
+static int apply(struct led_state *plan, struct effect_params *pending, unsigned int *pending_mask,
+		struct backend *backend, struct led_state *current, struct animator *animator)
+{
+	if (animator) {
+		animator_stop(animator, plan->color_mask, current);
+	}
+
+	if (plan_apply(plan, current, backend) == -1) {
+		return -1;
+	}
+
+	for (size_t i = 0; i < LED_COUNT && *pending_mask; i++) {
+		if (*pending_mask & LED_BIT(i)) {
+			unsigned int mask = pending[i].group & *pending_mask;
+			if (pending[i].effect == EFF_PATTERN) {
+				pending[i].color[0] = current->color_mask & LED_BIT(i) ? current->color[i] : 0xFFFFFF;
+			}
+			if (!animator_start(animator, mask, &pending[i], current)) {
+				return -1;
+			}
+			*pending_mask &= ~mask;
+		}
+	}
+
+	return 0;
+}
+
+// Messages about the arguments of a script tell its line
+__attribute__((format(printf, 3, 4)))
+static void usage_error(FILE *err, struct tokenizer *tokenizer, const char *format, ...)
+{
+	unsigned int line = tokenizer_line(tokenizer);
+	va_list args;
+
+	if (line) {
+		fprintf(err, "Line %u: ", line);
+	}
+	va_start(args, format);
+	vfprintf(err, format, args);
+	va_end(args);
+}
+
+// Errno of the failed call is kept for the caller
+static enum run_result backend_error(FILE *err)
+{
+	int error = errno;
+
+	fprintf(err, "Backend error: %s\n", strerror(error));
+	errno = error;
+	return RUN_ERR_BACKEND;
+}
+
+enum run_result run_command(struct tokenizer *tokenizer, struct backend *backend, struct led_state *current,
+		struct animator *animator, FILE *out, FILE *err)
+{
+	/*
+	Arguments are first compiled into the desired state of every LED (last
+	one wins) and the minimal set of writes is emitted at the end.
+	*/
+	struct led_state plan;
+	struct effect_params pending[LED_COUNT];
+	unsigned int pending_mask = 0;
+	enum cmd current_cmd = CMD_UNDEF;
+	bool eof = false;
+
+	state_clear(&plan);
+
+	while (!eof) {
+		struct token token = next_token(tokenizer);
+
+		switch (token.type) {
+		case TOK_UNDEF:
+			usage_error(err, tokenizer, "Undefined sequence: %s is some garbage\n", token.raw);
+			return RUN_ERR_USAGE;
+		case TOK_CMD:
+			switch (token.data.cmd) {
+			case CMD_GET:
+				token = next_token(tokenizer);
+				if (token.type != TOK_CMD) {
+					usage_error(err, tokenizer, "Specify item for get command\n");
+					return RUN_ERR_USAGE;
+				}
+				if (token.data.cmd == CMD_INTEN) {
+					// Apply what was requested so far first
+					unsigned int level;
+					if (apply(&plan, pending, &pending_mask, backend, current, animator) == -1 ||
+						backend_get_intensity(backend, &level) == -1) {
+						return backend_error(err);
+					}
+					fprintf(out, "%u\n", level);
+				} else if (token.data.cmd == CMD_ALL) {
+					if (apply(&plan, pending, &pending_mask, backend, current, animator) == -1) {
+						return backend_error(err);
+					}
+					enum run_result ret = snapshot_get(false, backend, current, out);
+					if (ret != RUN_OK) {
+						return ret;
+					}
+				} else {
+					usage_error(err, tokenizer, "Unknown getter\n");
+					return RUN_ERR_USAGE;
+				}
+				break;
+			case CMD_INTEN:
+				token = next_token(tokenizer);
+				if (token.type != TOK_NUMBER) {
+					usage_error(err, tokenizer, "Specify intensity level\n");
+					return RUN_ERR_USAGE;
+				}
+				if (token.data.number <= MAX_INTENSITY_LEVEL) {
+					plan_set_intensity(&plan, token.data.number);
+				} else {
+					usage_error(err, tokenizer, "Intensity is out of range [0-100]\n");
+					return RUN_ERR_USAGE;
+				}
+				break;
+			case CMD_BINMASK:
+				token = next_token(tokenizer);
+				if (token.type != TOK_NUMBER) {
+					usage_error(err, tokenizer, "Specify binary mask\n");
+					return RUN_ERR_USAGE;
+				}
+				if (token.data.number <= MAX_BINMASK_VALUE) {
+					binmask(&plan, token.data.number);
+				} else {
+					usage_error(err, tokenizer, "Number is out of range [0-0xFFF]\n");
+					return RUN_ERR_USAGE;
+				}
+				break;
+			case CMD_UNDEF:
+				usage_error(err, tokenizer, "Undefined command\n");
+				return RUN_ERR_USAGE;
+			default: // The rest of command is some real device
+				current_cmd = token.data.cmd;
+				break;
+			}
+			break;
+		case TOK_NUMBER:
+			usage_error(err, tokenizer, "Unexpected value: %s\n", token.raw);
+			return RUN_ERR_USAGE;
+		case TOK_COLOR:
+			if (current_cmd == CMD_UNDEF) {
+				usage_error(err, tokenizer, "Trying to configure undefined device\n");
+				return RUN_ERR_USAGE;
+			}
+			meta_set_color(&plan, current_cmd, token.data.color);
+			// Patterns run in the color of the LED, any other effect is stopped
+			for (size_t i = 0; i < LED_COUNT; i++) {
+				if ((cmd_mask(current_cmd) & pending_mask & LED_BIT(i)) && pending[i].effect != EFF_PATTERN) {
+					pending_mask &= ~LED_BIT(i);
+				}
+			}
+			break;
+
+		case TOK_STATUS:
+			if (current_cmd == CMD_UNDEF) {
+				usage_error(err, tokenizer, "Trying to configure undefined device\n");
+				return RUN_ERR_USAGE;
+			}
+			if (STATUS_TRIGGER(token.data.status)) {
+				// The token carries only the status, parameters are in the raw string
+				struct trigger trigger;
+				parse_trigger(token.raw, &token.data.status, &trigger);
+				if (token.data.status == ST_PATTERN && animator &&
+					!trigger_available(backend, current_cmd, ST_PATTERN)) {
+					pattern_fallback(&plan, pending, &pending_mask, current_cmd, &trigger);
+				} else {
+					meta_set_trigger(&plan, current_cmd, token.data.status, &trigger);
+				}
+			} else {
+				meta_set_status(&plan, current_cmd, token.data.status);
+			}
+			break;
+
+		case TOK_EFFECT: {
+			if (current_cmd == CMD_UNDEF) {
+				usage_error(err, tokenizer, "Trying to configure undefined device\n");
+				return RUN_ERR_USAGE;
+			}
+			if (!animator) {
+				usage_error(err, tokenizer, "Effects are not available here\n");
+				return RUN_ERR_USAGE;
+			}
+
+			unsigned int mask = cmd_mask(current_cmd);
+			struct effect_params params = {
+				.effect = token.data.effect,
+				.group = mask
+			};
+			effect_params(tokenizer, &params);
+
+			for (size_t i = 0; i < LED_COUNT; i++) {
+				if (mask & LED_BIT(i)) {
+					pending[i] = params;
+				}
+			}
+			pending_mask |= mask;
+			plan.color_mask &= ~mask;
+			if (params.effect != EFF_STOP) {
+				meta_set_status(&plan, current_cmd, ST_ENABLE);
+			}
+			break;
+		}
+
+		case TOK_EOF:
+			if (apply(&plan, pending, &pending_mask, backend, current, animator) == -1) {
+				return backend_error(err);
+			}
+			eof = true;
+			break;
+		}
+
+	}
+
+	return RUN_OK;
+}
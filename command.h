@@ -0,0 +1,49 @@
+/*
+ * Rainbow is a tool for changing color and status of the LEDs of the Turris router
+ *
+ * Copyright (C) 2016 CZ.NIC, z.s.p.o. (http://www.nic.cz/)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef COMMAND_H
+#define COMMAND_H
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "arg_parser.h"
+#include "backend.h"
+#include "plan.h"
+#include "animation.h"
+
+// Values match exit codes of rainbow
+enum run_result {
+	RUN_OK = 0,
+	RUN_ERR_USAGE = 1,
+	RUN_ERR_MEMORY = 2,
+	RUN_ERR_BACKEND = 3
+};
+
+/*
+Reads tokens until TOK_EOF and applies them to backend at once, skipping
+values that current already holds. Current is updated by what was written.
+Effects are started on animator, they are refused when it is NULL.
+Values requested by 'get' are printed to out, error messages to err. Stops
+on the first error, in that case nothing after the last 'get' is applied.
+*/
+enum run_result run_command(struct tokenizer *tokenizer, struct backend *backend, struct led_state *current,
+		struct animator *animator, FILE *out, FILE *err);
+
+#endif //COMMAND_H
@@ -21,6 +21,52 @@
 #define CONFIGURATION_H
 
 #define MAX_BINMASK_VALUE 0xFFF
+#define LED_COUNT 12
 #define MAX_INTENSITY_LEVEL 100
 
+// Color pipeline, tables are generated by color_gen (gamma 1.0 and 255 is identity)
+#define COLOR_GAMMA 1.0
+#define COLOR_BALANCE_RED 255 // device value of full red
+#define COLOR_BALANCE_GREEN 255
+#define COLOR_BALANCE_BLUE 255
+#define INTENSITY_PERCEPTUAL 0 // 1 makes intensity follow CIE lightness instead of linear brightness
+
+#define ANIMATION_FPS 30
+#define ANIMATION_PERIOD 1000 // default period of effects in ms
+
+#define I2C_ADAPTER "/dev/i2c-1"
+#define I2C_LED_ADDRESS 0x2b
+
+#define LED_CLASS_DIR "/sys/class/leds"
+#define LED_TABLE_FILE "/run/rainbow.leds"
+#define URING_BATCH_MAX 64 // attribute writes submitted by one io_uring_enter
+
+#define FRAMEBUFFER_FILE "/dev/shm/rainbow-fb"
+#define FRAMEBUFFER_WAIT 1000 // ms the flusher sleeps at most, bounds its reaction to a signal
+
+#define STATE_FILE "/run/rainbow.state"
+#define INTENSITY_HINT_FILE "/run/rainbow.intensity" // last level of a brightness shared by more levels
+#define STATS_FILE "/run/rainbow.stats"
+#define STATS_INTERVAL 10000 // ms between updates of STATS_FILE by long-running modes
+
+#define SCENE_DIR "/etc/rainbow/scenes"
+
+#define LAYER_FILE "/run/rainbow.layers"
+#define LAYER_MAX 8
+#define LAYER_NAME_MAX 16
+
+#define LINK_COLOR_CARRIER 0x00FF00
+#define LINK_COLOR_NO_CARRIER 0xFF0000
+
+#define METRIC_INTERVAL 1000 // ms between samples of metrics
+#define METRIC_MAX_BINDINGS 12
+#define METRIC_THERMAL_ZONE "/sys/class/thermal/thermal_zone%u/temp"
+
+#define RAINBOWD_SOCKET "/var/run/rainbowd.sock"
+#define RAINBOWD_MAX_CLIENTS 16
+#define RAINBOWD_LINE_MAX 1024
+#define RAINBOWD_MAX_ARGS 64
+// Replies queued for a client that doesn't read them, it is dropped past that
+#define RAINBOWD_OUT_MAX 16384
+
 #endif //CONFIGURATION_H
@@ -0,0 +1,421 @@
+/*
+ * Rainbow is a tool for changing color and status of the LEDs of the Turris router
+ *
+ * Copyright (C) 2016 CZ.NIC, z.s.p.o. (http://www.nic.cz/)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "configuration.h"
+#include "librainbow.h"
+
+/*
+rainbowd keeps one process, one tokenizer, the cached sysfs descriptors and
+the animation engine alive and accepts the same DEV/COLOR/STATUS command lines that rainbow takes
+on its command line. Every line sent over the UNIX socket is answered by the
+output of the command (if any) followed by "OK" or a single "ERR <message>"
+line. Backend errors are reported to the client, the daemon keeps running.
+Replies are queued and sent as the client reads them, so a slow client never
+blocks the others.
+*/
+
+static struct option long_options[] = {
+	{"help", no_argument, 0, 'h'},
+	{"socket", required_argument, 0, 's'},
+	{"backend", required_argument, 0, 'b'},
+	{0, 0, 0, 0}
+};
+
+/*
+Eof is set when the client is done sending, it is closed once its queued
+replies are sent.
+*/
+struct client {
+	int fd;
+	bool eof;
+	size_t len;
+	size_t out_len;
+	char buff[RAINBOWD_LINE_MAX];
+	char out[RAINBOWD_OUT_MAX];
+};
+
+static struct client clients[RAINBOWD_MAX_CLIENTS];
+static struct pollfd pfds[RAINBOWD_MAX_CLIENTS + 2];
+static struct rainbow *rb = NULL;
+static volatile sig_atomic_t terminate = 0;
+
+static void help()
+{
+	fprintf(stdout,
+		"Usage:\n"
+		"  Show this help: rainbowd --help or -h\n"
+		"  Run daemon: rainbowd [--socket PATH] [--backend NAME[:ARG]]\n"
+		"\n"
+		"  --socket PATH, -s PATH: listen on UNIX socket PATH (default " RAINBOWD_SOCKET ")\n"
+		"  --backend NAME[:ARG], -b NAME[:ARG]: backend as in 'rainbow --help'\n"
+		"\n"
+		"Every line sent to the socket is processed as arguments of rainbow, e.g.:\n"
+		"  echo 'all blue pwr red' | socat - UNIX-CONNECT:" RAINBOWD_SOCKET "\n"
+		"Each line is answered by its output followed by 'OK' or 'ERR message'.\n"
+	);
+}
+
+static void signal_handler(int sig)
+{
+	(void) sig;
+	terminate = 1;
+}
+
+static int listen_socket(const char *path)
+{
+	struct sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		fprintf(stderr, "Socket path is too long: %s\n", path);
+		return -1;
+	}
+	strcpy(addr.sun_path, path);
+
+	int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+	if (fd == -1) {
+		fprintf(stderr, "Failed to create socket: %s\n", strerror(errno));
+		return -1;
+	}
+
+	unlink(path);
+	if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) == -1 || listen(fd, RAINBOWD_MAX_CLIENTS) == -1) {
+		fprintf(stderr, "Failed to listen on %s: %s\n", path, strerror(errno));
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+static void client_close(struct client *client)
+{
+	close(client->fd);
+	client->fd = -1;
+	client->eof = false;
+	client->len = 0;
+	client->out_len = 0;
+}
+
+// Sends as much of the queued replies as the socket takes now, false on error
+static bool client_flush(struct client *client)
+{
+	size_t sent = 0;
+
+	while (sent < client->out_len) {
+		ssize_t ret = send(client->fd, client->out + sent, client->out_len - sent, MSG_NOSIGNAL);
+		if (ret == -1) {
+			if (errno == EINTR) {
+				continue;
+			} else if (errno == EAGAIN) {
+				// The rest waits for POLLOUT
+				break;
+			}
+			return false;
+		}
+		sent += ret;
+	}
+
+	client->out_len -= sent;
+	memmove(client->out, client->out + sent, client->out_len);
+
+	return true;
+}
+
+// False when the client doesn't read its replies and the queue is full
+static bool client_send(struct client *client, const char *data, size_t len)
+{
+	if (len > sizeof(client->out) - client->out_len) {
+		return false;
+	}
+	memcpy(client->out + client->out_len, data, len);
+	client->out_len += len;
+
+	return client_flush(client);
+}
+
+// Message of any number of lines becomes one ERR line, its lines joined by "; "
+static bool client_send_error(struct client *client, const char *message, size_t len)
+{
+	while (len > 0 && message[len - 1] == '\n') {
+		len--;
+	}
+	if (len == 0) {
+		message = "Command failed";
+		len = strlen(message);
+	}
+
+	if (!client_send(client, "ERR ", 4)) {
+		return false;
+	}
+	while (true) {
+		const char *end = memchr(message, '\n', len);
+		size_t line = end ? (size_t) (end - message) : len;
+		if (!client_send(client, message, line)) {
+			return false;
+		} else if (!end) {
+			break;
+		} else if (!client_send(client, "; ", 2)) {
+			return false;
+		}
+		len -= line + 1;
+		message = end + 1;
+	}
+
+	return client_send(client, "\n", 1);
+}
+
+/*
+Splits line in place into NULL terminated argv. Returns number of arguments
+or -1 if there are too many of them.
+*/
+static int split_line(char *line, char **argv)
+{
+	int argc = 0;
+	char *saveptr;
+
+	for (char *arg = strtok_r(line, " \t\r", &saveptr); arg; arg = strtok_r(NULL, " \t\r", &saveptr)) {
+		if (argc == RAINBOWD_MAX_ARGS) {
+			return -1;
+		}
+		argv[argc++] = arg;
+	}
+	argv[argc] = NULL;
+
+	return argc;
+}
+
+static bool process_line(struct client *client, char *line)
+{
+	char *argv[RAINBOWD_MAX_ARGS + 1];
+	char *out_buff = NULL, *err_buff = NULL;
+	size_t out_len = 0, err_len = 0;
+	bool ok = false;
+
+	FILE *out = open_memstream(&out_buff, &out_len);
+	FILE *err = open_memstream(&err_buff, &err_len);
+	if (!out || !err) {
+		fprintf(stderr, "Memory allocation error\n");
+		exit(2);
+	}
+
+	if (split_line(line, argv) == -1) {
+		fprintf(err, "Too many arguments\n");
+	} else {
+		ok = rb_run(rb, argv, out, err) == 0;
+	}
+
+	fclose(out);
+	fclose(err);
+
+	bool sent = client_send(client, out_buff, out_len);
+	if (sent && ok) {
+		sent = client_send(client, "OK\n", 3);
+	} else if (sent) {
+		sent = client_send_error(client, err_buff, err_len);
+	}
+
+	free(out_buff);
+	free(err_buff);
+
+	return sent;
+}
+
+static void client_read(struct client *client)
+{
+	ssize_t ret = recv(client->fd, client->buff + client->len, sizeof(client->buff) - client->len, 0);
+	if (ret == -1 && (errno == EINTR || errno == EAGAIN)) {
+		return;
+	} else if (ret == 0) {
+		// The last command may come without newline, a full buffer ended the client already
+		if (client->len) {
+			client->buff[client->len] = '\0';
+			client->len = 0;
+			if (!process_line(client, client->buff)) {
+				client_close(client);
+				return;
+			}
+		}
+		// Replies to the last lines may still wait for the client
+		client->eof = true;
+		return;
+	} else if (ret == -1) {
+		client_close(client);
+		return;
+	}
+	client->len += ret;
+
+	char *line = client->buff;
+	char *end;
+	while ((end = memchr(line, '\n', client->len - (line - client->buff)))) {
+		*end = '\0';
+		if (!process_line(client, line)) {
+			client_close(client);
+			return;
+		}
+		line = end + 1;
+	}
+
+	client->len -= line - client->buff;
+	memmove(client->buff, line, client->len);
+
+	if (client->len == sizeof(client->buff)) {
+		if (client_send(client, "ERR Line is too long\n", 21)) {
+			client->eof = true;
+		} else {
+			client_close(client);
+		}
+	}
+}
+
+static void client_accept(int listen_fd)
+{
+	int fd = accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC | SOCK_NONBLOCK);
+	if (fd == -1) {
+		return;
+	}
+
+	for (size_t i = 0; i < RAINBOWD_MAX_CLIENTS; i++) {
+		if (clients[i].fd == -1) {
+			clients[i].fd = fd;
+			return;
+		}
+	}
+
+	// No free slot
+	close(fd);
+}
+
+int main(int argc, char **argv)
+{
+	const char *socket_path = RAINBOWD_SOCKET;
+	const char *backend_spec = "sysfs";
+	int c;
+
+	while ((c = getopt_long(argc, argv, "hs:b:", long_options, NULL)) != -1) {
+		switch (c) {
+			case 'h':
+				help();
+				return 0;
+			case 's':
+				socket_path = optarg;
+				break;
+			case 'b':
+				backend_spec = optarg;
+				break;
+			default:
+				help();
+				return 1;
+		}
+	}
+
+	rb = rb_open(backend_spec, RB_EFFECTS | RB_STATS);
+	if (!rb) {
+		fprintf(stderr, "Failed to initialize backend %s: %s\n", backend_spec, strerror(errno));
+		return errno == ENOMEM ? 2 : 3;
+	}
+
+	struct sigaction sa;
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = signal_handler;
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+	signal(SIGPIPE, SIG_IGN);
+
+	int listen_fd = listen_socket(socket_path);
+	if (listen_fd == -1) {
+		rb_close(rb);
+		return 1;
+	}
+
+	for (size_t i = 0; i < RAINBOWD_MAX_CLIENTS; i++) {
+		clients[i].fd = -1;
+	}
+
+	while (!terminate) {
+		pfds[0] = (struct pollfd) { .fd = listen_fd, .events = POLLIN };
+		for (size_t i = 0; i < RAINBOWD_MAX_CLIENTS; i++) {
+			// Negative fd is ignored by poll()
+			pfds[i + 1] = (struct pollfd) {
+				.fd = clients[i].fd,
+				.events = (clients[i].eof ? 0 : POLLIN) | (clients[i].out_len ? POLLOUT : 0)
+			};
+		}
+		// The timer is armed only while something is animated
+		pfds[RAINBOWD_MAX_CLIENTS + 1] = (struct pollfd) { .fd = rb_effects_fd(rb), .events = POLLIN };
+
+		if (poll(pfds, RAINBOWD_MAX_CLIENTS + 2, -1) == -1) {
+			if (errno == EINTR) {
+				continue;
+			}
+			fprintf(stderr, "Poll error: %s\n", strerror(errno));
+			break;
+		}
+
+		for (size_t i = 0; i < RAINBOWD_MAX_CLIENTS; i++) {
+			struct client *client = &clients[i];
+			short revents = pfds[i + 1].revents;
+			if (client->fd != -1 && (revents & POLLOUT) && !client_flush(client)) {
+				client_close(client);
+			}
+			if (client->fd != -1 && !client->eof && (revents & (POLLIN | POLLHUP | POLLERR))) {
+				client_read(client);
+			}
+			if (client->fd != -1 && ((client->eof && !client->out_len) || (revents & POLLERR))) {
+				client_close(client);
+			}
+		}
+
+		if (pfds[0].revents & POLLIN) {
+			client_accept(listen_fd);
+		}
+
+		if (pfds[RAINBOWD_MAX_CLIENTS + 1].revents & POLLIN) {
+			if (rb_effects_tick(rb) == -1) {
+				fprintf(stderr, "Backend error: %s\n", strerror(errno));
+			}
+		}
+	}
+
+	for (size_t i = 0; i < RAINBOWD_MAX_CLIENTS; i++) {
+		if (clients[i].fd != -1) {
+			client_close(&clients[i]);
+		}
+	}
+	close(listen_fd);
+	unlink(socket_path);
+	rb_close(rb);
+
+	return 0;
+}
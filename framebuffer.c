@@ -0,0 +1,273 @@
+/*
+ * Rainbow is a tool for changing color and status of the LEDs of the Turris router
+ *
+ * Copyright (C) 2016 CZ.NIC, z.s.p.o. (http://www.nic.cz/)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <sched.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include "configuration.h"
+#include "arg_parser.h"
+#include "backend.h"
+#include "plan.h"
+#include "command.h"
+#include "framebuffer.h"
+
+#define FB_MAGIC 0x32424652 // "RFB2"
+
+static long futex(uint32_t *addr, int op, uint32_t val, const struct timespec *timeout)
+{
+	return syscall(SYS_futex, addr, op, val, timeout, NULL, 0);
+}
+
+// Producers mark the lock by pid, getpid() is a syscall so it is asked once per process
+static uint32_t self_pid;
+static pthread_once_t fork_once = PTHREAD_ONCE_INIT;
+
+static void forget_pid(void)
+{
+	self_pid = 0;
+}
+
+static void forget_pid_on_fork(void)
+{
+	pthread_atfork(NULL, NULL, forget_pid);
+}
+
+static uint32_t fb_pid(void)
+{
+	if (!self_pid) {
+		self_pid = getpid();
+	}
+	return self_pid;
+}
+
+struct framebuffer *fb_open()
+{
+	pthread_once(&fork_once, forget_pid_on_fork);
+
+	int fd = open(FRAMEBUFFER_FILE, O_RDWR | O_CREAT | O_CLOEXEC, 0660);
+	if (fd == -1) {
+		return NULL;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) == -1 || (st.st_size < (off_t) sizeof(struct framebuffer) &&
+		ftruncate(fd, sizeof(struct framebuffer)) == -1)) {
+		close(fd);
+		return NULL;
+	}
+
+	struct framebuffer *fb = mmap(NULL, sizeof(*fb), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (fb == MAP_FAILED) {
+		return NULL;
+	}
+
+	// Zeroed memory of a new file is an empty framebuffer
+	uint32_t magic = 0;
+	if (!__atomic_compare_exchange_n(&fb->magic, &magic, FB_MAGIC, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST) &&
+		magic != FB_MAGIC) {
+		munmap(fb, sizeof(*fb));
+		errno = EINVAL;
+		return NULL;
+	}
+
+	return fb;
+}
+
+void fb_close(struct framebuffer *fb)
+{
+	if (fb) {
+		munmap(fb, sizeof(*fb));
+	}
+}
+
+// The process is gone, its pid is free (EPERM means it lives under another user)
+static bool owner_gone(uint32_t owner)
+{
+	return owner && kill(owner, 0) == -1 && errno == ESRCH;
+}
+
+// Takes the lock when it is free or its owner is gone
+static bool fb_try_lock(struct framebuffer *fb, uint32_t pid)
+{
+	uint32_t owner = 0;
+	if (__atomic_compare_exchange_n(&fb->owner, &owner, pid, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+		return true;
+	}
+
+	return owner_gone(owner) &&
+		__atomic_compare_exchange_n(&fb->owner, &owner, pid, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+}
+
+void fb_begin(struct framebuffer *fb)
+{
+	while (!fb_try_lock(fb, fb_pid())) {
+		// Another producer holds it, let it finish
+		sched_yield();
+	}
+
+	// A producer that died holding the lock may have left seq odd, its change is kept
+	if (!(__atomic_load_n(&fb->seq, __ATOMIC_RELAXED) & 1)) {
+		__atomic_add_fetch(&fb->seq, 1, __ATOMIC_SEQ_CST);
+	}
+}
+
+void fb_end(struct framebuffer *fb)
+{
+	__atomic_add_fetch(&fb->seq, 1, __ATOMIC_SEQ_CST);
+	__atomic_store_n(&fb->owner, 0, __ATOMIC_RELEASE);
+	// Only the first change since the flusher parked wakes it, the others find the flag taken
+	if (__atomic_load_n(&fb->waiters, __ATOMIC_SEQ_CST) && __atomic_exchange_n(&fb->waiters, 0, __ATOMIC_SEQ_CST)) {
+		futex(&fb->seq, FUTEX_WAKE, INT32_MAX, NULL);
+	}
+}
+
+void fb_set_color(struct framebuffer *fb, enum cmd cmd, unsigned int color)
+{
+	unsigned int mask = cmd_mask(cmd);
+
+	for (size_t i = 0; i < LED_COUNT; i++) {
+		if (mask & LED_BIT(i)) {
+			__atomic_store_n(&fb->color[i], color, __ATOMIC_RELAXED);
+			__atomic_or_fetch(&fb->dirty, FB_DIRTY_COLOR(i), __ATOMIC_RELAXED);
+		}
+	}
+}
+
+void fb_set_status(struct framebuffer *fb, enum cmd cmd, enum status status)
+{
+	unsigned int mask = cmd_mask(cmd);
+
+	for (size_t i = 0; i < LED_COUNT; i++) {
+		if (mask & LED_BIT(i)) {
+			__atomic_store_n(&fb->status[i], status, __ATOMIC_RELAXED);
+			__atomic_or_fetch(&fb->dirty, FB_DIRTY_STATUS(i), __ATOMIC_RELAXED);
+		}
+	}
+}
+
+void fb_set_intensity(struct framebuffer *fb, unsigned int level)
+{
+	__atomic_store_n(&fb->intensity, level, __ATOMIC_RELAXED);
+	__atomic_or_fetch(&fb->dirty, FB_DIRTY_INTENSITY, __ATOMIC_RELAXED);
+}
+
+/*
+Takes the dirty entries and reads a consistent copy of them into plan.
+Returns seq the copy corresponds to.
+*/
+static uint32_t fb_snapshot(struct framebuffer *fb, struct led_state *plan)
+{
+	uint32_t dirty = __atomic_exchange_n(&fb->dirty, 0, __ATOMIC_ACQUIRE);
+	uint32_t seq;
+
+	while (true) {
+		seq = __atomic_load_n(&fb->seq, __ATOMIC_ACQUIRE);
+		if (seq & 1) {
+			// A producer is in the middle of a change, or died in it and never ends it
+			if (owner_gone(__atomic_load_n(&fb->owner, __ATOMIC_RELAXED))) {
+				fb_begin(fb);
+				fb_end(fb);
+			} else {
+				sched_yield();
+			}
+			continue;
+		}
+
+		// Producers may have added more changes, they are consistent with this copy
+		dirty |= __atomic_exchange_n(&fb->dirty, 0, __ATOMIC_ACQUIRE);
+		state_clear(plan);
+		for (size_t i = 0; i < LED_COUNT; i++) {
+			if (dirty & FB_DIRTY_COLOR(i)) {
+				plan_set_color(plan, i, __atomic_load_n(&fb->color[i], __ATOMIC_RELAXED));
+			}
+			if (dirty & FB_DIRTY_STATUS(i)) {
+				uint8_t status = __atomic_load_n(&fb->status[i], __ATOMIC_RELAXED);
+				if (status <= ST_AUTO) {
+					plan_set_status(plan, i, status);
+				}
+			}
+		}
+		if (dirty & FB_DIRTY_INTENSITY) {
+			uint8_t level = __atomic_load_n(&fb->intensity, __ATOMIC_RELAXED);
+			if (level <= MAX_INTENSITY_LEVEL) {
+				plan_set_intensity(plan, level);
+			}
+		}
+
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&fb->seq, __ATOMIC_RELAXED) == seq) {
+			return seq;
+		}
+	}
+}
+
+enum run_result run_flush(struct backend *backend, struct led_state *current, volatile sig_atomic_t *terminate)
+{
+	struct framebuffer *fb = fb_open();
+	if (!fb) {
+		fprintf(stderr, "Failed to open framebuffer " FRAMEBUFFER_FILE ": %s\n", strerror(errno));
+		return RUN_ERR_BACKEND;
+	}
+
+	uint32_t seen = __atomic_load_n(&fb->seq, __ATOMIC_SEQ_CST) - 2;
+	enum run_result ret = RUN_OK;
+	const struct timespec timeout = {
+		.tv_sec = FRAMEBUFFER_WAIT / 1000,
+		.tv_nsec = FRAMEBUFFER_WAIT % 1000 * 1000000L
+	};
+
+	while (!*terminate) {
+		uint32_t seq = __atomic_load_n(&fb->seq, __ATOMIC_SEQ_CST);
+		if (seq == seen) {
+			__atomic_store_n(&fb->waiters, 1, __ATOMIC_SEQ_CST);
+			// A change ending before the flag was set didn't wake, it is seen here
+			if (*terminate || __atomic_load_n(&fb->seq, __ATOMIC_SEQ_CST) != seq) {
+				continue;
+			}
+			// Returns at once if seq changed meanwhile, the timeout catches a signal that came just before
+			futex(&fb->seq, FUTEX_WAIT, seq, &timeout);
+			continue;
+		}
+
+		struct led_state plan;
+		seen = fb_snapshot(fb, &plan);
+		if (plan_apply(&plan, current, backend) == -1) {
+			fprintf(stderr, "Backend error: %s\n", strerror(errno));
+			ret = RUN_ERR_BACKEND;
+			break;
+		}
+	}
+
+	fb_close(fb);
+	return ret;
+}
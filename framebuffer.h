@@ -0,0 +1,73 @@
+/*
+ * Rainbow is a tool for changing color and status of the LEDs of the Turris router
+ *
+ * Copyright (C) 2016 CZ.NIC, z.s.p.o. (http://www.nic.cz/)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef FRAMEBUFFER_H
+#define FRAMEBUFFER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <signal.h>
+
+#include "configuration.h"
+#include "arg_parser.h"
+#include "backend.h"
+#include "plan.h"
+#include "command.h"
+
+#define FB_DIRTY_COLOR(led) (1U << (led))
+#define FB_DIRTY_STATUS(led) (1U << (16 + (led)))
+#define FB_DIRTY_INTENSITY (1U << 31)
+
+/*
+LED framebuffer shared by processes in FRAMEBUFFER_FILE. Producers change it
+with plain stores between fb_begin() and fb_end(), seq is odd meanwhile.
+Owner is the pid of the producer holding the lock that serializes them, the
+lock is taken over when that process is gone. Dirty marks what changed since
+the flusher last took it. The flusher sleeps on a futex on seq after setting
+waiters, the first fb_end() to clear that flag wakes it. Producers make no
+syscalls otherwise.
+*/
+struct framebuffer {
+	uint32_t magic;
+	uint32_t seq;
+	uint32_t owner;
+	uint32_t waiters;
+	uint32_t dirty;
+	uint32_t color[LED_COUNT];
+	uint8_t status[LED_COUNT];
+	uint8_t intensity;
+};
+
+struct framebuffer *fb_open();
+void fb_close(struct framebuffer *fb);
+
+void fb_begin(struct framebuffer *fb);
+// Devices and groups (cmd_mask()) are accepted
+void fb_set_color(struct framebuffer *fb, enum cmd cmd, unsigned int color);
+void fb_set_status(struct framebuffer *fb, enum cmd cmd, enum status status);
+void fb_set_intensity(struct framebuffer *fb, unsigned int level);
+void fb_end(struct framebuffer *fb);
+
+/*
+Applies changes from the framebuffer to backend until terminate is set
+(by a signal interrupting the wait).
+*/
+enum run_result run_flush(struct backend *backend, struct led_state *current, volatile sig_atomic_t *terminate);
+
+#endif //FRAMEBUFFER_H
@@ -0,0 +1,152 @@
+/*
+ * Rainbow is a tool for changing color and status of the LEDs of the Turris router
+ *
+ * Copyright (C) 2016 CZ.NIC, z.s.p.o. (http://www.nic.cz/)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+
+#include "i2c_transport.h"
+
+struct dev_transport {
+	struct i2c_transport transport;
+	int fd;
+};
+
+static int dev_transfer(struct i2c_transport *transport, struct i2c_msg *msgs, unsigned int count)
+{
+	struct dev_transport *dev = (struct dev_transport *) transport;
+	struct i2c_rdwr_ioctl_data data = {
+		.msgs = msgs,
+		.nmsgs = count
+	};
+
+	int ret;
+	do {
+		ret = ioctl(dev->fd, I2C_RDWR, &data);
+	} while (ret == -1 && errno == EINTR);
+
+	return ret < 0 ? -1 : 0;
+}
+
+static void dev_destroy(struct i2c_transport *transport)
+{
+	struct dev_transport *dev = (struct dev_transport *) transport;
+	close(dev->fd);
+	free(dev);
+}
+
+struct i2c_transport *i2c_transport_dev(const char *adapter)
+{
+	struct dev_transport *dev = malloc(sizeof(*dev));
+	if (!dev) {
+		return NULL;
+	}
+
+	dev->fd = open(adapter, O_RDWR | O_CLOEXEC);
+	if (dev->fd == -1) {
+		free(dev);
+		return NULL;
+	}
+	dev->transport.hardware = true;
+	dev->transport.transfer = dev_transfer;
+	dev->transport.destroy = dev_destroy;
+
+	return &dev->transport;
+}
+
+// Commands of the MCU this stand-in needs to understand
+#define CMD_LED_SET_BRIGHTNESS 0x07
+#define CMD_LED_GET_BRIGHTNESS 0x08
+
+struct record_transport {
+	struct i2c_transport transport;
+	FILE *file;
+	unsigned char brightness;
+};
+
+static int record_transfer(struct i2c_transport *transport, struct i2c_msg *msgs, unsigned int count)
+{
+	struct record_transport *record = (struct record_transport *) transport;
+	unsigned char last_cmd = 0;
+
+	for (unsigned int i = 0; i < count; i++) {
+		if (msgs[i].flags & I2C_M_RD) {
+			fprintf(record->file, "%s%02x:r%u", i ? " | " : "", msgs[i].addr, msgs[i].len);
+			memset(msgs[i].buf, 0, msgs[i].len);
+			if (last_cmd == CMD_LED_GET_BRIGHTNESS && msgs[i].len > 0) {
+				msgs[i].buf[0] = record->brightness;
+			}
+			continue;
+		}
+
+		fprintf(record->file, "%s%02x:", i ? " | " : "", msgs[i].addr);
+		for (unsigned int j = 0; j < msgs[i].len; j++) {
+			fprintf(record->file, " %02x", msgs[i].buf[j]);
+		}
+		if (msgs[i].len > 0) {
+			last_cmd = msgs[i].buf[0];
+		}
+		if (msgs[i].len == 2 && last_cmd == CMD_LED_SET_BRIGHTNESS) {
+			record->brightness = msgs[i].buf[1];
+		}
+	}
+	fprintf(record->file, "\n");
+	fflush(record->file);
+
+	return 0;
+}
+
+static void record_destroy(struct i2c_transport *transport)
+{
+	struct record_transport *record = (struct record_transport *) transport;
+	if (record->file != stdout) {
+		fclose(record->file);
+	}
+	free(record);
+}
+
+struct i2c_transport *i2c_transport_record(const char *path)
+{
+	struct record_transport *record = malloc(sizeof(*record));
+	if (!record) {
+		return NULL;
+	}
+
+	if (strcmp(path, "-") == 0) {
+		record->file = stdout;
+	} else {
+		record->file = fopen(path, "ae");
+		if (!record->file) {
+			free(record);
+			return NULL;
+		}
+	}
+	record->brightness = 100;
+	record->transport.hardware = false;
+	record->transport.transfer = record_transfer;
+	record->transport.destroy = record_destroy;
+
+	return &record->transport;
+}
@@ -0,0 +1,46 @@
+/*
+ * Rainbow is a tool for changing color and status of the LEDs of the Turris router
+ *
+ * Copyright (C) 2016 CZ.NIC, z.s.p.o. (http://www.nic.cz/)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef I2C_TRANSPORT_H
+#define I2C_TRANSPORT_H
+
+#include <stdbool.h>
+#include <linux/i2c.h>
+
+/*
+Transport of I2C transactions. Transfer sends all messages as one combined
+transaction and returns 0 on success or -1 with errno set. Hardware is set
+when the transport reaches the real bus.
+*/
+struct i2c_transport {
+	bool hardware;
+	int (*transfer)(struct i2c_transport *transport, struct i2c_msg *msgs, unsigned int count);
+	void (*destroy)(struct i2c_transport *transport);
+};
+
+// Real adapter (e.g. /dev/i2c-1) driven by I2C_RDWR ioctl
+struct i2c_transport *i2c_transport_dev(const char *adapter);
+/*
+Stand-in that appends every transaction as one line of hex bytes to path
+('-' is stdout) instead of touching the bus. Reads of the brightness return
+the last value set.
+*/
+struct i2c_transport *i2c_transport_record(const char *path);
+
+#endif //I2C_TRANSPORT_H
@@ -0,0 +1,36 @@
+/*
+ * Rainbow is a tool for changing color and status of the LEDs of the Turris router
+ *
+ * Copyright (C) 2016 CZ.NIC, z.s.p.o. (http://www.nic.cz/)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef KEYWORD_HASH_H
+#define KEYWORD_HASH_H
+
+#include <stddef.h>
+
+/*
+Hash of keywords, the multipliers are chosen by keywords_gen so that no two
+keywords share a slot. Word has to be at least one character long.
+*/
+static inline unsigned int keyword_hash(const char *word, size_t len,
+		unsigned int a, unsigned int b, unsigned int c, unsigned int mask)
+{
+	return ((unsigned char) word[0] * a + (unsigned char) word[1] * b +
+		(unsigned char) word[len - 1] * c + len) & mask;
+}
+
+#endif //KEYWORD_HASH_H
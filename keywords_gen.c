@@ -0,0 +1,161 @@
+/*
+ * Rainbow is a tool for changing color and status of the LEDs of the Turris router
+ *
+ * Copyright (C) 2016 CZ.NIC, z.s.p.o. (http://www.nic.cz/)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+Generates keywords.h, a perfect hash table of all keywords and color names.
+It is run at build time, so the lookup in arg_parser.c is one hash and one
+strcmp() and adding a keyword here needs no manual placing.
+*/
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "arg_parser.h"
+#include "keyword_hash.h"
+
+struct entry {
+	const char *name;
+	const char *type;
+	const char *value;
+};
+
+static const struct entry entries[] = {
+	{ KW_PWR, "TOK_CMD", "CMD_PWR" },
+	{ KW_LAN0, "TOK_CMD", "CMD_LAN0" },
+	{ KW_LAN1, "TOK_CMD", "CMD_LAN1" },
+	{ KW_LAN2, "TOK_CMD", "CMD_LAN2" },
+	{ KW_LAN3, "TOK_CMD", "CMD_LAN3" },
+	{ KW_LAN4, "TOK_CMD", "CMD_LAN4" },
+	{ KW_WAN, "TOK_CMD", "CMD_WAN" },
+	{ KW_PCI1, "TOK_CMD", "CMD_PCI1" },
+	{ KW_PCI2, "TOK_CMD", "CMD_PCI2" },
+	{ KW_PCI3, "TOK_CMD", "CMD_PCI3" },
+	{ KW_USR1, "TOK_CMD", "CMD_USR1" },
+	{ KW_USR2, "TOK_CMD", "CMD_USR2" },
+	{ KW_ALL, "TOK_CMD", "CMD_ALL" },
+	{ KW_LAN, "TOK_CMD", "CMD_LAN" },
+	{ KW_INTEN, "TOK_CMD", "CMD_INTEN" },
+	{ KW_BINMASK, "TOK_CMD", "CMD_BINMASK" },
+	{ KW_GET, "TOK_CMD", "CMD_GET" },
+	{ KW_ENABLE, "TOK_STATUS", "ST_ENABLE" },
+	{ KW_DISABLE, "TOK_STATUS", "ST_DISABLE" },
+	{ KW_AUTO, "TOK_STATUS", "ST_AUTO" },
+	{ KW_FADE, "TOK_EFFECT", "EFF_FADE" },
+	{ KW_PULSE, "TOK_EFFECT", "EFF_PULSE" },
+	{ KW_BREATHE, "TOK_EFFECT", "EFF_BREATHE" },
+	{ KW_CYCLE, "TOK_EFFECT", "EFF_CYCLE" },
+	{ KW_CHASE, "TOK_EFFECT", "EFF_CHASE" },
+	{ KW_STOP, "TOK_EFFECT", "EFF_STOP" },
+	{ "red", "TOK_COLOR", "0xFF0000" },
+	{ "green", "TOK_COLOR", "0x00FF00" },
+	{ "blue", "TOK_COLOR", "0x0000FF" },
+	{ "white", "TOK_COLOR", "0xFFFFFF" },
+	{ "black", "TOK_COLOR", "0x000000" },
+	{ "yellow", "TOK_COLOR", "0xFFFF00" },
+	{ "cyan", "TOK_COLOR", "0x00FFFF" },
+	{ "aqua", "TOK_COLOR", "0x00FFFF" },
+	{ "magenta", "TOK_COLOR", "0xFF00FF" },
+	{ "fuchsia", "TOK_COLOR", "0xFF00FF" },
+	{ "orange", "TOK_COLOR", "0xFFA500" },
+	{ "amber", "TOK_COLOR", "0xFFBF00" },
+	{ "gold", "TOK_COLOR", "0xFFD700" },
+	{ "purple", "TOK_COLOR", "0x800080" },
+	{ "violet", "TOK_COLOR", "0xEE82EE" },
+	{ "indigo", "TOK_COLOR", "0x4B0082" },
+	{ "pink", "TOK_COLOR", "0xFFC0CB" },
+	{ "crimson", "TOK_COLOR", "0xDC143C" },
+	{ "coral", "TOK_COLOR", "0xFF7F50" },
+	{ "salmon", "TOK_COLOR", "0xFA8072" },
+	{ "maroon", "TOK_COLOR", "0x800000" },
+	{ "brown", "TOK_COLOR", "0xA52A2A" },
+	{ "olive", "TOK_COLOR", "0x808000" },
+	{ "lime", "TOK_COLOR", "0x00FF00" },
+	{ "chartreuse", "TOK_COLOR", "0x7FFF00" },
+	{ "teal", "TOK_COLOR", "0x008080" },
+	{ "turquoise", "TOK_COLOR", "0x40E0D0" },
+	{ "sky", "TOK_COLOR", "0x87CEEB" },
+	{ "navy", "TOK_COLOR", "0x000080" },
+	{ "gray", "TOK_COLOR", "0x808080" },
+	{ "silver", "TOK_COLOR", "0xC0C0C0" },
+	{ "warmwhite", "TOK_COLOR", "0xFFD6AA" }
+};
+
+#define ENTRY_COUNT (sizeof(entries) / sizeof(*entries))
+#define MAX_SLOTS 4096
+#define MAX_MULTIPLIER 64
+
+static bool try_hash(unsigned int a, unsigned int b, unsigned int c, unsigned int slots, int *table)
+{
+	for (size_t i = 0; i < slots; i++) {
+		table[i] = -1;
+	}
+
+	for (size_t i = 0; i < ENTRY_COUNT; i++) {
+		unsigned int slot = keyword_hash(entries[i].name, strlen(entries[i].name), a, b, c, slots - 1);
+		if (table[slot] != -1) {
+			return false;
+		}
+		table[slot] = i;
+	}
+
+	return true;
+}
+
+int main()
+{
+	static int table[MAX_SLOTS];
+	size_t max_len = 0;
+
+	for (size_t i = 0; i < ENTRY_COUNT; i++) {
+		if (strlen(entries[i].name) > max_len) {
+			max_len = strlen(entries[i].name);
+		}
+	}
+
+	// Smallest table first so it takes few cache lines
+	for (unsigned int slots = 32; slots <= MAX_SLOTS; slots *= 2) {
+		for (unsigned int a = 1; a < MAX_MULTIPLIER; a++) {
+			for (unsigned int b = 0; b < MAX_MULTIPLIER; b++) {
+				for (unsigned int c = 0; c < MAX_MULTIPLIER; c++) {
+					if (!try_hash(a, b, c, slots, table)) {
+						continue;
+					}
+
+					printf("// Generated by keywords_gen, do not edit\n\n");
+					printf("#define KEYWORD_HASH(word, len) keyword_hash(word, len, %u, %u, %u, %u)\n",
+						a, b, c, slots - 1);
+					printf("#define KEYWORD_MAX_LEN %zu\n\n", max_len);
+					printf("static const struct keyword keywords[%u] = {\n", slots);
+					for (size_t i = 0; i < slots; i++) {
+						if (table[i] != -1) {
+							const struct entry *e = &entries[table[i]];
+							printf("\t[%zu] = { \"%s\", %s, %s },\n", i, e->name, e->type, e->value);
+						}
+					}
+					printf("};\n");
+					return 0;
+				}
+			}
+		}
+	}
+
+	fprintf(stderr, "No perfect hash found\n");
+	return 1;
+}
@@ -0,0 +1,348 @@
+/*
+ * Rainbow is a tool for changing color and status of the LEDs of the Turris router
+ *
+ * Copyright (C) 2016 CZ.NIC, z.s.p.o. (http://www.nic.cz/)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include "configuration.h"
+#include "arg_parser.h"
+#include "backend.h"
+#include "command.h"
+#include "plan.h"
+#include "state.h"
+#include "layer.h"
+
+#define LAYER_MAGIC 0x594C4252 // "RBLY"
+#define LAYER_VERSION 1
+// Channels are padded to a vector width, the padding lanes stay transparent
+#define LAYER_LANES 16
+#define LAYER_NO_STATUS 0xFF
+
+/*
+Channels of a layer are separate arrays (structure of arrays), so the blend
+loop works on whole rows of bytes and compilers turn it into vector code.
+Alpha 0 means the layer doesn't set color of that LED.
+*/
+struct layer {
+	char name[LAYER_NAME_MAX];
+	uint8_t priority;
+	uint8_t opacity;
+	uint8_t r[LAYER_LANES];
+	uint8_t g[LAYER_LANES];
+	uint8_t b[LAYER_LANES];
+	uint8_t a[LAYER_LANES];
+	uint8_t status[LAYER_LANES];
+} __attribute__((packed));
+
+// Layers are kept sorted from the lowest priority, equal ones by age
+struct layer_file {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t count;
+	struct layer layers[LAYER_MAX];
+} __attribute__((packed));
+
+struct frame {
+	uint8_t r[LAYER_LANES];
+	uint8_t g[LAYER_LANES];
+	uint8_t b[LAYER_LANES];
+	uint8_t a[LAYER_LANES];
+};
+
+static void stack_clear(struct layer_file *file)
+{
+	memset(file, 0, sizeof(*file));
+	file->magic = LAYER_MAGIC;
+	file->version = LAYER_VERSION;
+}
+
+static void stack_load(struct layer_file *file)
+{
+	int fd = open(LAYER_FILE, O_RDONLY | O_CLOEXEC);
+	if (fd != -1) {
+		ssize_t ret = read(fd, file, sizeof(*file));
+		close(fd);
+		if (ret == sizeof(*file) && file->magic == LAYER_MAGIC && file->version == LAYER_VERSION &&
+				file->count <= LAYER_MAX) {
+			return;
+		}
+	}
+
+	// Missing or foreign file is an empty stack
+	stack_clear(file);
+}
+
+static bool stack_save(const struct layer_file *file)
+{
+	char tmp_path[sizeof(LAYER_FILE ".tmp")];
+	sprintf(tmp_path, "%s.tmp", LAYER_FILE);
+
+	int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+	if (fd == -1) {
+		fprintf(stderr, "Failed to write layers %s: %s\n", LAYER_FILE, strerror(errno));
+		return false;
+	}
+	ssize_t ret = write(fd, file, sizeof(*file));
+	int err = errno;
+	close(fd);
+
+	if (ret != sizeof(*file) || rename(tmp_path, LAYER_FILE) == -1) {
+		if (ret == sizeof(*file)) {
+			err = errno;
+		}
+		unlink(tmp_path);
+		fprintf(stderr, "Failed to write layers %s: %s\n", LAYER_FILE, strerror(err));
+		return false;
+	}
+
+	return true;
+}
+
+static int stack_find(const struct layer_file *file, const char *name)
+{
+	for (size_t i = 0; i < file->count; i++) {
+		if (strncmp(file->layers[i].name, name, LAYER_NAME_MAX) == 0) {
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+static void stack_remove(struct layer_file *file, size_t index)
+{
+	memmove(&file->layers[index], &file->layers[index + 1], (file->count - index - 1) * sizeof(struct layer));
+	file->count--;
+}
+
+// x / 255 rounded, exact for every x up to 255 * 255
+static inline uint16_t div255(uint16_t x)
+{
+	x += 128;
+	return (x + (x >> 8)) >> 8;
+}
+
+/*
+Puts layer over frame. Only fixed width integer operations without branches,
+so every lane is independent and the loop vectorizes.
+*/
+static void blend(struct frame *frame, const struct layer *layer)
+{
+	for (size_t i = 0; i < LAYER_LANES; i++) {
+		uint16_t alpha = div255(layer->a[i] * layer->opacity);
+		uint16_t keep = 255 - alpha;
+		frame->r[i] = div255(frame->r[i] * keep + layer->r[i] * alpha);
+		frame->g[i] = div255(frame->g[i] * keep + layer->g[i] * alpha);
+		frame->b[i] = div255(frame->b[i] * keep + layer->b[i] * alpha);
+		frame->a[i] = frame->a[i] + div255((255 - frame->a[i]) * alpha);
+	}
+}
+
+// Composes all layers and applies the result, the backend gets only what differs from current
+static enum run_result compose(const struct layer_file *file, struct backend *backend, struct led_state *current)
+{
+	struct frame frame;
+	struct led_state plan;
+	memset(&frame, 0, sizeof(frame));
+	state_clear(&plan);
+
+	for (size_t i = 0; i < file->count; i++) {
+		const struct layer *layer = &file->layers[i];
+		blend(&frame, layer);
+		for (size_t j = 0; j < LED_COUNT; j++) {
+			if (layer->status[j] != LAYER_NO_STATUS) {
+				plan_set_status(&plan, j, layer->status[j]);
+			}
+		}
+	}
+
+	for (size_t i = 0; i < LED_COUNT; i++) {
+		if (frame.a[i]) {
+			plan_set_color(&plan, i, frame.r[i] << 16 | frame.g[i] << 8 | frame.b[i]);
+		}
+	}
+
+	if (plan_apply(&plan, current, backend) == -1) {
+		fprintf(stderr, "Backend error: %s\n", strerror(errno));
+		return RUN_ERR_BACKEND;
+	}
+
+	return RUN_OK;
+}
+
+static bool parse_number(const char *raw, unsigned int max, unsigned int *value)
+{
+	char *end;
+	unsigned long ret = strtoul(raw, &end, 0);
+	if (end == raw || *end != '\0' || ret > max) {
+		return false;
+	}
+	*value = ret;
+	return true;
+}
+
+// Compiles args like scene_compile() does and stores them to layer
+static enum run_result layer_compile(char **args, struct layer *layer)
+{
+	struct led_state state;
+	struct backend *backend = backend_null_init();
+	struct tokenizer *tokenizer = tokenizer_init(args, 0);
+	if (!backend || !tokenizer) {
+		backend_destroy(backend);
+		if (tokenizer) {
+			tokenizer_destroy(tokenizer);
+		}
+		fprintf(stderr, "Memory allocation error\n");
+		return RUN_ERR_MEMORY;
+	}
+
+	state_clear(&state);
+	enum run_result ret = run_command(tokenizer, backend, &state, NULL, stdout, stderr);
+	tokenizer_destroy(tokenizer);
+	backend_destroy(backend);
+	if (ret != RUN_OK) {
+		return ret;
+	}
+	if (state.intensity_valid) {
+		fprintf(stderr, "Intensity can't be part of a layer\n");
+		return RUN_ERR_USAGE;
+	}
+	// Lanes keep only the status itself, not the parameters of triggers
+	for (size_t i = 0; i < LED_COUNT; i++) {
+		if ((state.status_mask & LED_BIT(i)) && STATUS_TRIGGER(state.status[i])) {
+			fprintf(stderr, "Kernel triggers can't be part of a layer\n");
+			return RUN_ERR_USAGE;
+		}
+	}
+
+	memset(layer->r, 0, sizeof(layer->r));
+	memset(layer->g, 0, sizeof(layer->g));
+	memset(layer->b, 0, sizeof(layer->b));
+	memset(layer->a, 0, sizeof(layer->a));
+	memset(layer->status, LAYER_NO_STATUS, sizeof(layer->status));
+	for (size_t i = 0; i < LED_COUNT; i++) {
+		if (state.color_mask & LED_BIT(i)) {
+			layer->r[i] = state.color[i] >> 16;
+			layer->g[i] = state.color[i] >> 8;
+			layer->b[i] = state.color[i];
+			layer->a[i] = 255;
+		}
+		if (state.status_mask & LED_BIT(i)) {
+			layer->status[i] = state.status[i];
+		}
+	}
+
+	return RUN_OK;
+}
+
+enum run_result layer_set(const char *name, char **args, struct backend *backend, struct led_state *current)
+{
+	struct layer layer;
+	unsigned int priority, opacity = 100;
+
+	if (strlen(name) >= LAYER_NAME_MAX) {
+		fprintf(stderr, "Layer name %s is too long\n", name);
+		return RUN_ERR_USAGE;
+	}
+	if (!args[0] || !parse_number(args[0], 255, &priority)) {
+		fprintf(stderr, "Specify priority of layer %s (0-255)\n", name);
+		return RUN_ERR_USAGE;
+	}
+	args++;
+	if (args[0] && parse_number(args[0], 100, &opacity)) {
+		args++;
+	}
+
+	memset(&layer, 0, sizeof(layer));
+	strncpy(layer.name, name, LAYER_NAME_MAX);
+	layer.priority = priority;
+	layer.opacity = opacity * 255 / 100;
+	enum run_result ret = layer_compile(args, &layer);
+	if (ret != RUN_OK) {
+		return ret;
+	}
+
+	struct layer_file file;
+	int lock = state_lock(LAYER_FILE);
+	stack_load(&file);
+
+	int index = stack_find(&file, name);
+	if (index != -1) {
+		stack_remove(&file, index);
+	} else if (file.count == LAYER_MAX) {
+		state_unlock(lock);
+		fprintf(stderr, "There are already %d layers\n", LAYER_MAX);
+		return RUN_ERR_USAGE;
+	}
+
+	// Above every layer of the same priority
+	size_t pos = file.count;
+	while (pos > 0 && file.layers[pos - 1].priority > layer.priority) {
+		pos--;
+	}
+	memmove(&file.layers[pos + 1], &file.layers[pos], (file.count - pos) * sizeof(struct layer));
+	file.layers[pos] = layer;
+	file.count++;
+
+	ret = stack_save(&file) ? compose(&file, backend, current) : RUN_ERR_BACKEND;
+	state_unlock(lock);
+
+	return ret;
+}
+
+enum run_result layer_drop(const char *name, struct backend *backend, struct led_state *current)
+{
+	struct layer_file file;
+	int lock = state_lock(LAYER_FILE);
+	stack_load(&file);
+
+	int index = stack_find(&file, name);
+	if (index == -1) {
+		state_unlock(lock);
+		fprintf(stderr, "There is no layer %s\n", name);
+		return RUN_ERR_USAGE;
+	}
+	stack_remove(&file, index);
+
+	enum run_result ret = stack_save(&file) ? compose(&file, backend, current) : RUN_ERR_BACKEND;
+	state_unlock(lock);
+
+	return ret;
+}
+
+enum run_result layer_list(FILE *out)
+{
+	// The file is replaced by rename, so it is read without the lock
+	struct layer_file file;
+	stack_load(&file);
+
+	for (size_t i = file.count; i > 0; i--) {
+		const struct layer *layer = &file.layers[i - 1];
+		fprintf(out, "%.*s %u %u\n", LAYER_NAME_MAX, layer->name, layer->priority,
+			(layer->opacity * 100 + 127) / 255);
+	}
+
+	return RUN_OK;
+}
@@ -0,0 +1,47 @@
+/*
+ * Rainbow is a tool for changing color and status of the LEDs of the Turris router
+ *
+ * Copyright (C) 2016 CZ.NIC, z.s.p.o. (http://www.nic.cz/)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef LAYER_H
+#define LAYER_H
+
+#include "backend.h"
+#include "command.h"
+#include "plan.h"
+
+/*
+Layers let more owners (a baseline scene, status and alert overlays, user
+settings) share the LEDs without overwriting each other. Every layer keeps
+its own colors and statuses in LAYER_FILE and the LEDs always show all of
+them composed: layers are blended by priority from the lowest one up, each
+scaled by its opacity, and status of an LED is taken from the highest layer
+that sets it. LEDs no layer sets are left alone.
+*/
+
+/*
+Sets layer name to what args (DEV_CONFIGURATION ...) describe, replacing
+its previous content, and applies the composition. Args start with
+PRIORITY (0-255, higher is on top) and optional OPACITY (0-100 percent).
+*/
+enum run_result layer_set(const char *name, char **args, struct backend *backend, struct led_state *current);
+// Removes layer name and applies composition of the rest
+enum run_result layer_drop(const char *name, struct backend *backend, struct led_state *current);
+// Prints NAME PRIORITY OPACITY of every layer from the top one
+enum run_result layer_list(FILE *out);
+
+#endif //LAYER_H
@@ -0,0 +1,224 @@
+/*
+ * Rainbow is a tool for changing color and status of the LEDs of the Turris router
+ *
+ * Copyright (C) 2016 CZ.NIC, z.s.p.o. (http://www.nic.cz/)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#define _GNU_SOURCE
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <dirent.h>
+
+#include "configuration.h"
+#include "arg_parser.h"
+#include "led_table.h"
+
+#define LED_TABLE_MAGIC 0x314C4252 // "RBL1"
+
+struct led_table_file {
+	uint32_t magic;
+	struct led_table table;
+} __attribute__((packed));
+
+/*
+Functions of LEDs as named by the old driver (omnia-led:power) and by the
+multicolor one (rgb:power, rgb:lan-0, rgb:wlan-1, rgb:indicator-1).
+*/
+static const char *functions[CMD_ALL + 1][2] = {
+	[CMD_PWR] = { "power", NULL },
+	[CMD_LAN0] = { "lan0", "lan-0" },
+	[CMD_LAN1] = { "lan1", "lan-1" },
+	[CMD_LAN2] = { "lan2", "lan-2" },
+	[CMD_LAN3] = { "lan3", "lan-3" },
+	[CMD_LAN4] = { "lan4", "lan-4" },
+	[CMD_WAN] = { "wan", NULL },
+	[CMD_PCI1] = { "pci1", "wlan-1" },
+	[CMD_PCI2] = { "pci2", "wlan-2" },
+	[CMD_PCI3] = { "pci3", "wlan-3" },
+	[CMD_USR1] = { "user1", "indicator-1" },
+	[CMD_USR2] = { "user2", "indicator-2" },
+	[CMD_ALL] = { "all", NULL }
+};
+
+// Global brightness lives in the controller device, the parent of the LEDs
+static const char *global_paths[] = {
+	"device/global_brightness",
+	"device/brightness",
+	"../../global_brightness"
+};
+
+static int match_function(const char *entry)
+{
+	const char *colon = strchr(entry, ':');
+	if (!colon) {
+		return -1;
+	}
+	size_t prefix = colon - entry;
+	if (!(prefix == strlen("omnia-led") && strncmp(entry, "omnia-led", prefix) == 0) &&
+		!(prefix == strlen("rgb") && strncmp(entry, "rgb", prefix) == 0)) {
+		return -1;
+	}
+
+	for (int i = 0; i <= CMD_ALL; i++) {
+		for (size_t j = 0; j < 2; j++) {
+			if (functions[i][j] && strcmp(colon + 1, functions[i][j]) == 0) {
+				return i;
+			}
+		}
+	}
+
+	return -1;
+}
+
+static bool has_attr(int dir_fd, const char *entry, const char *attr)
+{
+	char path[LED_NAME_MAX + 32];
+	snprintf(path, sizeof(path), "%s/%s", entry, attr);
+	return faccessat(dir_fd, path, F_OK, 0) == 0;
+}
+
+bool led_table_scan(int dir_fd, struct led_table *table)
+{
+	memset(table, 0, sizeof(*table));
+
+	// fdopendir() takes the descriptor, keep the caller's one open
+	int fd = openat(dir_fd, ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (fd == -1) {
+		return false;
+	}
+	DIR *dir = fdopendir(fd);
+	if (!dir) {
+		close(fd);
+		return false;
+	}
+
+	bool found = false;
+	struct dirent *entry;
+	while ((entry = readdir(dir))) {
+		int cmd = match_function(entry->d_name);
+		if (cmd == -1 || strlen(entry->d_name) >= LED_NAME_MAX) {
+			continue;
+		}
+
+		strcpy(table->name[cmd], entry->d_name);
+		table->flags[cmd] = 0;
+		if (has_attr(dir_fd, entry->d_name, "multi_intensity")) {
+			table->flags[cmd] |= LED_MULTICOLOR;
+		}
+		if (!has_attr(dir_fd, entry->d_name, "autonomous")) {
+			table->flags[cmd] |= LED_TRIGGER;
+		}
+		if (!has_attr(dir_fd, entry->d_name, "trigger")) {
+			table->flags[cmd] |= LED_NO_TRIGGERS;
+		}
+		found = true;
+
+		for (size_t i = 0; i < sizeof(global_paths) / sizeof(*global_paths) && !table->global[0]; i++) {
+			if (has_attr(dir_fd, entry->d_name, global_paths[i])) {
+				snprintf(table->global, sizeof(table->global), "%s/%s", table->name[cmd], global_paths[i]);
+			}
+		}
+	}
+	closedir(dir);
+
+	return found;
+}
+
+bool led_table_load(const char *path, struct led_table *table)
+{
+	struct led_table_file file;
+
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd == -1) {
+		return false;
+	}
+	ssize_t ret = read(fd, &file, sizeof(file));
+	close(fd);
+
+	if (ret != sizeof(file) || file.magic != LED_TABLE_MAGIC) {
+		return false;
+	}
+
+	*table = file.table;
+	// Never trust strings from a file to be terminated
+	for (size_t i = 0; i <= CMD_ALL; i++) {
+		table->name[i][LED_NAME_MAX - 1] = '\0';
+	}
+	table->global[LED_GLOBAL_MAX - 1] = '\0';
+
+	return true;
+}
+
+bool led_table_save(const char *path, const struct led_table *table)
+{
+	struct led_table_file file = {
+		.magic = LED_TABLE_MAGIC,
+		.table = *table
+	};
+
+	char tmp_path[strlen(path) + sizeof(".tmp")];
+	sprintf(tmp_path, "%s.tmp", path);
+
+	int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd == -1) {
+		return false;
+	}
+	ssize_t ret = write(fd, &file, sizeof(file));
+	close(fd);
+
+	if (ret != sizeof(file) || rename(tmp_path, path) == -1) {
+		unlink(tmp_path);
+		return false;
+	}
+
+	return true;
+}
+
+const char *led_trigger_name(enum status status)
+{
+	switch (status) {
+	case ST_NETDEV:
+		return "netdev";
+	case ST_TIMER:
+		return "timer";
+	case ST_ACTIVITY:
+		return "activity";
+	case ST_DISK:
+		return "disk-activity";
+	case ST_PATTERN:
+		return "pattern";
+	default:
+		return NULL;
+	}
+}
+
+bool led_trigger_status(const char *name, enum status *status)
+{
+	for (enum status i = ST_NETDEV; i <= ST_PATTERN; i++) {
+		if (strcmp(led_trigger_name(i), name) == 0) {
+			*status = i;
+			return true;
+		}
+	}
+
+	return false;
+}
@@ -0,0 +1,66 @@
+/*
+ * Rainbow is a tool for changing color and status of the LEDs of the Turris router
+ *
+ * Copyright (C) 2016 CZ.NIC, z.s.p.o. (http://www.nic.cz/)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef LED_TABLE_H
+#define LED_TABLE_H
+
+#include <stdbool.h>
+
+#include "arg_parser.h"
+
+#define LED_NAME_MAX 32
+#define LED_GLOBAL_MAX 96
+
+// Color is written to multi_intensity (multicolor LED class) instead of color
+#define LED_MULTICOLOR 0x1
+// Automatic mode is the omnia-mcu trigger instead of autonomous attribute
+#define LED_TRIGGER 0x2
+// Kernel without LED triggers, there is nothing to remove
+#define LED_NO_TRIGGERS 0x4
+
+/*
+Where the LEDs are in a directory of LED class devices (/sys/class/leds or
+leds of a fake tree). Names are entries of that directory indexed by enum cmd,
+an empty name is a missing LED. Global brightness is a path relative to the
+directory too, so every file can be opened by openat() on one directory fd.
+*/
+struct led_table {
+	char name[CMD_ALL + 1][LED_NAME_MAX];
+	unsigned char flags[CMD_ALL + 1];
+	char global[LED_GLOBAL_MAX];
+};
+
+/*
+Scans the directory for LEDs of both the old omnia-led:NAME and the newer
+rgb:FUNCTION naming. Returns false when no LED was found.
+*/
+bool led_table_scan(int dir_fd, struct led_table *table);
+/*
+Discovery results are cached in LED_TABLE_FILE. /run is emptied on boot, so
+the cache never outlives the kernel it was made for.
+*/
+bool led_table_load(const char *path, struct led_table *table);
+bool led_table_save(const char *path, const struct led_table *table);
+
+// Name of the kernel LED trigger of a trigger status, NULL for the others
+const char *led_trigger_name(enum status status);
+// Trigger status of a kernel LED trigger, false when there is none
+bool led_trigger_status(const char *name, enum status *status);
+
+#endif //LED_TABLE_H
@@ -0,0 +1,522 @@
+/*
+ * Rainbow is a tool for changing color and status of the LEDs of the Turris router
+ *
+ * Copyright (C) 2016 CZ.NIC, z.s.p.o. (http://www.nic.cz/)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+
+#include "configuration.h"
+#include "arg_parser.h"
+#include "backend.h"
+#include "command.h"
+#include "plan.h"
+#include "state.h"
+#include "animation.h"
+#include "snapshot.h"
+#include "scene.h"
+#include "layer.h"
+#include "stream.h"
+#include "framebuffer.h"
+#include "link.h"
+#include "metric.h"
+#include "script.h"
+#include "librainbow_private.h"
+
+#if RB_LED_COUNT != LED_COUNT
+#error "RB_LED_COUNT has to match LED_COUNT"
+#endif
+
+// Public enums are the internal ones under other names, they are only cast
+typedef char rb_enums_match[(int) RB_LED_ALL == CMD_ALL && (int) RB_LED_LAN == CMD_LAN &&
+	(int) RB_LED_USR2 == CMD_USR2 && (int) RB_ST_AUTO == ST_AUTO && (int) RB_ST_NETDEV == ST_NETDEV &&
+	(int) RB_ST_PATTERN == ST_PATTERN ? 1 : -1];
+
+/*
+Shadow is set when the stored state belongs to the backend (it drives the
+real LEDs and writes are not only planned). Backends without it keep the
+known state in current between transactions of the context.
+*/
+struct rainbow {
+	struct backend *backend;
+	struct animator *animator;
+	struct tokenizer *tokenizer;
+	unsigned int flags;
+	bool shadow;
+	int lock;
+	struct led_state plan;
+	struct led_state current;
+	struct led_state saved;
+};
+
+static char *empty_argv[] = { NULL };
+
+struct rainbow *rb_open(const char *backend, unsigned int flags)
+{
+	struct rainbow *rb = calloc(1, sizeof(*rb));
+	if (!rb) {
+		return NULL;
+	}
+
+	rb->flags = flags;
+	rb->lock = -1;
+	rb->backend = backend_create(flags & RB_DRY_RUN ? "plan" : backend ? backend : "sysfs");
+	rb->tokenizer = tokenizer_init(empty_argv, 0);
+	if (rb->backend && (flags & RB_EFFECTS)) {
+		rb->animator = animator_init(rb->backend);
+	}
+	if (!rb->backend || !rb->tokenizer || ((flags & RB_EFFECTS) && !rb->animator)) {
+		int err = errno;
+		rb_close(rb);
+		errno = err;
+		return NULL;
+	}
+	rb->shadow = rb->backend->hardware;
+	if (flags & RB_STATS) {
+		backend_keep_stats(rb->backend);
+	}
+
+	return rb;
+}
+
+void rb_close(struct rainbow *rb)
+{
+	if (!rb) {
+		return;
+	}
+
+	if (rb->animator) {
+		rb_effects_stop(rb);
+		animator_destroy(rb->animator);
+	}
+	if (rb->tokenizer) {
+		tokenizer_destroy(rb->tokenizer);
+	}
+	backend_destroy(rb->backend);
+	free(rb);
+}
+
+struct backend *rb_backend(struct rainbow *rb)
+{
+	return rb->backend;
+}
+
+struct led_state *rb_lock(struct rainbow *rb)
+{
+	rb->lock = rb->shadow ? state_lock(STATE_FILE) : -1;
+	if (rb->flags & RB_FORCE) {
+		state_clear(&rb->current);
+	} else if (rb->shadow || (rb->flags & RB_DRY_RUN)) {
+		state_load(STATE_FILE, &rb->current);
+	}
+	rb->saved = rb->current;
+
+	return &rb->current;
+}
+
+void rb_unlock(struct rainbow *rb)
+{
+	// Record what was written even when some later change failed
+	if (rb->lock != -1 && !state_equal(&rb->saved, &rb->current)) {
+		state_save(STATE_FILE, &rb->current);
+	}
+	state_unlock(rb->lock);
+	rb->lock = -1;
+}
+
+void rb_begin(struct rainbow *rb)
+{
+	state_clear(&rb->plan);
+}
+
+int rb_set_color(struct rainbow *rb, enum rb_led led, unsigned int color)
+{
+	enum cmd cmd = (enum cmd) led;
+	unsigned int mask = cmd_mask(cmd);
+	if (!mask || color > 0xFFFFFF) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	for (size_t i = 0; i < LED_COUNT; i++) {
+		if (mask & LED_BIT(i)) {
+			plan_set_color(&rb->plan, i, color);
+		}
+	}
+	if (cmd == CMD_ALL || cmd == CMD_LAN) {
+		plan_mark_group(&rb->plan, mask, 0);
+	}
+
+	return 0;
+}
+
+int rb_set_status(struct rainbow *rb, enum rb_led led, enum rb_status status)
+{
+	enum cmd cmd = (enum cmd) led;
+	unsigned int mask = cmd_mask(cmd);
+	if (!mask || (status != RB_ST_DISABLE && status != RB_ST_ENABLE && status != RB_ST_AUTO)) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	for (size_t i = 0; i < LED_COUNT; i++) {
+		if (mask & LED_BIT(i)) {
+			plan_set_status(&rb->plan, i, (enum status) status);
+		}
+	}
+	if (cmd == CMD_ALL || cmd == CMD_LAN) {
+		plan_mark_group(&rb->plan, 0, mask);
+	}
+
+	return 0;
+}
+
+int rb_set_intensity(struct rainbow *rb, unsigned int level)
+{
+	if (level > MAX_INTENSITY_LEVEL) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	plan_set_intensity(&rb->plan, level);
+	return 0;
+}
+
+// Applies a plan of one value, returns its errno or 0
+static int apply_one(struct rainbow *rb, struct led_state *plan)
+{
+	int ret = plan_apply(plan, &rb->current, rb->backend);
+	return ret == -1 ? errno : 0;
+}
+
+/*
+Writes values of staged one by one after a failed commit. The failed commit
+cleared current, so everything is written again.
+*/
+static int commit_each(struct rainbow *rb, const struct led_state *staged, struct rb_errors *errors)
+{
+	struct led_state plan;
+	int first = 0;
+
+	for (size_t i = 0; i < LED_COUNT; i++) {
+		if (staged->color_mask & LED_BIT(i)) {
+			state_clear(&plan);
+			plan_set_color(&plan, i, staged->color[i]);
+			errors->color[i] = apply_one(rb, &plan);
+			first = first ? first : errors->color[i];
+		}
+		if (staged->status_mask & LED_BIT(i)) {
+			state_clear(&plan);
+			plan_set_trigger(&plan, i, staged->status[i], &staged->trigger[i]);
+			errors->status[i] = apply_one(rb, &plan);
+			first = first ? first : errors->status[i];
+		}
+	}
+	if (staged->intensity_valid) {
+		state_clear(&plan);
+		plan_set_intensity(&plan, staged->intensity);
+		errors->intensity = apply_one(rb, &plan);
+		first = first ? first : errors->intensity;
+	}
+
+	// The whole commit failed for a moment, but every value got through now
+	if (!first) {
+		return 0;
+	}
+	errno = first;
+	return -1;
+}
+
+int rb_commit(struct rainbow *rb, struct rb_errors *errors)
+{
+	struct rb_errors ignored;
+	struct led_state staged = rb->plan;
+	struct led_state *current = rb_lock(rb);
+	int ret = 0;
+
+	if (!errors) {
+		errors = &ignored;
+	}
+	memset(errors, 0, sizeof(*errors));
+
+	// Static colors stop effects of their LEDs, so the engine doesn't override them
+	if (rb->animator) {
+		animator_stop(rb->animator, staged.color_mask, current);
+	}
+	if (plan_apply(&rb->plan, current, rb->backend) == -1) {
+		ret = commit_each(rb, &staged, errors);
+	}
+
+	int err = errno;
+	rb_unlock(rb);
+	errno = err;
+
+	return ret;
+}
+
+// Result of run_command() as the API reports it, error is errno of a failed backend call
+static int run_error(enum run_result ret, int error)
+{
+	switch (ret) {
+	case RUN_OK:
+		return 0;
+	case RUN_ERR_USAGE:
+		errno = EINVAL;
+		break;
+	case RUN_ERR_MEMORY:
+		errno = ENOMEM;
+		break;
+	default:
+		errno = error;
+		break;
+	}
+
+	return -1;
+}
+
+int rb_run(struct rainbow *rb, char **argv, FILE *out, FILE *err)
+{
+	tokenizer_reset(rb->tokenizer, argv, 0);
+
+	struct led_state *current = rb_lock(rb);
+	enum run_result ret = run_command(rb->tokenizer, rb->backend, current, rb->animator, out, err);
+	int error = errno;
+	rb_unlock(rb);
+
+	return run_error(ret, error);
+}
+
+int rb_run_file(struct rainbow *rb, const char *path, FILE *out, FILE *err)
+{
+	struct script *script = script_load(path);
+	if (!script) {
+		int error = errno;
+		fprintf(err, "Failed to read script %s: %s\n", path, strerror(error));
+		errno = error;
+		return -1;
+	}
+	tokenizer_reset(rb->tokenizer, script_argv(script), 0);
+	tokenizer_set_lines(rb->tokenizer, script_lines(script));
+
+	struct led_state *current = rb_lock(rb);
+	enum run_result ret = run_command(rb->tokenizer, rb->backend, current, rb->animator, out, err);
+	int error = errno;
+	rb_unlock(rb);
+
+	// The tokenizer must not keep arguments of the freed script
+	tokenizer_reset(rb->tokenizer, empty_argv, 0);
+	script_destroy(script);
+
+	return run_error(ret, error);
+}
+
+int rb_get_intensity(struct rainbow *rb, unsigned int *level)
+{
+	return backend_get_intensity(rb->backend, level);
+}
+
+int rb_get_led(struct rainbow *rb, enum rb_led led, unsigned int *color, enum rb_status *status)
+{
+	if (led < RB_LED_PWR || led >= RB_LED_COUNT) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	struct trigger trigger;
+	enum status read;
+	if (backend_get_led(rb->backend, (enum cmd) led, color, &read, &trigger) == -1) {
+		return -1;
+	}
+	*status = (enum rb_status) read;
+
+	return 0;
+}
+
+int rb_get_all(struct rainbow *rb, FILE *out, bool json)
+{
+	enum run_result ret = snapshot_get(json, rb->backend, rb_lock(rb), out);
+	rb_unlock(rb);
+
+	return ret;
+}
+
+int rb_snapshot(struct rainbow *rb, const char *path)
+{
+	enum run_result ret = snapshot_save(path, rb->backend, rb_lock(rb));
+	rb_unlock(rb);
+
+	return ret;
+}
+
+int rb_restore(struct rainbow *rb, const char *path)
+{
+	enum run_result ret = snapshot_restore(path, rb->backend, rb_lock(rb));
+	rb_unlock(rb);
+
+	return ret;
+}
+
+int rb_scene_compile(const char *name, char **args)
+{
+	return scene_compile(name, args);
+}
+
+int rb_scene_apply(struct rainbow *rb, char **names)
+{
+	enum run_result ret = scene_apply(names, rb->backend, rb_lock(rb));
+	rb_unlock(rb);
+
+	return ret;
+}
+
+int rb_layer_set(struct rainbow *rb, const char *name, char **args)
+{
+	enum run_result ret = layer_set(name, args, rb->backend, rb_lock(rb));
+	rb_unlock(rb);
+
+	return ret;
+}
+
+int rb_layer_drop(struct rainbow *rb, const char *name)
+{
+	enum run_result ret = layer_drop(name, rb->backend, rb_lock(rb));
+	rb_unlock(rb);
+
+	return ret;
+}
+
+int rb_layer_list(FILE *out)
+{
+	return layer_list(out);
+}
+
+/*
+Long running modes start from the known state, but the state changes all the
+time, so other contexts must not trust it meanwhile. Returns false on dry run,
+nothing is planned by those modes.
+*/
+static bool take_over(struct rainbow *rb, const char *mode, struct led_state *current)
+{
+	if (rb->flags & RB_DRY_RUN) {
+		fprintf(stderr, "Mode %s can't be a dry run\n", mode);
+		return false;
+	}
+
+	struct led_state *known = rb_lock(rb);
+	*current = *known;
+	state_clear(known);
+	rb_unlock(rb);
+	backend_keep_stats(rb->backend);
+
+	return true;
+}
+
+static int hand_back(struct rainbow *rb, const struct led_state *current, enum run_result ret)
+{
+	if (rb->shadow) {
+		state_update(STATE_FILE, current, LED_ALL_MASK);
+	}
+
+	return ret;
+}
+
+int rb_stream(struct rainbow *rb, const char *path)
+{
+	struct led_state current;
+	if (!take_over(rb, "stream", &current)) {
+		return RUN_ERR_USAGE;
+	}
+
+	return hand_back(rb, &current, run_stream(path, rb->backend, &current));
+}
+
+int rb_flush(struct rainbow *rb, volatile sig_atomic_t *stop)
+{
+	struct led_state current;
+	if (!take_over(rb, "flush", &current)) {
+		return RUN_ERR_USAGE;
+	}
+
+	return hand_back(rb, &current, run_flush(rb->backend, &current, stop));
+}
+
+int rb_link(struct rainbow *rb, char **args, volatile sig_atomic_t *stop)
+{
+	struct led_state current;
+	if (!take_over(rb, "link", &current)) {
+		return RUN_ERR_USAGE;
+	}
+
+	return hand_back(rb, &current, run_link(args, rb->backend, &current, stop));
+}
+
+int rb_metric(struct rainbow *rb, char **args, volatile sig_atomic_t *stop)
+{
+	struct led_state current;
+	if (!take_over(rb, "metric", &current)) {
+		return RUN_ERR_USAGE;
+	}
+
+	return hand_back(rb, &current, run_metric(args, rb->backend, &current, stop));
+}
+
+int rb_effects_fd(struct rainbow *rb)
+{
+	return rb->animator ? animator_fd(rb->animator) : -1;
+}
+
+unsigned int rb_effects_mask(struct rainbow *rb)
+{
+	return rb->animator ? animator_mask(rb->animator) : 0;
+}
+
+int rb_effects_tick(struct rainbow *rb)
+{
+	if (!rb->animator) {
+		return 0;
+	}
+
+	// Final colors of finished effects are known again
+	struct led_state finished;
+	state_clear(&finished);
+	int ret = animator_tick(rb->animator, &finished);
+	int err = errno;
+	if (rb->shadow && finished.color_mask) {
+		state_update(STATE_FILE, &finished, 0);
+	}
+	errno = err;
+
+	return ret;
+}
+
+void rb_effects_stop(struct rainbow *rb)
+{
+	if (!rb->animator) {
+		return;
+	}
+
+	// Interrupted effects keep their last frame
+	struct led_state finished;
+	state_clear(&finished);
+	animator_stop(rb->animator, LED_ALL_MASK, &finished);
+	if (rb->shadow && finished.color_mask) {
+		state_update(STATE_FILE, &finished, 0);
+	}
+}
@@ -0,0 +1,160 @@
+/*
+ * Rainbow is a tool for changing color and status of the LEDs of the Turris router
+ *
+ * Copyright (C) 2016 CZ.NIC, z.s.p.o. (http://www.nic.cz/)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef LIBRAINBOW_H
+#define LIBRAINBOW_H
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <signal.h>
+
+/*
+C API of rainbow, built as librainbow.so. Programs changing LEDs often link
+it instead of running rainbow for every change. Nothing here exits, errors
+are returned as -1 with errno set.
+
+Changes are grouped into transactions: rb_begin() discards what was staged,
+rb_set_*() stage values and rb_commit() writes everything that differs from
+the LEDs at once, under the lock of the stored state (see rainbow --help).
+Contexts are independent, but one of them must not be used by more threads
+at once.
+*/
+
+#define RB_API __attribute__((visibility("default")))
+
+// Single LEDs come first, RB_LED_ALL and RB_LED_LAN are groups of them
+enum rb_led {
+	RB_LED_PWR,
+	RB_LED_LAN0,
+	RB_LED_LAN1,
+	RB_LED_LAN2,
+	RB_LED_LAN3,
+	RB_LED_LAN4,
+	RB_LED_WAN,
+	RB_LED_PCI1,
+	RB_LED_PCI2,
+	RB_LED_PCI3,
+	RB_LED_USR1,
+	RB_LED_USR2,
+	RB_LED_ALL,
+	RB_LED_LAN
+};
+
+#define RB_LED_COUNT 12
+
+// Statuses from RB_ST_NETDEV are kernel LED triggers, they are only read back
+enum rb_status {
+	RB_ST_DISABLE,
+	RB_ST_ENABLE,
+	RB_ST_AUTO,
+	RB_ST_NETDEV,
+	RB_ST_TIMER,
+	RB_ST_ACTIVITY,
+	RB_ST_DISK,
+	RB_ST_PATTERN
+};
+
+// Flags of rb_open()
+#define RB_FORCE 0x1 // The stored state is not trusted, every staged value is written
+#define RB_EFFECTS 0x2 // Effects can be started by rb_run(), see rb_effects_fd()
+#define RB_DRY_RUN 0x4 // Writes are only planned by backend 'plan', the stored state is not changed
+#define RB_STATS 0x8 // Calls of the backend are added to the statistics file, for programs that keep running
+
+struct rainbow;
+
+// Errno of writes that failed in rb_commit(), 0 for the rest
+struct rb_errors {
+	int color[RB_LED_COUNT];
+	int status[RB_LED_COUNT];
+	int intensity;
+};
+
+// Backend is NAME[:ARG] as accepted by rainbow --backend (NULL for sysfs)
+RB_API struct rainbow *rb_open(const char *backend, unsigned int flags);
+// Finishes running effects and frees everything
+RB_API void rb_close(struct rainbow *rb);
+
+RB_API void rb_begin(struct rainbow *rb);
+// Led may be a group, status is disable, enable or auto, EINVAL for the rest
+RB_API int rb_set_color(struct rainbow *rb, enum rb_led led, unsigned int color);
+RB_API int rb_set_status(struct rainbow *rb, enum rb_led led, enum rb_status status);
+RB_API int rb_set_intensity(struct rainbow *rb, unsigned int level);
+/*
+Writes the staged values and starts a new transaction. When some write fails,
+the LEDs are written one by one to find out which of them failed, errors
+(may be NULL) tells it per LED. Returns -1 with errno of the first failure.
+*/
+RB_API int rb_commit(struct rainbow *rb, struct rb_errors *errors);
+
+/*
+Runs arguments of rainbow (DEV_CONFIGURATIONs, NULL terminated) as one
+transaction, staged values are left alone. Output of 'get' goes to out,
+messages to err. Returns -1 on failure, errno is EINVAL for wrong arguments,
+ENOMEM or errno of the backend call that failed.
+*/
+RB_API int rb_run(struct rainbow *rb, char **argv, FILE *out, FILE *err);
+// The same for a script as rainbow --file runs it ('-' is stdin), errors tell its line
+RB_API int rb_run_file(struct rainbow *rb, const char *path, FILE *out, FILE *err);
+
+RB_API int rb_get_intensity(struct rainbow *rb, unsigned int *level);
+/*
+Reads a single LED back, ENOTSUP when the backend can't do it, ENOMSG when
+the LED runs a kernel trigger rainbow has no status for
+*/
+RB_API int rb_get_led(struct rainbow *rb, enum rb_led led, unsigned int *color, enum rb_status *status);
+
+/*
+Effects started by rb_run() need rb_effects_tick() whenever the descriptor
+is readable (POLLIN). It is -1 without RB_EFFECTS.
+*/
+RB_API int rb_effects_fd(struct rainbow *rb);
+// LEDs (bit 1 << led) animated now
+RB_API unsigned int rb_effects_mask(struct rainbow *rb);
+RB_API int rb_effects_tick(struct rainbow *rb);
+// Stops every effect, LEDs keep their last frame
+RB_API void rb_effects_stop(struct rainbow *rb);
+
+/*
+Modes of rainbow, see rainbow --help. They return 0 or exit code of rainbow
+(1 usage, 2 memory, 3 backend) and print their messages to stderr. Staged
+values are left alone.
+*/
+// All LEDs as 'get all' prints them, as JSON with json
+RB_API int rb_get_all(struct rainbow *rb, FILE *out, bool json);
+// Path '-' of snapshot is stdout
+RB_API int rb_snapshot(struct rainbow *rb, const char *path);
+RB_API int rb_restore(struct rainbow *rb, const char *path);
+// Names and args are NULL terminated
+RB_API int rb_scene_compile(const char *name, char **args);
+RB_API int rb_scene_apply(struct rainbow *rb, char **names);
+RB_API int rb_layer_set(struct rainbow *rb, const char *name, char **args);
+RB_API int rb_layer_drop(struct rainbow *rb, const char *name);
+RB_API int rb_layer_list(FILE *out);
+
+/*
+Long running modes drive the LEDs until stream ends or stop is set (from a
+signal handler). Meanwhile other contexts don't trust the stored state, the
+LEDs are stored when they return. They keep statistics as RB_STATS does. They fail with usage error on RB_DRY_RUN.
+*/
+RB_API int rb_stream(struct rainbow *rb, const char *path);
+RB_API int rb_flush(struct rainbow *rb, volatile sig_atomic_t *stop);
+RB_API int rb_link(struct rainbow *rb, char **args, volatile sig_atomic_t *stop);
+RB_API int rb_metric(struct rainbow *rb, char **args, volatile sig_atomic_t *stop);
+
+#endif //LIBRAINBOW_H
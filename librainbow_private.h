@@ -0,0 +1,38 @@
+/*
+ * Rainbow is a tool for changing color and status of the LEDs of the Turris router
+ *
+ * Copyright (C) 2016 CZ.NIC, z.s.p.o. (http://www.nic.cz/)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef LIBRAINBOW_PRIVATE_H
+#define LIBRAINBOW_PRIVATE_H
+
+#include "librainbow.h"
+
+struct backend;
+struct led_state;
+
+/*
+Not exported by librainbow.so. Rainbow itself reaches the backend for
+--trace and the dumps of record and plan. Rb_lock() takes the lock of the
+stored state and returns the known state of the LEDs, rb_unlock() stores
+changes of it and releases the lock.
+*/
+struct backend *rb_backend(struct rainbow *rb);
+struct led_state *rb_lock(struct rainbow *rb);
+void rb_unlock(struct rainbow *rb);
+
+#endif //LIBRAINBOW_PRIVATE_H
@@ -0,0 +1,226 @@
+/*
+ * Rainbow is a tool for changing color and status of the LEDs of the Turris router
+ *
+ * Copyright (C) 2016 CZ.NIC, z.s.p.o. (http://www.nic.cz/)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <linux/if.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+
+#include "configuration.h"
+#include "arg_parser.h"
+#include "backend.h"
+#include "command.h"
+#include "plan.h"
+#include "link.h"
+
+#define LINK_MAP_MAX 16
+#define LINK_BUFF_SIZE 16384
+
+struct link_map {
+	char ifname[IFNAMSIZ];
+	enum cmd cmd;
+};
+
+static const struct link_map default_map[] = {
+	{ "lan0", CMD_LAN0 },
+	{ "lan1", CMD_LAN1 },
+	{ "lan2", CMD_LAN2 },
+	{ "lan3", CMD_LAN3 },
+	{ "lan4", CMD_LAN4 },
+	{ "eth2", CMD_WAN }
+};
+
+static bool parse_map(char **args, struct link_map *map, size_t *count)
+{
+	*count = 0;
+	if (!args[0]) {
+		*count = sizeof(default_map) / sizeof(*default_map);
+		memcpy(map, default_map, sizeof(default_map));
+		return true;
+	}
+
+	for (size_t i = 0; args[i]; i++) {
+		const char *eq = strchr(args[i], '=');
+		if (!eq || eq == args[i] || (size_t) (eq - args[i]) >= IFNAMSIZ || *count == LINK_MAP_MAX) {
+			fprintf(stderr, "Invalid interface mapping: %s\n", args[i]);
+			return false;
+		}
+
+		enum cmd cmd = CMD_UNDEF;
+		for (int j = CMD_PWR; j < LED_COUNT; j++) {
+			if (strcmp(eq + 1, cmd_keyword(j)) == 0) {
+				cmd = j;
+			}
+		}
+		if (cmd == CMD_UNDEF) {
+			fprintf(stderr, "Mapping %s doesn't name a single LED\n", args[i]);
+			return false;
+		}
+
+		memcpy(map[*count].ifname, args[i], eq - args[i]);
+		map[*count].ifname[eq - args[i]] = '\0';
+		map[*count].cmd = cmd;
+		(*count)++;
+	}
+
+	return true;
+}
+
+static int netlink_open()
+{
+	int fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+	if (fd == -1) {
+		return -1;
+	}
+
+	struct sockaddr_nl addr = {
+		.nl_family = AF_NETLINK,
+		.nl_groups = RTMGRP_LINK
+	};
+	if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) == -1) {
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+// Asks for state of all links, the answer comes like notifications do
+static int request_dump(int fd)
+{
+	struct {
+		struct nlmsghdr nlh;
+		struct ifinfomsg ifi;
+	} req = {
+		.nlh = {
+			.nlmsg_len = sizeof(req),
+			.nlmsg_type = RTM_GETLINK,
+			.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP
+		},
+		.ifi = { .ifi_family = AF_UNSPEC }
+	};
+
+	return send(fd, &req, sizeof(req), 0) == -1 ? -1 : 0;
+}
+
+static void link_message(struct nlmsghdr *nlh, const struct link_map *map, size_t count, struct led_state *plan)
+{
+	if (nlh->nlmsg_type != RTM_NEWLINK && nlh->nlmsg_type != RTM_DELLINK) {
+		return;
+	}
+
+	struct ifinfomsg *ifi = NLMSG_DATA(nlh);
+	int len = IFLA_PAYLOAD(nlh);
+	const char *ifname = NULL;
+
+	for (struct rtattr *rta = IFLA_RTA(ifi); RTA_OK(rta, len); rta = RTA_NEXT(rta, len)) {
+		if (rta->rta_type == IFLA_IFNAME) {
+			ifname = RTA_DATA(rta);
+		}
+	}
+	if (!ifname) {
+		return;
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		if (strncmp(map[i].ifname, ifname, IFNAMSIZ) != 0) {
+			continue;
+		}
+
+		if (nlh->nlmsg_type == RTM_DELLINK || !(ifi->ifi_flags & IFF_UP)) {
+			plan_set_status(plan, map[i].cmd, ST_DISABLE);
+		} else if (ifi->ifi_flags & IFF_LOWER_UP) {
+			plan_set_color(plan, map[i].cmd, LINK_COLOR_CARRIER);
+			plan_set_status(plan, map[i].cmd, ST_ENABLE);
+		} else {
+			plan_set_color(plan, map[i].cmd, LINK_COLOR_NO_CARRIER);
+			plan_set_status(plan, map[i].cmd, ST_ENABLE);
+		}
+	}
+}
+
+enum run_result run_link(char **args, struct backend *backend, struct led_state *current,
+		volatile sig_atomic_t *terminate)
+{
+	struct link_map map[LINK_MAP_MAX];
+	size_t count;
+	if (!parse_map(args, map, &count)) {
+		return RUN_ERR_USAGE;
+	}
+
+	// Subscribed before the dump, so no change can fall between them
+	int fd = netlink_open();
+	if (fd == -1 || request_dump(fd) == -1) {
+		fprintf(stderr, "Failed to open rtnetlink: %s\n", strerror(errno));
+		if (fd != -1) {
+			close(fd);
+		}
+		return RUN_ERR_BACKEND;
+	}
+
+	static char buff[LINK_BUFF_SIZE] __attribute__((aligned(NLMSG_ALIGNTO)));
+	struct pollfd pfd = { .fd = fd, .events = POLLIN };
+	enum run_result ret = RUN_OK;
+
+	while (!*terminate) {
+		if (poll(&pfd, 1, -1) == -1) {
+			if (errno == EINTR) {
+				continue;
+			}
+			fprintf(stderr, "Poll error: %s\n", strerror(errno));
+			ret = RUN_ERR_BACKEND;
+			break;
+		}
+
+		ssize_t len = recv(fd, buff, sizeof(buff), MSG_DONTWAIT);
+		if (len == -1) {
+			if (errno == EINTR || errno == EAGAIN) {
+				continue;
+			} else if (errno == ENOBUFS) {
+				// Kernel dropped notifications, read the whole state again
+				request_dump(fd);
+				continue;
+			}
+			fprintf(stderr, "Netlink error: %s\n", strerror(errno));
+			ret = RUN_ERR_BACKEND;
+			break;
+		}
+
+		// All messages of one datagram are applied as one update
+		struct led_state plan;
+		state_clear(&plan);
+		for (struct nlmsghdr *nlh = (struct nlmsghdr *) buff; NLMSG_OK(nlh, len); nlh = NLMSG_NEXT(nlh, len)) {
+			link_message(nlh, map, count, &plan);
+		}
+		if (!plan_empty(&plan) && plan_apply(&plan, current, backend) == -1) {
+			fprintf(stderr, "Backend error: %s\n", strerror(errno));
+			ret = RUN_ERR_BACKEND;
+			break;
+		}
+	}
+
+	close(fd);
+	return ret;
+}
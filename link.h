@@ -0,0 +1,38 @@
+/*
+ * Rainbow is a tool for changing color and status of the LEDs of the Turris router
+ *
+ * Copyright (C) 2016 CZ.NIC, z.s.p.o. (http://www.nic.cz/)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef LINK_H
+#define LINK_H
+
+#include <signal.h>
+
+#include "backend.h"
+#include "command.h"
+#include "plan.h"
+
+/*
+Follows link state of network interfaces by rtnetlink notifications and
+shows it on their LEDs until terminate is set. Interfaces are mapped by args
+of form IFACE=DEV, the default map is the one of Turris Omnia. A LED is
+written only when the state of its interface changes.
+*/
+enum run_result run_link(char **args, struct backend *backend, struct led_state *current,
+		volatile sig_atomic_t *terminate);
+
+#endif //LINK_H
@@ -20,19 +20,31 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <string.h>
+#include <errno.h>
 #include <linux/i2c-dev.h>
 #include <fcntl.h>
 #include <sys/ioctl.h>
 #include <unistd.h>
 #include <getopt.h>
-#include <assert.h>
+#include <signal.h>
+#include <poll.h>
 
 #include "configuration.h"
 #include "arg_parser.h"
 #include "backend.h"
+#include "command.h"
+#include "stats.h"
+#include "librainbow_private.h"
 
 static struct option long_options[] = {
 	{"help", no_argument, 0, 'h'},
+	{"force", no_argument, 0, 'F'},
+	{"backend", required_argument, 0, 'b'},
+	{"file", required_argument, 0, 'f'},
+	{"dry-run", no_argument, 0, 'n'},
+	{"explain", no_argument, 0, 'e'},
+	{"trace", no_argument, 0, 't'},
 	{0, 0, 0, 0}
 };
 
@@ -40,8 +52,54 @@ void help() {
 	fprintf(stdout,
 		"Usage:\n"
 		"  Show this help: rainbow --help or -h\n"
-		"  Set devices: rainbow DEV_CONFIGURATION [DEV_CONFIGURATION ...]\n"
+		"  Set devices: rainbow [OPTIONS] DEV_CONFIGURATION [DEV_CONFIGURATION ...]\n"
+		"  Run script: rainbow [OPTIONS] --file FILE or -f FILE ('-' for stdin)\n"
+		"  Stream frames: rainbow [OPTIONS] stream [FILE]\n"
+		"  Flush shared framebuffer: rainbow [OPTIONS] flush\n"
+		"  Show link state: rainbow [OPTIONS] link [IFACE=DEV ...]\n"
+		"  Show metrics: rainbow [OPTIONS] metric DEV SOURCE MIN MAX [COLOR ...] [...]\n"
+		"  Compile scene: rainbow scene compile NAME DEV_CONFIGURATION [...]\n"
+		"  Apply scenes: rainbow [OPTIONS] scene apply NAME [NAME ...]\n"
+		"  Set layer: rainbow [OPTIONS] layer set NAME PRIORITY [OPACITY] DEV_CONFIGURATION [...]\n"
+		"  Drop layer: rainbow [OPTIONS] layer drop NAME\n"
+		"  List layers: rainbow layer list\n"
+		"  Show write statistics: rainbow stats [json | reset]\n"
+		"  Show all LEDs: rainbow [OPTIONS] get all [json]\n"
+		"  Save all LEDs: rainbow [OPTIONS] snapshot FILE\n"
+		"  Restore saved LEDs: rainbow [OPTIONS] restore FILE\n"
 		"\n"
+		"Values that rainbow already wrote are remembered in " STATE_FILE "\n"
+		"and are not written again. Option --force or -F writes everything, it is\n"
+		"needed when something else changed the LEDs. Intensity is always written\n"
+		"as the front button changes it.\n"
+		"\n"
+		"Options:\n"
+		"  --dry-run or -n: print the attribute writes the command would do grouped\n"
+		"    by LED instead of doing them (the stored state is read, not changed)\n"
+		"  --explain or -e: like --dry-run and count writes per LED, redundant\n"
+		"    values skipped as the LED has them and writes of single LEDs expanded\n"
+		"    from a group (all, lan, binmask) that the 'all' LED could not cover\n"
+		"  --trace or -t: print every call of the backend with its time to stderr\n"
+		"  --backend NAME[:ARG] or -b NAME[:ARG]: how LEDs are set, NAME is one of:\n"
+		"    'sysfs' (default) - attributes of LEDs found in " LED_CLASS_DIR ",\n"
+		"                        ARG is root of a fake tree with directory leds\n"
+		"    'uring' - like sysfs, but all writes of a change are submitted at once\n"
+		"              by io_uring (sysfs is used when io_uring is not available)\n"
+		"    'i2c' - LED controller directly over I2C adapter ARG\n"
+		"            (default " I2C_ADAPTER ")\n"
+		"    'i2c-record' - like i2c but only record transactions to file ARG\n"
+		"                   (default '-' for stdout)\n"
+		"    'shm' - store changes to shared framebuffer " FRAMEBUFFER_FILE "\n"
+		"    'record' - print log of the calls and their counts\n"
+		"    'null' - do nothing\n"
+		"    'plan' - print the writes of sysfs instead of doing them (as --dry-run)\n"
+		"    'async' - return at once and let a thread write the latest values\n"
+		"              by backend ARG (NAME[:ARG], default sysfs)\n"
+		"  Stored state is used only by sysfs and uring without ARG and by i2c\n"
+		"  (also behind async).\n"
+		"\n"
+	);
+	fprintf(stdout,
 		"DEV_CONFIGURATION is one of the next options:\n"
 		"DEV COLOR STATUS or DEV STATUS COLOR or DEV STATUS or DEV COLOR, where:\n"
 		"  DEV: 'pwr' (LED of Power signalization),\n"
@@ -51,114 +109,197 @@ void help() {
 		"       'usr1', 'usr2' (one of the custom USER's LED),\n"
 		"       or alias 'all' for all previous devices,\n"
 		"                'lan' for all LAN ports\n"
-		"  COLOR: name of predefined color (red, blue, green, white, black)\n"
-		"         or 3 bytes for RGB, so red is 'FF0000', green '00FF00'\n"
-		"         blue '0000FF' etc.\n"
+		"  COLOR: name of predefined color (red, green, blue, white, black,\n"
+		"         yellow, cyan, magenta, orange, purple, pink, ... as in CSS,\n"
+		"         amber, sky, warmwhite) or 3 bytes for RGB, so red is 'FF0000',\n"
+		"         green '00FF00' blue '0000FF' etc. or 'hsv:H,S,V', 'hsl:H,S,L'\n"
+		"         with hue H in degrees (0-359) and the rest in percent.\n"
+		"         Gamma %.1f is applied to colors for the LEDs (1.0 writes them as\n"
+		"         given), see configuration.h for white balance and intensity.\n"
 		"  STATUS: 'enable' (device is shining), 'disable' (device is off)\n"
 		"          'auto' (device is operated by HW - typically flashing)\n"
+		"          or a kernel LED trigger blinking the LED by itself:\n"
+		"          'netdev:IFACE[:MODES]' (traffic of interface IFACE, MODES is\n"
+		"          comma separated link, rx and tx, all of them by default),\n"
+		"          'timer[:ON,OFF]' (blink ON and OFF ms, 500 each by default),\n"
+		"          'activity' (CPU load), 'disk' (disk activity),\n"
+		"          'pattern:EFFECT[:PERIOD[:COUNT]]' (brightness of EFFECT 'blink',\n"
+		"          'breathe', 'heartbeat' or 'sos' taking PERIOD ms, COUNT times\n"
+		"          or forever). Backends sysfs and uring only, patterns fall back\n"
+		"          to the effect engine where the kernel has no pattern trigger.\n"
+		"          Triggers can't be part of scenes and layers.\n"
+		"\n"
+		"DEV EFFECT [COLOR [COLOR2]] [PERIOD], where:\n"
+		"  EFFECT: 'fade' (change color smoothly to COLOR once),\n"
+		"          'pulse' (blink between COLOR and COLOR2),\n"
+		"          'breathe' (smoothly between COLOR and COLOR2),\n"
+		"          'cycle' (go around the color wheel),\n"
+		"          'chase' (COLOR moves over LEDs of DEV, the rest has COLOR2),\n"
+		"          'stop' (keep the current color)\n"
+		"  COLOR defaults to white, COLOR2 to black and PERIOD to 1000 ms.\n"
+		"  Rainbow keeps running while any effect is active, setting a color\n"
+		"  of a LED stops its effect.\n"
 		"\n"
 		"'intensity' NUMBER, where:\n"
-		"  NUMBER is number from 0 to 100 (percent of maximum brightness).\n"
+		"  NUMBER is number from 0 to 100 (percent of maximum brightness as it is\n"
+		"  perceived, so the steps look even).\n"
 		"\n"
 		"'binmask' NUMBER:\n"
 		"  Use binary representation of NUMBER as mask to set ENABLE/DISABLE\n"
 		"  status of LEDs. MSB is PWR LED and LSB is USR2. Max value is 4095 or 0xFFF.\n"
 		"\n"
+		, COLOR_GAMMA
+	);
+	fprintf(stdout,
+		"'stream' reads binary frames from FILE (FIFO) or stdin until EOF. Frame has\n"
+		"  49 bytes: R, G, B and mode (0 disable, 1 enable, 2 auto) for each LED in\n"
+		"  order pwr, lan0-4, wan, pci1-3, usr1, usr2 followed by intensity. Mode or\n"
+		"  intensity 255 keeps the value. Only the newest frame waiting is applied.\n"
+		"\n"
+		"'flush' runs until terminated and writes every change of the shared\n"
+		"  framebuffer to the LEDs. Producers change it by plain memory writes\n"
+		"  (see framebuffer.h) or by 'rainbow --backend shm ...'.\n"
+		"\n"
+		"Script contains DEV_CONFIGURATIONs separated by spaces or newlines, text\n"
+		"  from # to the end of line is ignored. The whole script is one command,\n"
+		"  LEDs are written once at the end.\n"
+		"\n"
+		"'link' runs until terminated and shows state of network interfaces on\n"
+		"  their LEDs: color %06X with carrier, %06X without it and off when the\n"
+		"  interface is down. Default map is lan0-4 to LEDs lan0-4 and eth2 to wan.\n"
+		"\n"
+		"'metric' runs until terminated and maps value of SOURCE from MIN to MAX\n"
+		"  on gradient of COLORs (default green to red, one color fades from black)\n"
+		"  for every binding. SOURCE is 'rx:IFACE' or 'tx:IFACE' (kbit/s),\n"
+		"  'cpu' (percent of load) or 'temp[:ZONE]' (degrees Celsius).\n"
+		"\n"
+		"Scenes are stored in " SCENE_DIR "/NAME.scene, NAME containing '/' is\n"
+		"  a path. Applying more scenes at once merges them, the later one wins.\n"
+		"  Effects and 'get' can't be part of a scene.\n"
+		"\n"
+		"Layers are stored in " LAYER_FILE " and LEDs show all of them at once.\n"
+		"  They are blended from the lowest PRIORITY (0-255) up, each with its\n"
+		"  OPACITY (0-100 %%, default 100). Status of a LED is set by the highest\n"
+		"  layer that has it. Effects and intensity can't be part of a layer.\n"
+		"\n"
+		"Rainbowd and the long-running modes (stream, flush, link, metric) add\n"
+		"  counts, errors, EINTR retries, bytes and latency histograms of calls\n"
+		"  of backends driving the real LEDs per LED to " STATS_FILE "\n"
+		"  every %d s and on exit, other runs don't. 'stats' prints them,\n"
+		"  elided are writes skipped as the LED already had the value, expanded\n"
+		"  are writes of single LEDs that got the value from a group.\n"
+		"\n"
 		"'get' VALUE, where:\n"
-		"  VALUE is 'intensity' (no more getters are available for now)\n"
+		"  VALUE is 'intensity' or 'all' (color and status of every LED read from\n"
+		"  the LEDs and intensity, printed as DEV_CONFIGURATIONs)\n"
+		"\n"
+		"'snapshot' stores 'get all' to FILE ('-' for stdout), 'restore' reads the\n"
+		"  LEDs and writes only values of FILE that differ. Backends sysfs, uring\n"
+		"  and shm can read LEDs, the others restore against the stored state.\n"
+		"  Triggers are read with their parameters. 'get all' and 'snapshot' fail\n"
+		"  when an LED runs a kernel trigger that no STATUS matches.\n"
 		"\n"
 		"Examples:\n"
 		"rainbow all blue auto - reset status of all LEDs and set their color to blue\n"
 		"rainbow all blue pwr red - set color of all LEDs to blue except the Power one\n"
 		"rainbow all enable wan auto - all LEDs will be shining except the LED of WAN port\n"
 		"                              that will flash according to traffic\n"
+		"rainbow lan chase blue 500 - blue light runs over LAN LEDs twice a second\n"
+		"rainbow wan netdev:eth2:rx,tx - WAN LED blinks on traffic of eth2 only\n"
+		"rainbow pwr red pattern:sos - power LED calls for help in red, run by the kernel\n"
 
 
 
+		, LINK_COLOR_CARRIER, LINK_COLOR_NO_CARRIER, STATS_INTERVAL / 1000
 	);
 }
 
-static void meta_set_color(enum cmd cmd, unsigned int color)
+struct cleanup_data {
+	struct rainbow *rb;
+};
+
+static struct cleanup_data cleanup = {
+	.rb = NULL
+};
+
+static volatile sig_atomic_t terminate = 0;
+
+static void cleanup_atexit()
 {
-	switch (cmd) {
-	case CMD_LAN:
-		set_color(CMD_LAN0, color);
-		set_color(CMD_LAN1, color);
-		set_color(CMD_LAN2, color);
-		set_color(CMD_LAN3, color);
-		set_color(CMD_LAN4, color);
-		break;
-	case CMD_UNDEF:
-	case CMD_INTEN:
-	case CMD_BINMASK:
-	case CMD_GET:
-		assert(NULL);
-		break;
-	default:
-		set_color(cmd, color);
-	}
+	rb_close(cleanup.rb);
 }
 
-static void meta_set_status(enum cmd cmd, enum status status)
+static void signal_handler(int sig)
 {
-	switch (cmd) {
-	case CMD_LAN:
-		set_status(CMD_LAN0, status);
-		set_status(CMD_LAN1, status);
-		set_status(CMD_LAN2, status);
-		set_status(CMD_LAN3, status);
-		set_status(CMD_LAN4, status);
-		break;
-	case CMD_UNDEF:
-	case CMD_INTEN:
-	case CMD_BINMASK:
-	case CMD_GET:
-		assert(NULL);
-		break;
-	default:
-		set_status(cmd, status);
-	}
+	(void) sig;
+	terminate = 1;
 }
 
-static void binmask_set(unsigned mask, unsigned position, enum cmd cmd)
+static void install_signals()
 {
-	if (mask & position) {
-		set_status(cmd, ST_ENABLE);
-	} else {
-		set_status(cmd, ST_DISABLE);
-	}
+	// Without SA_RESTART, so blocking calls are interrupted
+	struct sigaction sa;
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = signal_handler;
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
 }
 
-static void binmask(unsigned int mask)
+/*
+Runs effects until all of them finish or rainbow is terminated. Final
+colors are stored in the state file when the backend uses it.
+*/
+static enum run_result run_animations(struct rainbow *rb)
 {
-	binmask_set(mask, 0x800, CMD_PWR);
-	binmask_set(mask, 0x400, CMD_LAN0);
-	binmask_set(mask, 0x200, CMD_LAN1);
-	binmask_set(mask, 0x100, CMD_LAN2);
-	binmask_set(mask, 0x080, CMD_LAN3);
-	binmask_set(mask, 0x040, CMD_LAN4);
-	binmask_set(mask, 0x020, CMD_WAN);
-	binmask_set(mask, 0x010, CMD_PCI1);
-	binmask_set(mask, 0x008, CMD_PCI2);
-	binmask_set(mask, 0x004, CMD_PCI3);
-	binmask_set(mask, 0x002, CMD_USR1);
-	binmask_set(mask, 0x001, CMD_USR2);
-}
+	install_signals();
 
-struct cleanup_data {
-	int fd;
-	struct tokenizer *tokenizer;
-};
+	struct pollfd pfd = { .fd = rb_effects_fd(rb), .events = POLLIN };
+	enum run_result ret = RUN_OK;
 
-static struct cleanup_data cleanup = {
-	.tokenizer = NULL
-};
+	while (rb_effects_mask(rb) && !terminate) {
+		if (poll(&pfd, 1, -1) == -1) {
+			if (errno == EINTR) {
+				continue;
+			}
+			fprintf(stderr, "Poll error: %s\n", strerror(errno));
+			ret = RUN_ERR_BACKEND;
+			break;
+		}
 
-static void cleanup_atexit()
+		if (rb_effects_tick(rb) == -1) {
+			fprintf(stderr, "Backend error: %s\n", strerror(errno));
+			ret = RUN_ERR_BACKEND;
+			break;
+		}
+	}
+
+	rb_effects_stop(rb);
+
+	return ret;
+}
+
+static enum run_result run_stats(const char *action)
 {
-	if (cleanup.tokenizer) {
-		tokenizer_destroy(cleanup.tokenizer);
+	struct write_stats stats;
+
+	if (action && strcmp(action, "reset") == 0) {
+		if (!stats_reset(STATS_FILE)) {
+			fprintf(stderr, "Failed to remove %s: %s\n", STATS_FILE, strerror(errno));
+			return RUN_ERR_BACKEND;
+		}
+		return RUN_OK;
+	} else if (action && strcmp(action, "json") != 0) {
+		fprintf(stderr, "Use 'stats', 'stats json' or 'stats reset'\n");
+		return RUN_ERR_USAGE;
+	}
+
+	if (!stats_load(STATS_FILE, &stats)) {
+		fprintf(stderr, "Failed to read %s: %s\n", STATS_FILE, strerror(errno));
+		return RUN_ERR_BACKEND;
 	}
+	stats_print(&stats, stdout, action != NULL);
+
+	return RUN_OK;
 }
 
 int main(int argc, char **argv) {
@@ -169,110 +310,138 @@ int main(int argc, char **argv) {
 
 	//Parse options
 	int c; //returned char
+	bool force = false;
+	const char *backend_spec = "sysfs";
+	const char *script_path = NULL;
+	bool dry_run = false, explain = false, trace = false;
 
-	while ((c = getopt_long(argc, argv, "h", long_options, NULL)) != -1) {
+	while ((c = getopt_long(argc, argv, "hFb:f:net", long_options, NULL)) != -1) {
 		switch (c) {
 			case 'h':
 				help();
 				return 0;
 				break;
+			case 'F':
+				force = true;
+				break;
+			case 'b':
+				backend_spec = optarg;
+				break;
+			case 'f':
+				script_path = optarg;
+				break;
+			case 'e':
+				explain = true;
+				// fall through
+			case 'n':
+				dry_run = true;
+				break;
+			case 't':
+				trace = true;
+				break;
+			default:
+				return 1;
 		}
 	}
 
-	struct tokenizer *tokenizer = tokenizer_init(argv, optind);
-	if (!tokenizer) {
-		fprintf(stderr, "Memory allocation error\n");
-		exit(2);
+	// Compiling a scene doesn't touch LEDs, so it works without any backend
+	if (!script_path && optind + 2 < argc && strcmp(argv[optind], "scene") == 0 &&
+			strcmp(argv[optind + 1], "compile") == 0) {
+		return rb_scene_compile(argv[optind + 2], argv + optind + 3);
+	}
+	if (!script_path && optind + 1 < argc && strcmp(argv[optind], "layer") == 0 &&
+			strcmp(argv[optind + 1], "list") == 0) {
+		return rb_layer_list(stdout);
+	}
+	if (!script_path && optind < argc && strcmp(argv[optind], "stats") == 0) {
+		return run_stats(optind + 1 < argc ? argv[optind + 1] : NULL);
 	}
 
-	// Now I have FD - prepare cleanup
-	cleanup.tokenizer = tokenizer;
+	if (script_path && optind < argc) {
+		fprintf(stderr, "Script can't be combined with arguments\n");
+		return 1;
+	}
 	atexit(cleanup_atexit);
 
-	enum cmd current_cmd = CMD_UNDEF;
-	bool eof = false;
-
-	while (!eof) {
-		struct token token = next_token(tokenizer);
-
-		switch (token.type) {
-		case TOK_UNDEF:
-			fprintf(stderr, "Undefined sequence: %s is some garbage\n", token.raw);
-			return 1;
-		case TOK_CMD:
-			switch (token.data.cmd) {
-			case CMD_GET:
-				token = next_token(tokenizer);
-				if (token.type != TOK_CMD) {
-					fprintf(stderr, "Specify item for get command\n");
-					return 1;
-				}
-				if (token.data.cmd == CMD_INTEN) {
-					printf("%d\n", get_intensity());
-				} else {
-					fprintf(stderr, "Unknown getter\n");
-					return 1;
-				}
-				break;
-			case CMD_INTEN:
-				token = next_token(tokenizer);
-				if (token.type != TOK_NUMBER) {
-					fprintf(stderr, "Specify intensity level\n");
-					return 1;
-				}
-				if (token.data.number <= MAX_INTENSITY_LEVEL) {
-					set_intensity(token.data.number);
-				} else {
-					fprintf(stderr, "Intensity is out of range [0-100]\n");
-					return 1;
-				}
-				break;
-			case CMD_BINMASK:
-				token = next_token(tokenizer);
-				if (token.type != TOK_NUMBER) {
-					fprintf(stderr, "Specify binary mask\n");
-					return 1;
-				}
-				if (token.data.number <= MAX_BINMASK_VALUE) {
-					binmask(token.data.number);
-				} else {
-					fprintf(stderr, "Number is out of range [0-0xFFF]\n");
-					return 1;
-				}
-				break;
-			case CMD_UNDEF:
-				fprintf(stderr, "Undefined command\n");
-				return 1;
-			default: // The rest of command is some real device
-				current_cmd = token.data.cmd;
-				break;
-			}
-			break;
-		case TOK_NUMBER:
-			fprintf(stderr, "Unexpected value: %s\n", token.raw);
-			return 1;
-		case TOK_COLOR:
-			if (current_cmd == CMD_UNDEF) {
-				fprintf(stderr, "Trying to configure undefined device\n");
-				return 1;
-			}
-			meta_set_color(current_cmd, token.data.color);
-			break;
+	const char *mode = !script_path && optind < argc ? argv[optind] : "";
+	// JSON is no keyword, the rest of getters are left to the tokenizer
+	bool get_json = strcmp(mode, "get") == 0 && optind + 3 == argc && strcmp(argv[optind + 1], "all") == 0 &&
+		strcmp(argv[optind + 2], "json") == 0;
 
-		case TOK_STATUS:
-			if (current_cmd == CMD_UNDEF) {
-				fprintf(stderr, "Trying to configure undefined device\n");
-				return 1;
-			}
-			meta_set_status(current_cmd, token.data.status);
-			break;
+	// Dry run plans against the stored state, but never writes anything
+	struct rainbow *rb = rb_open(backend_spec, RB_EFFECTS | (force ? RB_FORCE : 0) | (dry_run ? RB_DRY_RUN : 0));
+	if (!rb) {
+		fprintf(stderr, "Failed to initialize backend %s: %s\n", backend_spec, strerror(errno));
+		exit(errno == ENOMEM ? 2 : 3);
+	}
+	cleanup.rb = rb;
+	struct backend *backend = rb_backend(rb);
+	if (trace) {
+		backend->trace = stderr;
+	}
 
-		case TOK_EOF:
-			eof = true;
-			break;
+	enum run_result ret;
+
+	if (strcmp(mode, "stream") == 0) {
+		ret = rb_stream(rb, optind + 1 < argc ? argv[optind + 1] : "-");
+	} else if (strcmp(mode, "flush") == 0) {
+		install_signals();
+		ret = rb_flush(rb, &terminate);
+	} else if (strcmp(mode, "link") == 0) {
+		install_signals();
+		ret = rb_link(rb, argv + optind + 1, &terminate);
+	} else if (strcmp(mode, "metric") == 0) {
+		install_signals();
+		ret = rb_metric(rb, argv + optind + 1, &terminate);
+
+	} else if (strcmp(mode, "scene") == 0) {
+		if (optind + 2 < argc && strcmp(argv[optind + 1], "apply") == 0) {
+			ret = rb_scene_apply(rb, argv + optind + 2);
+		} else {
+			fprintf(stderr, "Use 'scene compile NAME ...' or 'scene apply NAME ...'\n");
+			ret = RUN_ERR_USAGE;
+		}
+	} else if (strcmp(mode, "snapshot") == 0 || strcmp(mode, "restore") == 0) {
+		if (optind + 2 != argc) {
+			fprintf(stderr, "Use 'snapshot FILE' or 'restore FILE'\n");
+			ret = RUN_ERR_USAGE;
+		} else if (strcmp(mode, "snapshot") == 0) {
+			ret = rb_snapshot(rb, argv[optind + 1]);
+		} else {
+			ret = rb_restore(rb, argv[optind + 1]);
+		}
+	} else if (get_json) {
+		ret = rb_get_all(rb, stdout, true);
+	} else if (strcmp(mode, "layer") == 0) {
+		if (optind + 2 < argc && strcmp(argv[optind + 1], "set") == 0) {
+			ret = rb_layer_set(rb, argv[optind + 2], argv + optind + 3);
+		} else if (optind + 2 < argc && strcmp(argv[optind + 1], "drop") == 0) {
+			ret = rb_layer_drop(rb, argv[optind + 2]);
+		} else {
+			fprintf(stderr, "Use 'layer set NAME PRIORITY ...', 'layer drop NAME' or 'layer list'\n");
+			ret = RUN_ERR_USAGE;
+		}
+
+	} else {
+		int run = script_path ? rb_run_file(rb, script_path, stdout, stderr) :
+			rb_run(rb, argv + optind, stdout, stderr);
+		if (run == 0) {
+			ret = RUN_OK;
+		} else {
+			ret = errno == EINVAL ? RUN_ERR_USAGE : errno == ENOMEM ? RUN_ERR_MEMORY : RUN_ERR_BACKEND;
 		}
 
+		// Effects are not run, only what the command writes at once is planned
+		if (ret == RUN_OK && rb_effects_mask(rb) && !dry_run) {
+			ret = run_animations(rb);
+		}
+	}
+
+	if (strcmp(backend->ops->name, "record") == 0) {
+		backend_recording_dump(backend, stdout);
+	} else if (strcmp(backend->ops->name, "plan") == 0) {
+		backend_plan_dump(backend, stdout, explain);
 	}
 
-	return 0;
+	return ret;
 }
@@ -0,0 +1,415 @@
+/*
+ * Rainbow is a tool for changing color and status of the LEDs of the Turris router
+ *
+ * Copyright (C) 2016 CZ.NIC, z.s.p.o. (http://www.nic.cz/)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <linux/if.h>
+#include <sys/timerfd.h>
+
+#include "configuration.h"
+#include "arg_parser.h"
+#include "backend.h"
+#include "command.h"
+#include "plan.h"
+#include "animation.h"
+#include "metric.h"
+
+#define METRIC_MAX_STOPS 8
+#define METRIC_BUFF_SIZE 16384
+
+enum metric_kind {
+	METRIC_RX,
+	METRIC_TX,
+	METRIC_CPU,
+	METRIC_TEMP
+};
+
+struct metric {
+	enum metric_kind kind;
+	char ifname[IFNAMSIZ];
+	int fd;
+	// Counters of the previous sample, rates need two of them
+	bool primed;
+	uint64_t prev_ms;
+	uint64_t prev_count;
+	uint64_t prev_total;
+	unsigned int mask;
+	unsigned int min, max;
+	unsigned int stops[METRIC_MAX_STOPS];
+	size_t stop_count;
+};
+
+// One buffer for all reads, files are read one after another
+static char buff[METRIC_BUFF_SIZE];
+
+static uint64_t now_ms()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static bool read_file(int fd)
+{
+	size_t len = 0;
+	while (len < sizeof(buff) - 1) {
+		ssize_t ret = pread(fd, buff + len, sizeof(buff) - 1 - len, len);
+		if (ret == 0) {
+			break;
+		} else if (ret == -1) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return false;
+		}
+		len += ret;
+	}
+	buff[len] = '\0';
+
+	return true;
+}
+
+static const char *parse_u64(const char *pos, uint64_t *value)
+{
+	while (*pos == ' ') {
+		pos++;
+	}
+	*value = 0;
+	while (*pos >= '0' && *pos <= '9') {
+		*value = *value * 10 + (*pos++ - '0');
+	}
+
+	return pos;
+}
+
+// Finds line of the interface in /proc/net/dev, returns its counters
+static const char *find_interface(const char *ifname)
+{
+	size_t len = strlen(ifname);
+	const char *line = buff;
+
+	while (line && *line) {
+		const char *pos = line;
+		while (*pos == ' ') {
+			pos++;
+		}
+		if (strncmp(pos, ifname, len) == 0 && pos[len] == ':') {
+			return pos + len + 1;
+		}
+		line = strchr(line, '\n');
+		if (line) {
+			line++;
+		}
+	}
+
+	return NULL;
+}
+
+/*
+Reads a new sample and returns the value in units of the metric. False is
+returned when there is no value yet (first sample of a rate) or on error.
+*/
+static bool metric_sample(struct metric *metric, unsigned int *value)
+{
+	uint64_t count = 0, total = 0;
+
+	if (!read_file(metric->fd)) {
+		return false;
+	}
+
+	switch (metric->kind) {
+	case METRIC_RX:
+	case METRIC_TX: {
+		const char *pos = find_interface(metric->ifname);
+		if (!pos) {
+			return false;
+		}
+		// Received bytes are the first column, transmitted the ninth
+		size_t columns = metric->kind == METRIC_RX ? 1 : 9;
+		for (size_t i = 0; i < columns; i++) {
+			pos = parse_u64(pos, &count);
+		}
+		total = now_ms();
+		break;
+	}
+	case METRIC_CPU: {
+		if (strncmp(buff, "cpu ", 4) != 0) {
+			return false;
+		}
+		// user nice system idle iowait irq softirq steal
+		const char *pos = buff + 4;
+		for (size_t i = 0; i < 8; i++) {
+			uint64_t ticks;
+			pos = parse_u64(pos, &ticks);
+			total += ticks;
+			if (i != 3 && i != 4) {
+				count += ticks;
+			}
+		}
+		break;
+	}
+	case METRIC_TEMP: {
+		// Millidegrees, below zero is shown as zero
+		if (buff[0] == '-') {
+			*value = 0;
+			return true;
+		}
+		parse_u64(buff, &count);
+		*value = count / 1000;
+		return true;
+	}
+	}
+
+	bool primed = metric->primed;
+	uint64_t delta_count = count - metric->prev_count;
+	uint64_t delta_total = total - metric->prev_total;
+	metric->primed = true;
+	metric->prev_count = count;
+	metric->prev_total = total;
+
+	if (!primed || delta_total == 0) {
+		return false;
+	}
+	if (metric->kind == METRIC_CPU) {
+		*value = delta_count * 100 / delta_total;
+	} else {
+		// Bytes per ms is 8 kbit/s
+		*value = delta_count * 8 / delta_total;
+	}
+
+	return true;
+}
+
+static unsigned int gradient(const struct metric *metric, unsigned int value)
+{
+	if (value <= metric->min) {
+		return metric->stops[0];
+	} else if (value >= metric->max) {
+		return metric->stops[metric->stop_count - 1];
+	}
+
+	// Position on the gradient in Q16, integer part is the segment
+	uint64_t pos = ((uint64_t) (value - metric->min) * (metric->stop_count - 1) << 16) /
+		(metric->max - metric->min);
+	size_t segment = pos >> 16;
+
+	return color_lerp(metric->stops[segment], metric->stops[segment + 1], pos & 0xFFFF);
+}
+
+static bool parse_unsigned(const char *raw, unsigned int *value)
+{
+	char *end;
+	unsigned long ret = strtoul(raw, &end, 0);
+	if (end == raw || *end != '\0') {
+		return false;
+	}
+	*value = ret;
+	return true;
+}
+
+static bool open_source(struct metric *metric, const char *source)
+{
+	char path[64];
+	const char *colon = strchr(source, ':');
+	size_t len = colon ? (size_t) (colon - source) : strlen(source);
+
+	if ((len == 2 && strncmp(source, "rx", 2) == 0) || (len == 2 && strncmp(source, "tx", 2) == 0)) {
+		if (!colon || strlen(colon + 1) == 0 || strlen(colon + 1) >= IFNAMSIZ) {
+			fprintf(stderr, "Invalid interface in %s\n", source);
+			return false;
+		}
+		metric->kind = source[0] == 'r' ? METRIC_RX : METRIC_TX;
+		strcpy(metric->ifname, colon + 1);
+		snprintf(path, sizeof(path), "/proc/net/dev");
+	} else if (len == 3 && strncmp(source, "cpu", 3) == 0 && !colon) {
+		metric->kind = METRIC_CPU;
+		snprintf(path, sizeof(path), "/proc/stat");
+	} else if (len == 4 && strncmp(source, "temp", 4) == 0) {
+		unsigned int zone = 0;
+		if (colon && !parse_unsigned(colon + 1, &zone)) {
+			fprintf(stderr, "Invalid thermal zone in %s\n", source);
+			return false;
+		}
+		metric->kind = METRIC_TEMP;
+		snprintf(path, sizeof(path), METRIC_THERMAL_ZONE, zone);
+	} else {
+		fprintf(stderr, "Invalid metric source %s\n", source);
+		return false;
+	}
+
+	metric->fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (metric->fd == -1) {
+		fprintf(stderr, "Failed to open %s: %s\n", path, strerror(errno));
+		return false;
+	}
+
+	return true;
+}
+
+static bool parse_bindings(char **args, struct metric *metrics, size_t *count)
+{
+	struct tokenizer *tokenizer = tokenizer_init(args, 0);
+	if (!tokenizer) {
+		return false;
+	}
+
+	bool ok = true;
+	*count = 0;
+	struct token token;
+	while (ok && (token = next_token(tokenizer)).type != TOK_EOF) {
+		if (*count == METRIC_MAX_BINDINGS) {
+			fprintf(stderr, "At most %d bindings are supported\n", METRIC_MAX_BINDINGS);
+			ok = false;
+			break;
+		}
+		struct metric *metric = &metrics[*count];
+		memset(metric, 0, sizeof(*metric));
+		metric->fd = -1;
+
+		if (token.type != TOK_CMD || !cmd_mask(token.data.cmd)) {
+			fprintf(stderr, "Expected LED instead of %s\n", token.raw);
+			ok = false;
+			break;
+		}
+		metric->mask = cmd_mask(token.data.cmd);
+		(*count)++;
+
+		struct token source = next_token(tokenizer);
+		struct token min = next_token(tokenizer);
+		struct token max = next_token(tokenizer);
+		if (source.type == TOK_EOF || min.type == TOK_EOF || max.type == TOK_EOF ||
+			!parse_unsigned(min.raw, &metric->min) || !parse_unsigned(max.raw, &metric->max) ||
+			metric->max <= metric->min) {
+			fprintf(stderr, "Binding of %s needs SOURCE MIN MAX with MIN < MAX\n", token.raw);
+			ok = false;
+			break;
+		}
+		if (!open_source(metric, source.raw)) {
+			ok = false;
+			break;
+		}
+
+		while (peek_token(tokenizer).type == TOK_COLOR && metric->stop_count < METRIC_MAX_STOPS) {
+			metric->stops[metric->stop_count++] = next_token(tokenizer).data.color;
+		}
+		if (metric->stop_count == 0) {
+			metric->stops[metric->stop_count++] = 0x00FF00;
+			metric->stops[metric->stop_count++] = 0xFF0000;
+		} else if (metric->stop_count == 1) {
+			// Single color fades in from black
+			metric->stops[1] = metric->stops[0];
+			metric->stops[0] = 0x000000;
+			metric->stop_count = 2;
+		}
+	}
+
+	tokenizer_destroy(tokenizer);
+	if (ok && *count == 0) {
+		fprintf(stderr, "Specify at least one binding: DEV SOURCE MIN MAX [COLOR ...]\n");
+		ok = false;
+	}
+
+	return ok;
+}
+
+static void close_metrics(struct metric *metrics, size_t count)
+{
+	for (size_t i = 0; i < count; i++) {
+		if (metrics[i].fd != -1) {
+			close(metrics[i].fd);
+		}
+	}
+}
+
+enum run_result run_metric(char **args, struct backend *backend, struct led_state *current,
+		volatile sig_atomic_t *terminate)
+{
+	struct metric metrics[METRIC_MAX_BINDINGS];
+	size_t count = 0;
+	if (!parse_bindings(args, metrics, &count)) {
+		close_metrics(metrics, count);
+		return RUN_ERR_USAGE;
+	}
+
+	int timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+	struct itimerspec spec = {
+		.it_interval = { .tv_sec = METRIC_INTERVAL / 1000, .tv_nsec = METRIC_INTERVAL % 1000 * 1000000L },
+		.it_value = { .tv_sec = METRIC_INTERVAL / 1000, .tv_nsec = METRIC_INTERVAL % 1000 * 1000000L }
+	};
+	if (timer_fd == -1 || timerfd_settime(timer_fd, 0, &spec, NULL) == -1) {
+		fprintf(stderr, "Failed to create timer: %s\n", strerror(errno));
+		close_metrics(metrics, count);
+		if (timer_fd != -1) {
+			close(timer_fd);
+		}
+		return RUN_ERR_BACKEND;
+	}
+
+	struct led_state plan;
+	state_clear(&plan);
+	for (size_t i = 0; i < count; i++) {
+		for (size_t j = 0; j < LED_COUNT; j++) {
+			if (metrics[i].mask & LED_BIT(j)) {
+				plan_set_status(&plan, j, ST_ENABLE);
+			}
+		}
+	}
+
+	enum run_result ret = RUN_OK;
+	while (!*terminate) {
+		for (size_t i = 0; i < count; i++) {
+			unsigned int value;
+			if (!metric_sample(&metrics[i], &value)) {
+				continue;
+			}
+			unsigned int color = gradient(&metrics[i], value);
+			for (size_t j = 0; j < LED_COUNT; j++) {
+				if ((metrics[i].mask & LED_BIT(j)) &&
+					(!(current->color_mask & LED_BIT(j)) || current->color[j] != color)) {
+					plan_set_color(&plan, j, color);
+				}
+			}
+		}
+
+		if (!plan_empty(&plan) && plan_apply(&plan, current, backend) == -1) {
+			fprintf(stderr, "Backend error: %s\n", strerror(errno));
+			ret = RUN_ERR_BACKEND;
+			break;
+		}
+
+		uint64_t expirations;
+		// Interrupted by a signal when rainbow is terminated
+		if (read(timer_fd, &expirations, sizeof(expirations)) == -1 && errno != EINTR) {
+			fprintf(stderr, "Timer error: %s\n", strerror(errno));
+			ret = RUN_ERR_BACKEND;
+			break;
+		}
+	}
+
+	close(timer_fd);
+	close_metrics(metrics, count);
+	return ret;
+}
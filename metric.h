@@ -0,0 +1,42 @@
+/*
+ * Rainbow is a tool for changing color and status of the LEDs of the Turris router
+ *
+ * Copyright (C) 2016 CZ.NIC, z.s.p.o. (http://www.nic.cz/)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef METRIC_H
+#define METRIC_H
+
+#include <signal.h>
+
+#include "backend.h"
+#include "command.h"
+#include "plan.h"
+
+/*
+Shows system metrics on LEDs until terminate is set. Each binding in args is
+DEV SOURCE MIN MAX [COLOR ...], where SOURCE is one of:
+  rx:IFACE, tx:IFACE - traffic of interface in kbit/s
+  cpu - CPU load in percent
+  temp[:ZONE] - temperature of thermal zone (default 0) in degrees Celsius
+Value from MIN to MAX is mapped to a gradient through COLORs spread evenly
+(default green to red). Metrics are sampled every METRIC_INTERVAL ms from
+files kept open and LEDs are written only when their color changes.
+*/
+enum run_result run_metric(char **args, struct backend *backend, struct led_state *current,
+		volatile sig_atomic_t *terminate);
+
+#endif //METRIC_H
@@ -0,0 +1,179 @@
+/*
+ * Rainbow is a tool for changing color and status of the LEDs of the Turris router
+ *
+ * Copyright (C) 2016 CZ.NIC, z.s.p.o. (http://www.nic.cz/)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stddef.h>
+
+#include "configuration.h"
+#include "arg_parser.h"
+#include "pattern.h"
+
+// Ramp of breathe up and down, each has this many steps
+#define BREATHE_STEPS 8
+// Default length of a morse dot in ms
+#define SOS_UNIT 150
+
+/*
+Morse units of SOS, on and off in turns: dot and gaps inside a letter are
+one unit, dash and gap between letters three, the gap before the next run
+seven.
+*/
+static const unsigned int sos_units[] = {
+	1, 1, 1, 1, 1, 3,
+	3, 1, 3, 1, 3, 3,
+	1, 1, 1, 1, 1, 7
+};
+#define SOS_LENGTH 34
+
+static void add_step(struct pattern *pattern, unsigned int brightness, unsigned int duration)
+{
+	pattern->steps[pattern->len++] = (struct pattern_step) {
+		.brightness = brightness,
+		.duration = duration
+	};
+	pattern->cycle += duration;
+}
+
+static void hold(struct pattern *pattern, unsigned int brightness, unsigned int duration)
+{
+	add_step(pattern, brightness, duration);
+	add_step(pattern, brightness, 0);
+}
+
+// 3x^2 - 2x^3 of x = step / BREATHE_STEPS scaled to brightness
+static unsigned int ramp(unsigned int step)
+{
+	const unsigned int n = BREATHE_STEPS;
+	return 255 * (3 * step * step * n - 2 * step * step * step) / (n * n * n);
+}
+
+void pattern_compile(enum pattern_effect effect, unsigned int period, struct pattern *pattern)
+{
+	pattern->len = 0;
+	pattern->cycle = 0;
+
+	switch (effect) {
+	case PAT_BLINK:
+		period = period ? period : ANIMATION_PERIOD;
+		hold(pattern, 255, period / 2);
+		hold(pattern, 0, period - period / 2);
+		break;
+	case PAT_BREATHE:
+		period = period ? period : ANIMATION_PERIOD;
+		for (unsigned int i = 0; i < 2 * BREATHE_STEPS; i++) {
+			unsigned int brightness = ramp(i < BREATHE_STEPS ? i : 2 * BREATHE_STEPS - i);
+			add_step(pattern, brightness, period / (2 * BREATHE_STEPS));
+		}
+		// Rounding is caught up by the last step
+		pattern->steps[pattern->len - 1].duration += period - pattern->cycle;
+		pattern->cycle = period;
+		break;
+	case PAT_HEARTBEAT:
+		period = period ? period : ANIMATION_PERIOD;
+		hold(pattern, 255, period * 8 / 100);
+		hold(pattern, 0, period * 12 / 100);
+		hold(pattern, 255, period * 8 / 100);
+		hold(pattern, 0, period - pattern->cycle);
+		break;
+	case PAT_SOS: {
+		unsigned int unit = period ? period / SOS_LENGTH : SOS_UNIT;
+		size_t count = sizeof(sos_units) / sizeof(*sos_units);
+		period = period ? period : SOS_LENGTH * SOS_UNIT;
+		for (size_t i = 0; i + 1 < count; i++) {
+			hold(pattern, i % 2 ? 0 : 255, sos_units[i] * unit);
+		}
+		hold(pattern, 0, period - pattern->cycle);
+		break;
+	}
+	}
+}
+
+void pattern_format(const struct pattern *pattern, char *buff, size_t size)
+{
+	size_t len = 0;
+
+	buff[0] = '\0';
+	for (size_t i = 0; i < pattern->len && len < size; i++) {
+		len += snprintf(buff + len, size - len, "%s%u %u", i ? " " : "", pattern->steps[i].brightness,
+			pattern->steps[i].duration);
+	}
+}
+
+static bool pattern_same(const struct pattern *a, const struct pattern *b)
+{
+	if (a->len != b->len) {
+		return false;
+	}
+	for (size_t i = 0; i < a->len; i++) {
+		if (a->steps[i].brightness != b->steps[i].brightness || a->steps[i].duration != b->steps[i].duration) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool pattern_recognize(const char *text, enum pattern_effect *effect, unsigned int *period)
+{
+	struct pattern read = { .len = 0 };
+	unsigned int brightness, duration;
+	int used;
+
+	while (sscanf(text, "%u %u%n", &brightness, &duration, &used) == 2) {
+		if (read.len == PATTERN_STEPS_MAX) {
+			return false;
+		}
+		add_step(&read, brightness, duration);
+		text += used;
+	}
+	if (!read.len) {
+		return false;
+	}
+
+	// The default period first, it is what the effect without one compiles to
+	const unsigned int periods[] = { 0, read.cycle };
+	for (unsigned int e = PAT_BLINK; e <= PAT_SOS; e++) {
+		for (size_t i = 0; i < sizeof(periods) / sizeof(*periods); i++) {
+			struct pattern compiled;
+			pattern_compile(e, periods[i], &compiled);
+			if (pattern_same(&read, &compiled)) {
+				*effect = e;
+				*period = periods[i];
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+unsigned int pattern_brightness(const struct pattern *pattern, unsigned int elapsed)
+{
+	for (size_t i = 0; i < pattern->len; i++) {
+		const struct pattern_step *step = &pattern->steps[i];
+		if (elapsed < step->duration) {
+			int from = step->brightness;
+			int to = pattern->steps[(i + 1) % pattern->len].brightness;
+			return from + (to - from) * (int) elapsed / (int) step->duration;
+		}
+		elapsed -= step->duration;
+	}
+
+	return pattern->len ? pattern->steps[pattern->len - 1].brightness : 0;
+}
@@ -0,0 +1,65 @@
+/*
+ * Rainbow is a tool for changing color and status of the LEDs of the Turris router
+ *
+ * Copyright (C) 2016 CZ.NIC, z.s.p.o. (http://www.nic.cz/)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PATTERN_H
+#define PATTERN_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "arg_parser.h"
+
+#define PATTERN_STEPS_MAX 40
+// Longest text of the pattern attribute with its terminating '\0'
+#define PATTERN_TEXT_MAX 512
+
+/*
+Brightness (0-255) of a step goes linearly to the brightness of the next
+step over duration ms, the last step goes to the first one. A zero length
+step jumps, so a level is held by two steps of the same brightness. That is
+how the kernel pattern trigger runs its pattern attribute.
+*/
+struct pattern_step {
+	unsigned int brightness;
+	unsigned int duration;
+};
+
+struct pattern {
+	struct pattern_step steps[PATTERN_STEPS_MAX];
+	size_t len;
+	unsigned int cycle; // ms of one run, sum of the durations
+};
+
+// Steps of effect running period ms (0 for its default)
+void pattern_compile(enum pattern_effect effect, unsigned int period, struct pattern *pattern);
+// Text of the pattern attribute, "brightness duration" pairs
+void pattern_format(const struct pattern *pattern, char *buff, size_t size);
+/*
+Effect and period of the pattern attribute text, false when no effect compiles
+to it. Period is 0 when the text is the default one of the effect.
+*/
+bool pattern_recognize(const char *text, enum pattern_effect *effect, unsigned int *period);
+/*
+Brightness elapsed ms into a run as the kernel shows it, for the userspace
+engine when the kernel has no pattern trigger. It stays at the brightness of
+the last step past the end of the run.
+*/
+unsigned int pattern_brightness(const struct pattern *pattern, unsigned int elapsed);
+
+#endif //PATTERN_H
@@ -0,0 +1,361 @@
+/*
+ * Rainbow is a tool for changing color and status of the LEDs of the Turris router
+ *
+ * Copyright (C) 2016 CZ.NIC, z.s.p.o. (http://www.nic.cz/)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "configuration.h"
+#include "arg_parser.h"
+#include "backend.h"
+#include "plan.h"
+
+void state_clear(struct led_state *state)
+{
+	memset(state, 0, sizeof(*state));
+}
+
+// Trigger statuses are equal only with the same parameters
+static bool status_equal(const struct led_state *a, const struct led_state *b, size_t i)
+{
+	return a->status[i] == b->status[i] && (!STATUS_TRIGGER(a->status[i]) ||
+		memcmp(&a->trigger[i], &b->trigger[i], sizeof(a->trigger[i])) == 0);
+}
+
+// LEDs of state known to be driven by a kernel trigger
+static unsigned int trigger_mask(const struct led_state *state)
+{
+	unsigned int mask = 0;
+	for (size_t i = 0; i < LED_COUNT; i++) {
+		if ((state->status_mask & LED_BIT(i)) && STATUS_TRIGGER(state->status[i])) {
+			mask |= LED_BIT(i);
+		}
+	}
+
+	return mask;
+}
+
+bool state_equal(const struct led_state *a, const struct led_state *b)
+{
+	if (a->color_mask != b->color_mask || a->status_mask != b->status_mask ||
+		a->intensity_valid != b->intensity_valid ||
+		(a->intensity_valid && a->intensity != b->intensity)) {
+		return false;
+	}
+
+	for (size_t i = 0; i < LED_COUNT; i++) {
+		if ((a->color_mask & LED_BIT(i)) && a->color[i] != b->color[i]) {
+			return false;
+		}
+		if ((a->status_mask & LED_BIT(i)) && !status_equal(a, b, i)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void state_merge(struct led_state *dst, const struct led_state *src)
+{
+	for (size_t i = 0; i < LED_COUNT; i++) {
+		if (src->color_mask & LED_BIT(i)) {
+			dst->color[i] = src->color[i];
+		}
+		if (src->status_mask & LED_BIT(i)) {
+			dst->status[i] = src->status[i];
+			dst->trigger[i] = src->trigger[i];
+		}
+	}
+	dst->color_mask |= src->color_mask;
+	dst->status_mask |= src->status_mask;
+
+	if (src->intensity_valid) {
+		dst->intensity = src->intensity;
+		dst->intensity_valid = true;
+	}
+}
+
+bool plan_empty(const struct led_state *plan)
+{
+	return !plan->color_mask && !plan->status_mask && !plan->intensity_valid;
+}
+
+unsigned int cmd_mask(enum cmd cmd)
+{
+	switch (cmd) {
+	case CMD_ALL:
+		return LED_ALL_MASK;
+	case CMD_LAN:
+		return LED_BIT(CMD_LAN0) | LED_BIT(CMD_LAN1) | LED_BIT(CMD_LAN2) | LED_BIT(CMD_LAN3) | LED_BIT(CMD_LAN4);
+	default:
+		return cmd >= CMD_PWR && cmd < LED_COUNT ? LED_BIT(cmd) : 0;
+	}
+}
+
+void plan_set_color(struct led_state *plan, enum cmd cmd, unsigned int color)
+{
+	plan->color[cmd] = color;
+	plan->color_mask |= LED_BIT(cmd);
+	plan->color_group_mask &= ~LED_BIT(cmd);
+}
+
+void plan_set_status(struct led_state *plan, enum cmd cmd, enum status status)
+{
+	plan->status[cmd] = status;
+	memset(&plan->trigger[cmd], 0, sizeof(plan->trigger[cmd]));
+	plan->status_mask |= LED_BIT(cmd);
+	plan->status_group_mask &= ~LED_BIT(cmd);
+}
+
+void plan_set_trigger(struct led_state *plan, enum cmd cmd, enum status status, const struct trigger *trigger)
+{
+	plan_set_status(plan, cmd, status);
+	plan->trigger[cmd] = *trigger;
+}
+
+void plan_mark_group(struct led_state *plan, unsigned int color_mask, unsigned int status_mask)
+{
+	plan->color_group_mask |= color_mask & plan->color_mask;
+	plan->status_group_mask |= status_mask & plan->status_mask;
+}
+
+void plan_set_intensity(struct led_state *plan, unsigned int level)
+{
+	plan->intensity = level;
+	plan->intensity_valid = true;
+}
+
+static unsigned int color_cost(unsigned int color)
+{
+	(void) color;
+	return 1;
+}
+
+static unsigned int status_cost(unsigned int status)
+{
+	// Auto writes only autonomous, the others autonomous and brightness
+	return status == ST_AUTO ? 1 : 2;
+}
+
+/*
+Finds out whether it is cheaper to write one value to the 'all' LED and
+then override the LEDs that want something else than to write every
+changed LED separately. That is possible only when every LED is planned
+and the backend has the 'all' LED.
+*/
+static bool find_base(const unsigned int *want, unsigned int want_mask,
+		const unsigned int *have, unsigned int have_mask,
+		unsigned int (*cost)(unsigned int), unsigned int *base)
+{
+	if (want_mask != LED_ALL_MASK) {
+		return false;
+	}
+
+	unsigned int best = 0;
+	for (size_t i = 0; i < LED_COUNT; i++) {
+		if (!(have_mask & LED_BIT(i)) || have[i] != want[i]) {
+			best += cost(want[i]);
+		}
+	}
+
+	bool found = false;
+	for (size_t i = 0; i < LED_COUNT; i++) {
+		bool seen = false;
+		for (size_t j = 0; j < i && !seen; j++) {
+			seen = want[j] == want[i];
+		}
+		if (seen) {
+			continue;
+		}
+
+		unsigned int total = cost(want[i]);
+		for (size_t j = 0; j < LED_COUNT; j++) {
+			if (want[j] != want[i]) {
+				total += cost(want[j]);
+			}
+		}
+
+		if (total < best) {
+			best = total;
+			*base = want[i];
+			found = true;
+		}
+	}
+
+	return found;
+}
+
+static int apply_colors(struct led_state *plan, struct led_state *current, struct backend *backend)
+{
+	unsigned int base;
+	unsigned int want_mask = backend->fans_out ? 0 : plan->color_mask;
+
+	if (find_base(plan->color, want_mask, current->color, current->color_mask, color_cost, &base)) {
+		// Until it succeeds no LED has known color
+		current->color_mask = 0;
+		if (backend_set_color(backend, CMD_ALL, base) == -1) {
+			return -1;
+		}
+		for (size_t i = 0; i < LED_COUNT; i++) {
+			current->color[i] = base;
+		}
+		current->color_mask = LED_ALL_MASK;
+	}
+
+	for (size_t i = 0; i < LED_COUNT; i++) {
+		if (!(plan->color_mask & LED_BIT(i))) {
+			continue;
+		}
+		if (!(current->color_mask & LED_BIT(i)) || current->color[i] != plan->color[i]) {
+			current->color_mask &= ~LED_BIT(i);
+			if (plan->color_group_mask & LED_BIT(i)) {
+				backend_expanded(backend, i, STATS_COLOR);
+			}
+			if (backend_set_color(backend, i, plan->color[i]) == -1) {
+				return -1;
+			}
+			current->color[i] = plan->color[i];
+			current->color_mask |= LED_BIT(i);
+		}
+	}
+
+	return 0;
+}
+
+/*
+Status of a single LED. A kernel trigger keeps switching the LED until it is
+removed, so it goes before any other status.
+*/
+static int write_status(struct backend *backend, size_t i, enum status status, const struct trigger *trigger,
+		bool triggered)
+{
+	if (STATUS_TRIGGER(status)) {
+		return backend_set_trigger(backend, i, status, trigger);
+	}
+	if (triggered && backend_set_trigger(backend, i, status, NULL) == -1) {
+		return -1;
+	}
+
+	return backend_set_status(backend, i, status);
+}
+
+/*
+LEDs that may still follow a kernel trigger. Those with status unknown to the
+shadow (after --force or without the state file) may have been handed over by
+anything else.
+*/
+static unsigned int triggered_mask(const struct led_state *current, struct backend *backend)
+{
+	unsigned int mask = trigger_mask(current);
+	if (backend_triggers(backend)) {
+		mask |= LED_ALL_MASK & ~current->status_mask;
+	}
+
+	return mask;
+}
+
+static int apply_statuses(struct led_state *plan, struct led_state *current, struct backend *backend)
+{
+	unsigned int want[LED_COUNT], have[LED_COUNT];
+	unsigned int base;
+	unsigned int triggered = triggered_mask(current, backend);
+	// The 'all' LED doesn't reach LEDs switched by their own trigger
+	unsigned int want_mask = trigger_mask(plan) || triggered || backend->fans_out ? 0 : plan->status_mask;
+
+	for (size_t i = 0; i < LED_COUNT; i++) {
+		want[i] = plan->status[i];
+		have[i] = current->status[i];
+	}
+
+	if (find_base(want, want_mask, have, current->status_mask, status_cost, &base)) {
+		current->status_mask = 0;
+		if (backend_set_status(backend, CMD_ALL, base) == -1) {
+			return -1;
+		}
+		for (size_t i = 0; i < LED_COUNT; i++) {
+			current->status[i] = base;
+		}
+		current->status_mask = LED_ALL_MASK;
+	}
+
+	for (size_t i = 0; i < LED_COUNT; i++) {
+		if (!(plan->status_mask & LED_BIT(i))) {
+			continue;
+		}
+		if (!(current->status_mask & LED_BIT(i)) || !status_equal(current, plan, i)) {
+			current->status_mask &= ~LED_BIT(i);
+			if (plan->status_group_mask & LED_BIT(i)) {
+				backend_expanded(backend, i, STATS_STATUS);
+			}
+			if (write_status(backend, i, plan->status[i], &plan->trigger[i], triggered & LED_BIT(i)) == -1) {
+				return -1;
+			}
+			current->status[i] = plan->status[i];
+			current->trigger[i] = plan->trigger[i];
+			current->status_mask |= LED_BIT(i);
+		}
+	}
+
+	return 0;
+}
+
+// Values of plan that current already holds are not written at all
+static void count_elided(const struct led_state *plan, const struct led_state *current, struct backend *backend)
+{
+	for (size_t i = 0; i < LED_COUNT; i++) {
+		if ((plan->color_mask & current->color_mask & LED_BIT(i)) && plan->color[i] == current->color[i]) {
+			backend_elided(backend, i, STATS_COLOR);
+		}
+		if ((plan->status_mask & current->status_mask & LED_BIT(i)) && status_equal(plan, current, i)) {
+			backend_elided(backend, i, STATS_STATUS);
+		}
+	}
+	if (plan->intensity_valid && current->intensity_valid && plan->intensity == current->intensity) {
+		backend_elided(backend, CMD_UNDEF, STATS_INTENSITY);
+	}
+}
+
+int plan_apply(struct led_state *plan, struct led_state *current, struct backend *backend)
+{
+	count_elided(plan, current, backend);
+
+	int ret = apply_colors(plan, current, backend);
+	if (ret == 0) {
+		ret = apply_statuses(plan, current, backend);
+	}
+
+	if (ret == 0 && plan->intensity_valid && (!current->intensity_valid || current->intensity != plan->intensity)) {
+		current->intensity_valid = false;
+		ret = backend_set_intensity(backend, plan->intensity);
+		if (ret == 0) {
+			current->intensity = plan->intensity;
+			current->intensity_valid = true;
+		}
+	}
+
+	if (ret == 0) {
+		ret = backend_commit(backend);
+	}
+	if (ret == -1) {
+		// Queued writes may or may not have reached the device
+		state_clear(current);
+	}
+
+	state_clear(plan);
+	return ret;
+}
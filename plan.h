@@ -0,0 +1,78 @@
+/*
+ * Rainbow is a tool for changing color and status of the LEDs of the Turris router
+ *
+ * Copyright (C) 2016 CZ.NIC, z.s.p.o. (http://www.nic.cz/)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PLAN_H
+#define PLAN_H
+
+#include <stdbool.h>
+
+#include "configuration.h"
+#include "arg_parser.h"
+#include "backend.h"
+
+#define LED_BIT(cmd) (1U << (cmd))
+#define LED_ALL_MASK (LED_BIT(LED_COUNT) - 1)
+
+/*
+State of all single LEDs (CMD_PWR..CMD_USR2) and of the global intensity.
+Masks tell which entries hold a value, bit LED_BIT(cmd) for each LED.
+It is used both for the desired state compiled from the command line and
+for the known state of the hardware. Group masks mark planned values that
+came from a group (all, lan, binmask), they only feed backend_expanded().
+Trigger holds the parameters of LEDs with a trigger status.
+*/
+struct led_state {
+	unsigned int color[LED_COUNT];
+	enum status status[LED_COUNT];
+	struct trigger trigger[LED_COUNT];
+	unsigned int color_mask;
+	unsigned int status_mask;
+	unsigned int color_group_mask;
+	unsigned int status_group_mask;
+	bool intensity_valid;
+	unsigned int intensity;
+};
+
+// LEDs of device or group cmd
+unsigned int cmd_mask(enum cmd cmd);
+
+void state_clear(struct led_state *state);
+bool state_equal(const struct led_state *a, const struct led_state *b);
+// Copies every known value of src to dst
+void state_merge(struct led_state *dst, const struct led_state *src);
+bool plan_empty(const struct led_state *plan);
+
+// Later calls override earlier ones, only single LEDs are accepted
+void plan_set_color(struct led_state *plan, enum cmd cmd, unsigned int color);
+void plan_set_status(struct led_state *plan, enum cmd cmd, enum status status);
+void plan_set_trigger(struct led_state *plan, enum cmd cmd, enum status status, const struct trigger *trigger);
+// Marks planned values of LEDs in mask as set by a group
+void plan_mark_group(struct led_state *plan, unsigned int color_mask, unsigned int status_mask);
+void plan_set_intensity(struct led_state *plan, unsigned int level);
+
+/*
+Writes everything in plan that differs from current, using the 'all' LED
+when it saves writes, and commits it. Kernel triggers are set and removed
+per LED, the 'all' LED is not used while any LED has one. Current is updated to reflect the
+writes and plan is cleared. Returns -1 with errno set on backend error,
+current is cleared then as the state of the device is unknown.
+*/
+int plan_apply(struct led_state *plan, struct led_state *current, struct backend *backend);
+
+#endif //PLAN_H
@@ -0,0 +1,242 @@
+/*
+ * Rainbow is a tool for changing color and status of the LEDs of the Turris router
+ *
+ * Copyright (C) 2016 CZ.NIC, z.s.p.o. (http://www.nic.cz/)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "configuration.h"
+#include "arg_parser.h"
+#include "backend.h"
+#include "command.h"
+#include "plan.h"
+#include "scene.h"
+
+#define SCENE_MAGIC 0x43534252 // "RBSC"
+#define SCENE_VERSION 1
+
+struct scene_file {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t color_mask;
+	uint16_t status_mask;
+	uint8_t intensity_valid;
+	uint8_t intensity;
+	uint32_t color[LED_COUNT];
+	uint8_t status[LED_COUNT];
+} __attribute__((packed));
+
+static void scene_path(const char *name, char *path, size_t len)
+{
+	if (strchr(name, '/')) {
+		snprintf(path, len, "%s", name);
+	} else {
+		snprintf(path, len, "%s/%s.scene", SCENE_DIR, name);
+	}
+}
+
+// Creates dir with its parents, those that exist are fine
+static bool make_dirs(const char *dir)
+{
+	char path[PATH_MAX];
+	snprintf(path, sizeof(path), "%s", dir);
+
+	for (char *slash = strchr(path + 1, '/'); ; slash = strchr(slash + 1, '/')) {
+		if (slash) {
+			*slash = '\0';
+		}
+		if (mkdir(path, 0755) == -1 && errno != EEXIST) {
+			return false;
+		}
+		if (!slash) {
+			return true;
+		}
+		*slash = '/';
+	}
+}
+
+// A scene is only written, values a getter would print don't exist yet
+static bool has_getter(struct tokenizer *tokenizer)
+{
+	struct token token;
+	while ((token = next_token(tokenizer)).type != TOK_EOF) {
+		if (token.type == TOK_CMD && token.data.cmd == CMD_GET) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+enum run_result scene_compile(const char *name, char **args)
+{
+	/*
+	The scene is what the arguments would write to LEDs of unknown state,
+	so the command is run against the null backend and an empty state.
+	*/
+	struct led_state scene;
+	struct backend *backend = backend_null_init();
+	struct tokenizer *tokenizer = tokenizer_init(args, 0);
+	if (!backend || !tokenizer) {
+		backend_destroy(backend);
+		if (tokenizer) {
+			tokenizer_destroy(tokenizer);
+		}
+		fprintf(stderr, "Memory allocation error\n");
+		return RUN_ERR_MEMORY;
+	}
+
+	if (has_getter(tokenizer)) {
+		tokenizer_destroy(tokenizer);
+		backend_destroy(backend);
+		fprintf(stderr, "Getters can't be part of a scene\n");
+		return RUN_ERR_USAGE;
+	}
+	tokenizer_reset(tokenizer, args, 0);
+
+	state_clear(&scene);
+	enum run_result ret = run_command(tokenizer, backend, &scene, NULL, stdout, stderr);
+	tokenizer_destroy(tokenizer);
+	backend_destroy(backend);
+	if (ret != RUN_OK) {
+		return ret;
+	}
+	// The file keeps only the status itself, not the parameters of triggers
+	for (size_t i = 0; i < LED_COUNT; i++) {
+		if ((scene.status_mask & LED_BIT(i)) && STATUS_TRIGGER(scene.status[i])) {
+			fprintf(stderr, "Kernel triggers can't be part of a scene\n");
+			return RUN_ERR_USAGE;
+		}
+	}
+
+	struct scene_file file = {
+		.magic = SCENE_MAGIC,
+		.version = SCENE_VERSION,
+		.color_mask = scene.color_mask,
+		.status_mask = scene.status_mask,
+		.intensity_valid = scene.intensity_valid,
+		.intensity = scene.intensity
+	};
+	for (size_t i = 0; i < LED_COUNT; i++) {
+		file.color[i] = scene.color[i];
+		file.status[i] = scene.status[i];
+	}
+
+	char path[PATH_MAX], tmp_path[PATH_MAX + sizeof(".tmp")];
+	scene_path(name, path, sizeof(path));
+	sprintf(tmp_path, "%s.tmp", path);
+
+	// A path given by the user has to exist, SCENE_DIR is created with the first scene
+	if (!strchr(name, '/') && !make_dirs(SCENE_DIR)) {
+		fprintf(stderr, "Failed to create " SCENE_DIR ": %s\n", strerror(errno));
+		return RUN_ERR_BACKEND;
+	}
+
+	int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd == -1) {
+		fprintf(stderr, "Failed to write scene %s: %s\n", path, strerror(errno));
+		return RUN_ERR_BACKEND;
+	}
+	ssize_t written = write(fd, &file, sizeof(file));
+	int err = errno;
+	close(fd);
+
+	if (written != sizeof(file) || rename(tmp_path, path) == -1) {
+		if (written == sizeof(file)) {
+			err = errno;
+		}
+		unlink(tmp_path);
+		fprintf(stderr, "Failed to write scene %s: %s\n", path, strerror(err));
+		return RUN_ERR_BACKEND;
+	}
+
+	return RUN_OK;
+}
+
+static bool scene_load(const char *name, struct led_state *plan)
+{
+	char path[PATH_MAX];
+	scene_path(name, path, sizeof(path));
+
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd == -1) {
+		fprintf(stderr, "Failed to open scene %s: %s\n", path, strerror(errno));
+		return false;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) == -1 || st.st_size != sizeof(struct scene_file)) {
+		close(fd);
+		fprintf(stderr, "Scene %s is not a valid scene file\n", path);
+		return false;
+	}
+
+	const struct scene_file *file = mmap(NULL, sizeof(*file), PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (file == MAP_FAILED) {
+		fprintf(stderr, "Failed to map scene %s: %s\n", path, strerror(errno));
+		return false;
+	}
+
+	bool valid = file->magic == SCENE_MAGIC && file->version == SCENE_VERSION;
+	if (!valid) {
+		fprintf(stderr, "Scene %s has unsupported format, compile it again\n", path);
+	}
+
+	for (size_t i = 0; valid && i < LED_COUNT; i++) {
+		if (file->color_mask & LED_BIT(i)) {
+			plan_set_color(plan, i, file->color[i]);
+		}
+		if ((file->status_mask & LED_BIT(i)) && file->status[i] <= ST_AUTO) {
+			plan_set_status(plan, i, file->status[i]);
+		}
+	}
+	if (valid && file->intensity_valid && file->intensity <= MAX_INTENSITY_LEVEL) {
+		plan_set_intensity(plan, file->intensity);
+	}
+
+	munmap((void *) file, sizeof(*file));
+	return valid;
+}
+
+enum run_result scene_apply(char **names, struct backend *backend, struct led_state *current)
+{
+	struct led_state plan;
+	state_clear(&plan);
+
+	for (size_t i = 0; names[i]; i++) {
+		if (!scene_load(names[i], &plan)) {
+			return RUN_ERR_USAGE;
+		}
+	}
+
+	if (plan_apply(&plan, current, backend) == -1) {
+		fprintf(stderr, "Backend error: %s\n", strerror(errno));
+		return RUN_ERR_BACKEND;
+	}
+
+	return RUN_OK;
+}
@@ -0,0 +1,42 @@
+/*
+ * Rainbow is a tool for changing color and status of the LEDs of the Turris router
+ *
+ * Copyright (C) 2016 CZ.NIC, z.s.p.o. (http://www.nic.cz/)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SCENE_H
+#define SCENE_H
+
+#include "backend.h"
+#include "command.h"
+#include "plan.h"
+
+/*
+Scene is a named LED state compiled from the usual DEV_CONFIGURATION
+arguments into a small binary file in SCENE_DIR (created when missing) or at
+NAME when it contains '/'. Applying it maps the file and writes only the
+values that differ from current, without any tokenizing.
+*/
+
+// Compiles args into scene file of name, effects and getters are refused
+enum run_result scene_compile(const char *name, char **args);
+/*
+Applies scenes of names in their order as one update, the later scene wins
+for values in more of them.
+*/
+enum run_result scene_apply(char **names, struct backend *backend, struct led_state *current);
+
+#endif //SCENE_H
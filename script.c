@@ -0,0 +1,178 @@
+/*
+ * Rainbow is a tool for changing color and status of the LEDs of the Turris router
+ *
+ * Copyright (C) 2016 CZ.NIC, z.s.p.o. (http://www.nic.cz/)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include "script.h"
+
+#define SCRIPT_CHUNK 4096
+
+struct script {
+	char *data;
+	char **argv;
+	unsigned int *lines;
+};
+
+static char *read_all(int fd, size_t *len)
+{
+	struct stat st;
+	size_t size = SCRIPT_CHUNK;
+	// Regular files are read by a single read() into a buffer of their size
+	if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && (size_t) st.st_size >= size) {
+		size = st.st_size + 1;
+	}
+
+	char *data = malloc(size);
+	if (!data) {
+		return NULL;
+	}
+
+	*len = 0;
+	while (true) {
+		char *to = data + *len;
+		size_t room = size - *len - 1;
+		char probe;
+		// A full buffer may be the whole file, it grows only when EOF isn't there yet
+		if (!room) {
+			to = &probe;
+			room = 1;
+		}
+
+		ssize_t ret = read(fd, to, room);
+		if (ret == 0) {
+			break;
+		} else if (ret == -1) {
+			if (errno == EINTR) {
+				continue;
+			}
+			free(data);
+			return NULL;
+		}
+
+		if (to == &probe) {
+			size *= 2;
+			char *bigger = realloc(data, size);
+			if (!bigger) {
+				free(data);
+				return NULL;
+			}
+			data = bigger;
+			data[*len] = probe;
+		}
+		*len += ret;
+	}
+	data[*len] = '\0';
+
+	return data;
+}
+
+static bool is_space(char c)
+{
+	return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+}
+
+struct script *script_load(const char *path)
+{
+	bool from_stdin = strcmp(path, "-") == 0;
+	int fd = from_stdin ? STDIN_FILENO : open(path, O_RDONLY | O_CLOEXEC);
+	if (fd == -1) {
+		return NULL;
+	}
+
+	struct script *script = calloc(1, sizeof(*script));
+	size_t len;
+	char *data = script ? read_all(fd, &len) : NULL;
+	int err = errno;
+	if (!from_stdin) {
+		close(fd);
+	}
+	if (!data) {
+		free(script);
+		errno = err;
+		return NULL;
+	}
+	script->data = data;
+
+	// No more arguments than half of the characters can be there
+	script->argv = malloc((len / 2 + 2) * sizeof(*script->argv));
+	script->lines = malloc((len / 2 + 2) * sizeof(*script->lines));
+	if (!script->argv || !script->lines) {
+		script_destroy(script);
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	size_t argc = 0;
+	unsigned int line = 1;
+	char *pos = data;
+	while (*pos) {
+		if (*pos == '\n') {
+			line++;
+			pos++;
+		} else if (is_space(*pos)) {
+			pos++;
+		} else if (*pos == '#') {
+			while (*pos && *pos != '\n') {
+				pos++;
+			}
+		} else {
+			script->lines[argc] = line;
+			script->argv[argc++] = pos;
+			while (*pos && !is_space(*pos)) {
+				pos++;
+			}
+			// The newline ending the argument is overwritten, but still counted
+			if (*pos == '\n') {
+				line++;
+			}
+			if (*pos) {
+				*pos++ = '\0';
+			}
+		}
+	}
+	script->argv[argc] = NULL;
+
+	return script;
+}
+
+char **script_argv(struct script *script)
+{
+	return script->argv;
+}
+
+const unsigned int *script_lines(struct script *script)
+{
+	return script->lines;
+}
+
+void script_destroy(struct script *script)
+{
+	if (script) {
+		free(script->argv);
+		free(script->lines);
+		free(script->data);
+		free(script);
+	}
+}
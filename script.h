@@ -0,0 +1,39 @@
+/*
+ * Rainbow is a tool for changing color and status of the LEDs of the Turris router
+ *
+ * Copyright (C) 2016 CZ.NIC, z.s.p.o. (http://www.nic.cz/)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SCRIPT_H
+#define SCRIPT_H
+
+/*
+Script is a file of rainbow arguments. It is read in one pass and split in
+place into an argv-like array, so the whole script is one command: newlines
+separate arguments like spaces and everything is applied as one update.
+Text from # to the end of line is a comment.
+*/
+struct script;
+
+// Path '-' is stdin. Returns NULL and sets errno on failure.
+struct script *script_load(const char *path);
+// NULL terminated list of arguments for tokenizer_init()
+char **script_argv(struct script *script);
+// Line (from 1) of each argument, for tokenizer_set_lines()
+const unsigned int *script_lines(struct script *script);
+void script_destroy(struct script *script);
+
+#endif //SCRIPT_H
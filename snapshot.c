@@ -0,0 +1,198 @@
+/*
+ * Rainbow is a tool for changing color and status of the LEDs of the Turris router
+ *
+ * Copyright (C) 2016 CZ.NIC, z.s.p.o. (http://www.nic.cz/)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include "configuration.h"
+#include "arg_parser.h"
+#include "backend.h"
+#include "command.h"
+#include "plan.h"
+#include "script.h"
+#include "snapshot.h"
+
+int snapshot_read(struct backend *backend, struct led_state *state)
+{
+	bool unknown = false;
+
+	state_clear(state);
+
+	for (size_t i = 0; i < LED_COUNT; i++) {
+		if (backend_get_led(backend, i, &state->color[i], &state->status[i], &state->trigger[i]) == 0) {
+			state->color_mask |= LED_BIT(i);
+			state->status_mask |= LED_BIT(i);
+		} else if (errno == ENOMSG) {
+			unknown = true;
+		} else {
+			return -1;
+		}
+	}
+
+	if (backend_get_intensity(backend, &state->intensity) == -1) {
+		return -1;
+	}
+	state->intensity_valid = true;
+
+	if (unknown) {
+		errno = ENOMSG;
+		return -1;
+	}
+	return 0;
+}
+
+void snapshot_print(const struct led_state *state, FILE *out, bool json)
+{
+	// Triggers are printed with their parameters, so they are restored as they run
+	char status[LED_COUNT][STATUS_TEXT_MAX];
+	for (size_t i = 0; i < LED_COUNT; i++) {
+		status_format(state->status[i], &state->trigger[i], status[i]);
+	}
+
+	if (json) {
+		fprintf(out, "{\"leds\": [\n");
+		for (size_t i = 0; i < LED_COUNT; i++) {
+			fprintf(out, "  {\"led\": \"%s\", \"color\": \"%06X\", \"status\": \"%s\"}%s\n", cmd_keyword(i),
+				state->color[i], status[i], i + 1 < LED_COUNT ? "," : "");
+		}
+		fprintf(out, "], \"intensity\": %u}\n", state->intensity);
+		return;
+	}
+
+	for (size_t i = 0; i < LED_COUNT; i++) {
+		fprintf(out, "%s %06X %s\n", cmd_keyword(i), state->color[i], status[i]);
+	}
+	fprintf(out, "intensity %u\n", state->intensity);
+}
+
+// Reads the LEDs, they are what current should have known
+static bool read_leds(struct backend *backend, struct led_state *current, struct led_state *state)
+{
+	if (snapshot_read(backend, state) == -1) {
+		int error = errno;
+		if (error == ENOTSUP) {
+			fprintf(stderr, "Backend %s can't read LEDs\n", backend->ops->name);
+		} else if (error == ENOMSG) {
+			// The backend named the LEDs already
+			fprintf(stderr, "They would not be restored, set their status first\n");
+		} else {
+			fprintf(stderr, "Backend error: %s\n", strerror(error));
+		}
+		errno = error;
+		return false;
+	}
+	state_merge(current, state);
+
+	return true;
+}
+
+enum run_result snapshot_get(bool json, struct backend *backend, struct led_state *current, FILE *out)
+{
+	struct led_state state;
+
+	if (!read_leds(backend, current, &state)) {
+		return RUN_ERR_BACKEND;
+	}
+	snapshot_print(&state, out, json);
+
+	return RUN_OK;
+}
+
+enum run_result snapshot_save(const char *path, struct backend *backend, struct led_state *current)
+{
+	struct led_state state;
+
+	if (!read_leds(backend, current, &state)) {
+		return RUN_ERR_BACKEND;
+	}
+	if (strcmp(path, "-") == 0) {
+		snapshot_print(&state, stdout, false);
+		return RUN_OK;
+	}
+
+	char tmp_path[PATH_MAX];
+	if (snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path) >= (int) sizeof(tmp_path)) {
+		fprintf(stderr, "Failed to write snapshot %s: %s\n", path, strerror(ENAMETOOLONG));
+		return RUN_ERR_USAGE;
+	}
+
+	int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	FILE *file = fd != -1 ? fdopen(fd, "w") : NULL;
+	if (!file) {
+		fprintf(stderr, "Failed to write snapshot %s: %s\n", path, strerror(errno));
+		if (fd != -1) {
+			close(fd);
+			unlink(tmp_path);
+		}
+		return RUN_ERR_BACKEND;
+	}
+	fprintf(file, "# LEDs saved by 'rainbow snapshot', apply by 'rainbow restore'\n");
+	snapshot_print(&state, file, false);
+	bool ok = !ferror(file);
+	ok = fclose(file) == 0 && ok;
+
+	if (!ok || rename(tmp_path, path) == -1) {
+		fprintf(stderr, "Failed to write snapshot %s: %s\n", path, strerror(errno));
+		unlink(tmp_path);
+		return RUN_ERR_BACKEND;
+	}
+
+	return RUN_OK;
+}
+
+enum run_result snapshot_restore(const char *path, struct backend *backend, struct led_state *current)
+{
+	struct led_state state;
+
+	// Values the device has are not written again
+	if (snapshot_read(backend, &state) == 0) {
+		state_merge(current, &state);
+	} else if (errno == ENOMSG) {
+		// Status of LEDs with unknown triggers is written whatever current says
+		current->status_mask &= state.status_mask;
+		state_merge(current, &state);
+	} else if (errno != ENOTSUP) {
+		fprintf(stderr, "Backend error: %s\n", strerror(errno));
+		return RUN_ERR_BACKEND;
+	}
+
+	struct script *script = script_load(path);
+	if (!script) {
+		fprintf(stderr, "Failed to read snapshot %s: %s\n", path, strerror(errno));
+		return errno == ENOMEM ? RUN_ERR_MEMORY : RUN_ERR_BACKEND;
+	}
+	struct tokenizer *tokenizer = tokenizer_init(script_argv(script), 0);
+	if (!tokenizer) {
+		script_destroy(script);
+		fprintf(stderr, "Memory allocation error\n");
+		return RUN_ERR_MEMORY;
+	}
+	tokenizer_set_lines(tokenizer, script_lines(script));
+
+	enum run_result ret = run_command(tokenizer, backend, current, NULL, stdout, stderr);
+
+	tokenizer_destroy(tokenizer);
+	script_destroy(script);
+	return ret;
+}
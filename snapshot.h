@@ -0,0 +1,55 @@
+/*
+ * Rainbow is a tool for changing color and status of the LEDs of the Turris router
+ *
+ * Copyright (C) 2016 CZ.NIC, z.s.p.o. (http://www.nic.cz/)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "backend.h"
+#include "command.h"
+#include "plan.h"
+
+/*
+Snapshot is the state of every LED read back from the device. It is stored
+as a script of DEV_CONFIGURATIONs, so it can be edited or run by --file as
+well. Restoring it writes only what differs from the LEDs as they are.
+*/
+
+/*
+Reads color and status of all single LEDs and intensity, -1 with errno on
+failure. LEDs driven by a kernel trigger no status stands for are left out
+of state, it fails with ENOMSG then.
+*/
+int snapshot_read(struct backend *backend, struct led_state *state);
+// Prints state as DEV_CONFIGURATIONs or JSON
+void snapshot_print(const struct led_state *state, FILE *out, bool json);
+
+// Prints the LEDs, what was read is added to current
+enum run_result snapshot_get(bool json, struct backend *backend, struct led_state *current, FILE *out);
+// Stores the LEDs to path ('-' for stdout)
+enum run_result snapshot_save(const char *path, struct backend *backend, struct led_state *current);
+/*
+Applies snapshot in path. LEDs are read first when the backend can do it,
+otherwise current is trusted.
+*/
+enum run_result snapshot_restore(const char *path, struct backend *backend, struct led_state *current);
+
+#endif //SNAPSHOT_H
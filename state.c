@@ -0,0 +1,172 @@
+/*
+ * Rainbow is a tool for changing color and status of the LEDs of the Turris router
+ *
+ * Copyright (C) 2016 CZ.NIC, z.s.p.o. (http://www.nic.cz/)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <sys/file.h>
+
+#include "configuration.h"
+#include "plan.h"
+#include "state.h"
+
+#define STATE_MAGIC 0x34574252 // "RBW4"
+
+// Parameters of a kernel trigger status
+struct state_trigger {
+	char dev[TRIGGER_DEV_MAX];
+	uint8_t modes;
+	uint32_t delay_on;
+	uint32_t delay_off;
+	uint8_t pattern;
+	uint32_t period;
+	uint32_t repeat;
+} __attribute__((packed));
+
+struct state_file {
+	uint32_t magic;
+	uint32_t color[LED_COUNT];
+	uint8_t status[LED_COUNT];
+	struct state_trigger trigger[LED_COUNT];
+	uint16_t color_mask;
+	uint16_t status_mask;
+} __attribute__((packed));
+
+int state_lock(const char *path)
+{
+	char lock_path[strlen(path) + sizeof(".lock")];
+	sprintf(lock_path, "%s.lock", path);
+
+	int fd = open(lock_path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+	if (fd == -1) {
+		return -1;
+	}
+
+	while (flock(fd, LOCK_EX) == -1) {
+		if (errno != EINTR) {
+			close(fd);
+			return -1;
+		}
+	}
+
+	return fd;
+}
+
+void state_unlock(int lock)
+{
+	if (lock != -1) {
+		// Closing the file releases the lock
+		close(lock);
+	}
+}
+
+bool state_load(const char *path, struct led_state *state)
+{
+	struct state_file file;
+
+	state_clear(state);
+
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd == -1) {
+		return false;
+	}
+	ssize_t ret = read(fd, &file, sizeof(file));
+	close(fd);
+
+	if (ret != sizeof(file) || file.magic != STATE_MAGIC) {
+		return false;
+	}
+
+	for (size_t i = 0; i < LED_COUNT; i++) {
+		state->color[i] = file.color[i];
+		state->status[i] = file.status[i];
+		memcpy(state->trigger[i].dev, file.trigger[i].dev, TRIGGER_DEV_MAX);
+		state->trigger[i].dev[TRIGGER_DEV_MAX - 1] = '\0';
+		state->trigger[i].modes = file.trigger[i].modes;
+		state->trigger[i].delay_on = file.trigger[i].delay_on;
+		state->trigger[i].delay_off = file.trigger[i].delay_off;
+		state->trigger[i].pattern = file.trigger[i].pattern;
+		state->trigger[i].period = file.trigger[i].period;
+		state->trigger[i].repeat = file.trigger[i].repeat;
+	}
+	state->color_mask = file.color_mask & LED_ALL_MASK;
+	state->status_mask = file.status_mask & LED_ALL_MASK;
+
+	return true;
+}
+
+bool state_save(const char *path, const struct led_state *state)
+{
+	struct state_file file = {
+		.magic = STATE_MAGIC,
+		.color_mask = state->color_mask,
+		.status_mask = state->status_mask
+	};
+
+	for (size_t i = 0; i < LED_COUNT; i++) {
+		file.color[i] = state->color[i];
+		file.status[i] = state->status[i];
+		memcpy(file.trigger[i].dev, state->trigger[i].dev, TRIGGER_DEV_MAX);
+		file.trigger[i].modes = state->trigger[i].modes;
+		file.trigger[i].delay_on = state->trigger[i].delay_on;
+		file.trigger[i].delay_off = state->trigger[i].delay_off;
+		file.trigger[i].pattern = state->trigger[i].pattern;
+		file.trigger[i].period = state->trigger[i].period;
+		file.trigger[i].repeat = state->trigger[i].repeat;
+	}
+
+	// Write a new file and rename it over the old one so readers never see a half-written state
+	char tmp_path[strlen(path) + sizeof(".tmp")];
+	sprintf(tmp_path, "%s.tmp", path);
+
+	int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+	if (fd == -1) {
+		return false;
+	}
+	ssize_t ret = write(fd, &file, sizeof(file));
+	close(fd);
+
+	if (ret != sizeof(file) || rename(tmp_path, path) == -1) {
+		unlink(tmp_path);
+		return false;
+	}
+
+	return true;
+}
+
+bool state_update(const char *path, const struct led_state *changes, unsigned int forget)
+{
+	struct led_state state;
+	int lock = state_lock(path);
+	if (lock == -1) {
+		return false;
+	}
+
+	state_load(path, &state);
+	state.color_mask &= ~forget;
+	state_merge(&state, changes);
+	bool ret = state_save(path, &state);
+	state_unlock(lock);
+
+	return ret;
+}
@@ -0,0 +1,45 @@
+/*
+ * Rainbow is a tool for changing color and status of the LEDs of the Turris router
+ *
+ * Copyright (C) 2016 CZ.NIC, z.s.p.o. (http://www.nic.cz/)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef STATE_H
+#define STATE_H
+
+#include <stdbool.h>
+
+#include "plan.h"
+
+/*
+Shadow copy of the LED state that was written by rainbow. It is kept in
+STATE_FILE so a new invocation can skip writes of values that are already
+set. Callers hold the lock returned by state_lock() from load until save.
+Anything else writing the LED attributes makes the shadow stale, --force
+writes everything again then. Global intensity is not kept at all, the front
+button of Omnia changes it behind our back.
+*/
+int state_lock(const char *path);
+void state_unlock(int lock);
+bool state_load(const char *path, struct led_state *state);
+bool state_save(const char *path, const struct led_state *state);
+/*
+Forgets colors of LEDs in forget mask and stores known values of changes
+in one locked step.
+*/
+bool state_update(const char *path, const struct led_state *changes, unsigned int forget);
+
+#endif //STATE_H
@@ -0,0 +1,218 @@
+/*
+ * Rainbow is a tool for changing color and status of the LEDs of the Turris router
+ *
+ * Copyright (C) 2016 CZ.NIC, z.s.p.o. (http://www.nic.cz/)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <inttypes.h>
+
+#include "configuration.h"
+#include "arg_parser.h"
+#include "plan.h"
+#include "state.h"
+#include "stats.h"
+
+#define STATS_MAGIC 0x53544252 // "RBTS"
+
+struct stats_file {
+	uint32_t magic;
+	uint32_t version;
+	struct write_stats stats;
+};
+
+static const char *op_names[] = {
+	[STATS_COLOR] = "color",
+	[STATS_STATUS] = "status",
+	[STATS_INTENSITY] = "intensity",
+	[STATS_READ] = "read",
+	[STATS_COMMIT] = "commit"
+};
+
+void stats_record(struct op_stats *op, uint64_t ns, bool ok)
+{
+	uint64_t us = ns / 1000;
+	size_t bucket = us ? 64 - __builtin_clzll(us) : 0;
+
+	op->count++;
+	op->latency[bucket < STATS_BUCKETS ? bucket : STATS_BUCKETS - 1]++;
+	if (!ok) {
+		op->errors++;
+	}
+}
+
+static bool file_load(const char *path, struct stats_file *file)
+{
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd != -1) {
+		ssize_t ret = read(fd, file, sizeof(*file));
+		close(fd);
+		if (ret == sizeof(*file) && file->magic == STATS_MAGIC && file->version == sizeof(*file)) {
+			return true;
+		}
+	}
+
+	memset(file, 0, sizeof(*file));
+	file->magic = STATS_MAGIC;
+	// Size of the layout, so a change of it makes the old file invalid
+	file->version = sizeof(*file);
+	return fd != -1 || errno == ENOENT;
+}
+
+bool stats_load(const char *path, struct write_stats *stats)
+{
+	struct stats_file file;
+	bool ret = file_load(path, &file);
+	*stats = file.stats;
+	return ret;
+}
+
+bool stats_merge(const char *path, const struct write_stats *stats)
+{
+	struct stats_file file;
+	int lock = state_lock(path);
+	if (lock == -1) {
+		return false;
+	}
+	file_load(path, &file);
+
+	// Every member is a counter, so the structures are added as arrays
+	uint64_t *dst = (uint64_t *) &file.stats;
+	const uint64_t *src = (const uint64_t *) stats;
+	for (size_t i = 0; i < sizeof(*stats) / sizeof(uint64_t); i++) {
+		dst[i] += src[i];
+	}
+
+	char tmp_path[strlen(path) + sizeof(".tmp")];
+	sprintf(tmp_path, "%s.tmp", path);
+
+	bool ok = false;
+	int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd != -1) {
+		ok = write(fd, &file, sizeof(file)) == sizeof(file);
+		close(fd);
+		ok = ok && rename(tmp_path, path) == 0;
+		if (!ok) {
+			unlink(tmp_path);
+		}
+	}
+
+	state_unlock(lock);
+	return ok;
+}
+
+bool stats_reset(const char *path)
+{
+	int lock = state_lock(path);
+	bool ok = unlink(path) == 0 || errno == ENOENT;
+	state_unlock(lock);
+	return ok;
+}
+
+const char *stats_op_name(enum stats_op op)
+{
+	return op_names[op];
+}
+
+const char *stats_target_name(size_t target)
+{
+	return target == STATS_GLOBAL ? "global" : cmd_keyword(target);
+}
+
+static bool op_used(const struct op_stats *op)
+{
+	return op->count || op->elided;
+}
+
+static void print_text(const struct write_stats *stats, FILE *out)
+{
+	fprintf(out, "%-7s %-9s %8s %8s %8s %6s %7s %8s  %s\n", "led", "op", "count", "elided", "expanded", "errors",
+		"retries", "bytes", "latency");
+	for (size_t i = 0; i < STATS_TARGETS; i++) {
+		for (size_t j = 0; j < STATS_OPS; j++) {
+			const struct op_stats *op = &stats->op[i][j];
+			if (!op_used(op)) {
+				continue;
+			}
+			fprintf(out, "%-7s %-9s %8" PRIu64 " %8" PRIu64 " %8" PRIu64 " %6" PRIu64 " %7" PRIu64 " %8" PRIu64 " ",
+				stats_target_name(i), stats_op_name(j), op->count, op->elided, op->expanded, op->errors, op->retries,
+				op->bytes);
+			for (size_t k = 0; k < STATS_BUCKETS; k++) {
+				if (!op->latency[k]) {
+					continue;
+				}
+				if (k + 1 < STATS_BUCKETS) {
+					fprintf(out, " <%" PRIu64 "us:%" PRIu64, (uint64_t) 1 << k, op->latency[k]);
+				} else {
+					fprintf(out, " more:%" PRIu64, op->latency[k]);
+				}
+			}
+			fprintf(out, "\n");
+		}
+	}
+}
+
+static void print_json(const struct write_stats *stats, FILE *out)
+{
+	bool first = true;
+
+	fprintf(out, "[\n");
+	for (size_t i = 0; i < STATS_TARGETS; i++) {
+		for (size_t j = 0; j < STATS_OPS; j++) {
+			const struct op_stats *op = &stats->op[i][j];
+			if (!op_used(op)) {
+				continue;
+			}
+			fprintf(out, "%s  {\"led\": \"%s\", \"op\": \"%s\", \"count\": %" PRIu64 ", \"elided\": %" PRIu64
+				", \"expanded\": %" PRIu64 ", \"errors\": %" PRIu64 ", \"retries\": %" PRIu64 ", \"bytes\": %" PRIu64
+				", \"latency_us\": {",
+				first ? "" : ",\n", stats_target_name(i), stats_op_name(j), op->count, op->elided, op->expanded,
+				op->errors, op->retries, op->bytes);
+			// Keys are upper bounds of the buckets
+			bool first_bucket = true;
+			for (size_t k = 0; k < STATS_BUCKETS; k++) {
+				if (!op->latency[k]) {
+					continue;
+				}
+				if (k + 1 < STATS_BUCKETS) {
+					fprintf(out, "%s\"%" PRIu64 "\": %" PRIu64, first_bucket ? "" : ", ", (uint64_t) 1 << k,
+						op->latency[k]);
+				} else {
+					fprintf(out, "%s\"inf\": %" PRIu64, first_bucket ? "" : ", ", op->latency[k]);
+				}
+				first_bucket = false;
+			}
+			fprintf(out, "}}");
+			first = false;
+		}
+	}
+	fprintf(out, "%s]\n", first ? "" : "\n");
+}
+
+void stats_print(const struct write_stats *stats, FILE *out, bool json)
+{
+	if (json) {
+		print_json(stats, out);
+	} else {
+		print_text(stats, out);
+	}
+}
@@ -0,0 +1,81 @@
+/*
+ * Rainbow is a tool for changing color and status of the LEDs of the Turris router
+ *
+ * Copyright (C) 2016 CZ.NIC, z.s.p.o. (http://www.nic.cz/)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "arg_parser.h"
+
+// Bucket 0 is below 1 us, bucket i below 2^i us, the last one is the rest
+#define STATS_BUCKETS 24
+
+enum stats_op {
+	STATS_COLOR,
+	STATS_STATUS,
+	STATS_INTENSITY,
+	STATS_READ,
+	STATS_COMMIT,
+	STATS_OPS
+};
+
+// LEDs (and 'all') are targets by their enum cmd, intensity, reads and commits are global
+#define STATS_GLOBAL (CMD_ALL + 1)
+#define STATS_TARGETS (CMD_ALL + 2)
+
+/*
+Counters of one operation. Count are calls of the backend, elided are
+values the planner skipped because the LED already had them, expanded are
+calls for a single LED that got its value from a group. Bytes and
+retries (EINTR) are added by the backend for the call in progress, so
+backends that queue writes account them to the call that sent them.
+*/
+struct op_stats {
+	uint64_t count;
+	uint64_t elided;
+	uint64_t expanded;
+	uint64_t errors;
+	uint64_t retries;
+	uint64_t bytes;
+	uint64_t latency[STATS_BUCKETS];
+};
+
+struct write_stats {
+	struct op_stats op[STATS_TARGETS][STATS_OPS];
+};
+
+void stats_record(struct op_stats *op, uint64_t ns, bool ok);
+/*
+Adds stats to those stored in path in one locked step. Stats of all
+processes end up there, so it tells which LEDs load the bus the most.
+*/
+bool stats_merge(const char *path, const struct write_stats *stats);
+// Missing file gives zeroed stats
+bool stats_load(const char *path, struct write_stats *stats);
+bool stats_reset(const char *path);
+const char *stats_op_name(enum stats_op op);
+// Keyword of the LED or "global"
+const char *stats_target_name(size_t target);
+// Prints every used operation as a table or JSON
+void stats_print(const struct write_stats *stats, FILE *out, bool json);
+
+#endif //STATS_H
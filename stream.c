@@ -0,0 +1,140 @@
+/*
+ * Rainbow is a tool for changing color and status of the LEDs of the Turris router
+ *
+ * Copyright (C) 2016 CZ.NIC, z.s.p.o. (http://www.nic.cz/)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include "configuration.h"
+#include "backend.h"
+#include "plan.h"
+#include "command.h"
+#include "stream.h"
+
+// Frames read at once, only the newest complete one is used
+#define STREAM_BUFFER_FRAMES 16
+
+static void frame_to_plan(const struct stream_frame *frame, struct led_state *plan)
+{
+	for (size_t i = 0; i < LED_COUNT; i++) {
+		plan_set_color(plan, i, (frame->led[i].r << 16) | (frame->led[i].g << 8) | frame->led[i].b);
+		if (frame->led[i].mode <= ST_AUTO) {
+			plan_set_status(plan, i, frame->led[i].mode);
+		}
+	}
+
+	if (frame->intensity <= MAX_INTENSITY_LEVEL) {
+		plan_set_intensity(plan, frame->intensity);
+	}
+}
+
+static int stream_open(const char *path)
+{
+	if (strcmp(path, "-") == 0) {
+		return STDIN_FILENO;
+	}
+
+	struct stat st;
+	if (stat(path, &st) == -1) {
+		return -1;
+	}
+
+	// Holding the FIFO open for writing too means no EOF when producers come and go
+	return open(path, (S_ISFIFO(st.st_mode) ? O_RDWR : O_RDONLY) | O_CLOEXEC);
+}
+
+enum run_result run_stream(const char *path, struct backend *backend, struct led_state *current)
+{
+	static unsigned char buff[STREAM_BUFFER_FRAMES * sizeof(struct stream_frame)];
+	size_t len = 0;
+	bool eof = false;
+	enum run_result ret = RUN_OK;
+
+	int fd = stream_open(path);
+	if (fd == -1) {
+		fprintf(stderr, "Failed to open %s: %s\n", path, strerror(errno));
+		return RUN_ERR_USAGE;
+	}
+
+	int flags = fcntl(fd, F_GETFL);
+	fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+
+	while (!eof) {
+		struct pollfd pfd = { .fd = fd, .events = POLLIN };
+		if (poll(&pfd, 1, -1) == -1) {
+			if (errno == EINTR) {
+				continue;
+			}
+			fprintf(stderr, "Poll error: %s\n", strerror(errno));
+			ret = RUN_ERR_BACKEND;
+			break;
+		}
+
+		// Drain everything that is available, older frames are overwritten
+		while (true) {
+			ssize_t got = read(fd, buff + len, sizeof(buff) - len);
+			if (got == -1 && errno == EINTR) {
+				continue;
+			} else if (got == -1 && errno == EAGAIN) {
+				break;
+			} else if (got <= 0) {
+				eof = true;
+				break;
+			}
+			len += got;
+
+			if (len == sizeof(buff)) {
+				// Keep only the last complete frame and what follows it
+				size_t keep = sizeof(struct stream_frame);
+				memmove(buff, buff + len - keep, keep);
+				len = keep;
+			}
+		}
+
+		size_t frames = len / sizeof(struct stream_frame);
+		if (frames == 0) {
+			continue;
+		}
+
+		struct stream_frame frame;
+		struct led_state plan;
+		memcpy(&frame, buff + (frames - 1) * sizeof(frame), sizeof(frame));
+		len -= frames * sizeof(frame);
+		memmove(buff, buff + frames * sizeof(frame), len);
+
+		state_clear(&plan);
+		frame_to_plan(&frame, &plan);
+		if (plan_apply(&plan, current, backend) == -1) {
+			fprintf(stderr, "Backend error: %s\n", strerror(errno));
+			ret = RUN_ERR_BACKEND;
+			break;
+		}
+	}
+
+	if (fd != STDIN_FILENO) {
+		close(fd);
+	}
+
+	return ret;
+}
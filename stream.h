@@ -0,0 +1,54 @@
+/*
+ * Rainbow is a tool for changing color and status of the LEDs of the Turris router
+ *
+ * Copyright (C) 2016 CZ.NIC, z.s.p.o. (http://www.nic.cz/)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <stdint.h>
+
+#include "configuration.h"
+#include "backend.h"
+#include "plan.h"
+#include "command.h"
+
+#define STREAM_KEEP 0xFF
+
+/*
+One frame of the stream. LEDs are in enum cmd order, mode is enum status
+and intensity is 0-100. STREAM_KEEP in mode or intensity leaves the value
+as it is.
+*/
+struct stream_frame {
+	struct {
+		uint8_t r;
+		uint8_t g;
+		uint8_t b;
+		uint8_t mode;
+	} led[LED_COUNT];
+	uint8_t intensity;
+} __attribute__((packed));
+
+/*
+Reads frames from path ('-' is stdin) until EOF and applies each one as a
+difference against current. Frames that arrive while the previous one is
+being written are dropped in favor of the newest one.
+*/
+enum run_result run_stream(const char *path, struct backend *backend, struct led_state *current);
+
+#endif //STREAM_H
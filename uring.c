@@ -0,0 +1,208 @@
+/*
+ * Rainbow is a tool for changing color and status of the LEDs of the Turris router
+ *
+ * Copyright (C) 2016 CZ.NIC, z.s.p.o. (http://www.nic.cz/)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+#include "uring.h"
+
+struct uring {
+	int fd;
+	void *sq_map, *cq_map;
+	size_t sq_map_len, cq_map_len;
+	struct io_uring_sqe *sqes;
+	size_t sqes_len;
+	// Shared with the kernel
+	unsigned int *sq_head, *sq_tail, *sq_mask, *sq_array;
+	unsigned int *cq_head, *cq_tail, *cq_mask;
+	struct io_uring_cqe *cqes;
+	// Entries taken by uring_sqe() and not submitted yet
+	unsigned int sq_local_tail;
+	unsigned int pending;
+};
+
+static int sys_setup(unsigned int entries, struct io_uring_params *params)
+{
+	return syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int sys_enter(int fd, unsigned int submit, unsigned int complete, unsigned int flags)
+{
+	return syscall(__NR_io_uring_enter, fd, submit, complete, flags, NULL, 0);
+}
+
+struct uring *uring_init(unsigned int entries)
+{
+	struct uring *ring = calloc(1, sizeof(*ring));
+	if (!ring) {
+		return NULL;
+	}
+
+	struct io_uring_params params;
+	memset(&params, 0, sizeof(params));
+	ring->fd = sys_setup(entries, &params);
+	if (ring->fd == -1) {
+		free(ring);
+		return NULL;
+	}
+	// IORING_OP_WRITE came in the same release (5.6)
+	if (!(params.features & IORING_FEAT_RW_CUR_POS)) {
+		close(ring->fd);
+		free(ring);
+		errno = ENOSYS;
+		return NULL;
+	}
+
+	ring->sq_map_len = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+	ring->cq_map_len = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+	// Older kernels map both rings separately
+	if (params.features & IORING_FEAT_SINGLE_MMAP) {
+		if (ring->cq_map_len > ring->sq_map_len) {
+			ring->sq_map_len = ring->cq_map_len;
+		}
+		ring->cq_map_len = 0;
+	}
+	ring->sqes_len = params.sq_entries * sizeof(struct io_uring_sqe);
+
+	ring->sq_map = mmap(NULL, ring->sq_map_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+		ring->fd, IORING_OFF_SQ_RING);
+	ring->cq_map = ring->sq_map;
+	if (ring->sq_map != MAP_FAILED && ring->cq_map_len) {
+		ring->cq_map = mmap(NULL, ring->cq_map_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+			ring->fd, IORING_OFF_CQ_RING);
+	}
+	ring->sqes = mmap(NULL, ring->sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+		ring->fd, IORING_OFF_SQES);
+	if (ring->sq_map == MAP_FAILED || ring->cq_map == MAP_FAILED || ring->sqes == MAP_FAILED) {
+		int err = errno;
+		if (ring->sq_map == MAP_FAILED) {
+			ring->sq_map = NULL;
+		}
+		if (ring->cq_map == MAP_FAILED) {
+			ring->cq_map = NULL;
+		}
+		if (ring->sqes == MAP_FAILED) {
+			ring->sqes = NULL;
+		}
+		uring_destroy(ring);
+		errno = err;
+		return NULL;
+	}
+
+	char *sq = ring->sq_map, *cq = ring->cq_map;
+	ring->sq_head = (unsigned int *) (sq + params.sq_off.head);
+	ring->sq_tail = (unsigned int *) (sq + params.sq_off.tail);
+	ring->sq_mask = (unsigned int *) (sq + params.sq_off.ring_mask);
+	ring->sq_array = (unsigned int *) (sq + params.sq_off.array);
+	ring->cq_head = (unsigned int *) (cq + params.cq_off.head);
+	ring->cq_tail = (unsigned int *) (cq + params.cq_off.tail);
+	ring->cq_mask = (unsigned int *) (cq + params.cq_off.ring_mask);
+	ring->cqes = (struct io_uring_cqe *) (cq + params.cq_off.cqes);
+	ring->sq_local_tail = *ring->sq_tail;
+
+	return ring;
+}
+
+void uring_destroy(struct uring *ring)
+{
+	if (!ring) {
+		return;
+	}
+	if (ring->sqes) {
+		munmap(ring->sqes, ring->sqes_len);
+	}
+	if (ring->cq_map && ring->cq_map != ring->sq_map) {
+		munmap(ring->cq_map, ring->cq_map_len);
+	}
+	if (ring->sq_map) {
+		munmap(ring->sq_map, ring->sq_map_len);
+	}
+	close(ring->fd);
+	free(ring);
+}
+
+struct io_uring_sqe *uring_sqe(struct uring *ring)
+{
+	unsigned int head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+	if (ring->sq_local_tail - head > *ring->sq_mask) {
+		return NULL;
+	}
+
+	unsigned int index = ring->sq_local_tail & *ring->sq_mask;
+	struct io_uring_sqe *sqe = &ring->sqes[index];
+	memset(sqe, 0, sizeof(*sqe));
+	ring->sq_array[index] = index;
+	ring->sq_local_tail++;
+	ring->pending++;
+
+	return sqe;
+}
+
+int uring_submit(struct uring *ring)
+{
+	unsigned int count = ring->pending;
+	if (count == 0) {
+		return 0;
+	}
+
+	// Kernel sees the entries only after the tail moves past them
+	__atomic_store_n(ring->sq_tail, ring->sq_local_tail, __ATOMIC_RELEASE);
+	ring->pending = 0;
+
+	unsigned int submitted = 0;
+	while (submitted < count) {
+		int ret = sys_enter(ring->fd, count - submitted, count - submitted, IORING_ENTER_GETEVENTS);
+		if (ret == -1) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return -1;
+		}
+		submitted += ret;
+	}
+
+	// Waiting may be cut short by a signal after everything was submitted
+	unsigned int ready;
+	while ((ready = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE) - *ring->cq_head) < count) {
+		if (sys_enter(ring->fd, 0, count - ready, IORING_ENTER_GETEVENTS) == -1 && errno != EINTR) {
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+bool uring_cqe(struct uring *ring, struct io_uring_cqe *cqe)
+{
+	unsigned int head = *ring->cq_head;
+	if (head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) {
+		return false;
+	}
+
+	*cqe = ring->cqes[head & *ring->cq_mask];
+	__atomic_store_n(ring->cq_head, head + 1, __ATOMIC_RELEASE);
+
+	return true;
+}
@@ -0,0 +1,47 @@
+/*
+ * Rainbow is a tool for changing color and status of the LEDs of the Turris router
+ *
+ * Copyright (C) 2016 CZ.NIC, z.s.p.o. (http://www.nic.cz/)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef URING_H
+#define URING_H
+
+#include <stdbool.h>
+#include <linux/io_uring.h>
+
+/*
+Minimal io_uring without liburing: one submission and one completion queue
+used from a single thread. Entries are taken by uring_sqe(), sent all at
+once by uring_submit() and their results collected by uring_cqe().
+*/
+struct uring;
+
+// Returns NULL with errno set when the kernel doesn't provide io_uring
+struct uring *uring_init(unsigned int entries);
+void uring_destroy(struct uring *ring);
+
+// Free entry of the submission queue (zeroed), NULL when it is full
+struct io_uring_sqe *uring_sqe(struct uring *ring);
+/*
+Submits every entry taken since the last call and waits until all of them
+complete, with one io_uring_enter(). Returns -1 with errno set on failure.
+*/
+int uring_submit(struct uring *ring);
+// Takes the next completion, returns false when there is none
+bool uring_cqe(struct uring *ring, struct io_uring_cqe *cqe);
+
+#endif //URING_H